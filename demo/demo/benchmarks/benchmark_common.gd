@@ -0,0 +1,61 @@
+class_name TerrainBenchmark
+extends Node
+
+## Base of the benchmarks that run on a terrain scene: loading the scene, waiting for the terrain and cleaning up.
+## The benchmarks extend it and only keep what they measure.
+
+@export var terrain_scene: PackedScene = preload("res://demo/demo.tscn")
+
+## Instantiates terrain_scene and adds it to the tree. setup gets the terrain first, properties that only apply when
+## the terrain starts building have to be set there. Returns null if the scene has no terrain.
+func load_terrain(setup := Callable()) -> JarVoxelTerrain:
+	var instance := terrain_scene.instantiate()
+	var terrain := find_terrain(instance)
+	if terrain == null:
+		push_error("No JarVoxelTerrain in the benchmark scene.")
+		instance.free()
+		return null
+	if setup.is_valid():
+		setup.call(terrain)
+	add_child(instance)
+	return terrain
+
+func wait_for_build(terrain: JarVoxelTerrain) -> void:
+	while terrain.is_building():
+		await get_tree().process_frame
+
+## Waits until the terrain went settle_frames frames without a build, a queued or running mesh job, a mesh waiting to
+## be applied or a pending collider, or until timeout seconds passed. Chunks only exist once their mesh is applied.
+## Returns false on a timeout.
+func wait_for_settle(terrain: JarVoxelTerrain, settle_frames := 30, timeout := 60.0) -> bool:
+	var idle := 0
+	var elapsed := 0.0
+	while idle < settle_frames:
+		if elapsed >= timeout:
+			return false
+		await get_tree().process_frame
+		elapsed += get_process_delta_time()
+		var stats := terrain.get_statistics()
+		var busy: bool = terrain.is_building() or stats["mesh_queue_length"] > 0 or stats["mesh_jobs_in_flight"] > 0 \
+			or stats["mesh_apply_backlog"] > 0 or stats["collider_queue_length"] > 0
+		idle = 0 if busy else idle + 1
+	return true
+
+## Frees the scene of a terrain from load_terrain and waits for it to be gone.
+func unload_terrain(terrain: JarVoxelTerrain) -> void:
+	var instance: Node = terrain.owner if terrain.owner != null else terrain
+	instance.queue_free()
+	await get_tree().process_frame
+
+## Quits with an error code, for a benchmark that could not run.
+func fail() -> void:
+	get_tree().quit(1)
+
+func find_terrain(node: Node) -> JarVoxelTerrain:
+	if node is JarVoxelTerrain:
+		return node
+	for child in node.get_children():
+		var terrain := find_terrain(child)
+		if terrain != null:
+			return terrain
+	return null
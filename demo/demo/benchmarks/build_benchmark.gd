@@ -0,0 +1,33 @@
+extends TerrainBenchmark
+
+## Measures the initial octree build of a terrain scene for several worker thread counts and prints the wall times.
+## Run build_benchmark.tscn, the project quits once all runs are done.
+
+@export var thread_counts: PackedInt32Array = [1, 2, 4, 8]
+@export var runs_per_count := 3
+
+func _ready() -> void:
+	print("threads | best build ms | average build ms")
+	for threads in thread_counts:
+		var best := INF
+		var total := 0.0
+		for run in runs_per_count:
+			var build_ms := await _measure_build(threads)
+			if build_ms < 0.0:
+				fail()
+				return
+			best = min(best, build_ms)
+			total += build_ms
+		print("%7d | %13.1f | %16.1f" % [threads, best, total / runs_per_count])
+	get_tree().quit()
+
+func _measure_build(threads: int) -> float:
+	# must be set before the terrain enters the tree, that is when it starts building
+	var terrain := load_terrain(func(t: JarVoxelTerrain): t.performance_worker_threads = threads)
+	if terrain == null:
+		return -1.0
+	await wait_for_build(terrain)
+	var build_ms: float = terrain.get_statistics()["build_time_ms"]
+
+	await unload_terrain(terrain)
+	return build_ms
@@ -0,0 +1,65 @@
+extends TerrainBenchmark
+
+## Flies the player node of a terrain scene in a straight line and prints what the lod updates on the way cost, once
+## with full rebuilds and once with incremental ones. Run flight_benchmark.tscn, the project quits once both runs are done.
+
+@export var speed := 256.0
+@export var duration := 20.0
+@export var direction := Vector3(0, 0, -1)
+
+func _ready() -> void:
+	print("incremental | updates | average build ms | max build ms | average nodes visited")
+	for incremental in [false, true]:
+		var result := await _fly(incremental)
+		if result.is_empty():
+			fail()
+			return
+		print("%11s | %7d | %16.2f | %12.2f | %21.0f" % [str(incremental), result["updates"], result["average_ms"],
+			result["max_ms"], result["average_nodes"]])
+	get_tree().quit()
+
+func _fly(incremental: bool) -> Dictionary:
+	var terrain := load_terrain(func(t: JarVoxelTerrain): t.lod_incremental_update = incremental)
+	if terrain == null:
+		return {}
+
+	var player: Node3D = terrain.player_node
+	if player == null:
+		push_error("The terrain of the benchmark scene has no player node.")
+		await unload_terrain(terrain)
+		return {}
+	# the benchmark steers, not the scripts of the scene
+	player.process_mode = Node.PROCESS_MODE_DISABLED
+
+	# the initial build is a full one either way
+	await wait_for_build(terrain)
+
+	var updates := 0
+	var total_ms := 0.0
+	var max_ms := 0.0
+	var total_nodes := 0
+	var seen_builds: int = terrain.get_statistics()["build_count"]
+	var elapsed := 0.0
+	while elapsed < duration:
+		var delta := get_process_delta_time()
+		elapsed += delta
+		player.global_position += direction.normalized() * speed * delta
+		await get_tree().process_frame
+		if terrain.is_building():
+			continue
+		# short builds start and finish within a frame, the count catches them too
+		var stats := terrain.get_statistics()
+		if stats["build_count"] > seen_builds:
+			seen_builds = stats["build_count"]
+			updates += 1
+			total_ms += stats["build_time_ms"]
+			max_ms = max(max_ms, stats["build_time_ms"])
+			total_nodes += stats["build_nodes_visited"]
+
+	await unload_terrain(terrain)
+	return {
+		"updates": updates,
+		"average_ms": total_ms / max(updates, 1),
+		"max_ms": max_ms,
+		"average_nodes": float(total_nodes) / max(updates, 1),
+	}
@@ -0,0 +1,19 @@
+extends Node
+
+## Compares the throughput of the old ThreadPool and the JobSystem that runs the octree build and the mesh jobs.
+## Run job_benchmark.tscn, the project quits once all runs are done.
+
+@export var thread_counts: PackedInt32Array = [1, 2, 4, 8]
+@export var job_count := 100000
+## iterations of busy work per job, 0 measures the bare scheduling cost
+@export var work_per_job: PackedInt32Array = [0, 256, 4096]
+
+func _ready() -> void:
+	print("threads | work | thread pool jobs/s | job system jobs/s | speedup")
+	for threads in thread_counts:
+		for work in work_per_job:
+			var result := JarVoxelTerrain.benchmark_job_system(threads, job_count, work)
+			var pool: float = result["thread_pool_jobs_per_second"]
+			var jobs: float = result["job_system_jobs_per_second"]
+			print("%7d | %4d | %18.0f | %17.0f | %6.2fx" % [threads, work, pool, jobs, jobs / max(pool, 1.0)])
+	get_tree().quit()
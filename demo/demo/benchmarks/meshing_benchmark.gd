@@ -0,0 +1,33 @@
+extends TerrainBenchmark
+
+## Meshes every chunk of a built terrain scene again and prints the cost per chunk. Run it on two builds of the
+## extension to compare mesher changes, the triangle count should not change.
+## Run meshing_benchmark.tscn, the project quits once all runs are done.
+
+@export var iterations := 10
+## Also times the neighbour lookups of the mesher against the vector based version they replaced.
+@export var compare_neighbours := true
+## seconds to wait for every chunk of the first build to be meshed and applied
+@export var timeout := 60.0
+
+func _ready() -> void:
+	var terrain := load_terrain()
+	if terrain == null:
+		fail()
+		return
+	# the benchmark meshes the chunks that exist, they only do once their meshes were applied
+	if not await wait_for_settle(terrain, 30, timeout):
+		push_warning("The terrain did not settle within %.0f seconds, not every chunk is meshed." % timeout)
+
+	var result := terrain.benchmark_meshing(iterations, compare_neighbours)
+	print("chunks | sample ms/chunk | surface ms/chunk | mesh ms/chunk | triangles")
+	print("%6d | %15.3f | %16.3f | %13.3f | %9d" % [result["chunk_count"], result["sample_ms_per_chunk"],
+			result["surface_ms_per_chunk"], result["mesh_ms_per_chunk"], result["triangle_count"]])
+	print("edge chunks | edge ms/chunk | interior ms/chunk")
+	print("%11d | %13.3f | %17.3f" % [result["edge_chunk_count"], result["edge_mesh_ms_per_chunk"],
+			result["interior_mesh_ms_per_chunk"]])
+	if compare_neighbours:
+		print("neighbours ms/chunk | legacy ms/chunk | mismatches")
+		print("%19.3f | %15.3f | %10d" % [result["neighbour_ms_per_chunk"], result["legacy_neighbour_ms_per_chunk"],
+				result["neighbour_mismatches"]])
+	get_tree().quit()
@@ -0,0 +1,31 @@
+extends TerrainBenchmark
+
+## Loads a terrain scene once as it renders and once with performance_collision_only, waits until every chunk is
+## meshed and prints what a chunk costs in either mode. Run server_benchmark.tscn, the project quits once both are done.
+
+## frames without a build, a mesh job or a pending collider before the terrain counts as settled
+@export var settle_frames := 30
+@export var timeout := 60.0
+
+func _ready() -> void:
+	print("collision only | chunks | bytes per chunk | mesh ms per chunk | apply ms per chunk")
+	for collision_only in [false, true]:
+		var stats := await _load(collision_only)
+		if stats.is_empty():
+			fail()
+			return
+		print("%14s | %6d | %15d | %17.3f | %18.3f" % [str(collision_only), stats["chunk_count"],
+			stats["chunk_memory_bytes_per_chunk"], stats["mesh_time_per_chunk_ms"], stats["mesh_apply_time_per_chunk_ms"]])
+	get_tree().quit()
+
+func _load(collision_only: bool) -> Dictionary:
+	var terrain := load_terrain(func(t: JarVoxelTerrain): t.performance_collision_only = collision_only)
+	if terrain == null:
+		return {}
+
+	if not await wait_for_settle(terrain, settle_frames, timeout):
+		push_warning("The terrain did not settle within %.0f seconds." % timeout)
+
+	var result := terrain.get_statistics()
+	await unload_terrain(terrain)
+	return result
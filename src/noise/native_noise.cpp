@@ -0,0 +1,68 @@
+#include "native_noise.h"
+#include <algorithm>
+#include <cmath>
+#include <godot_cpp/variant/utility_functions.hpp>
+
+void NativeNoise::configure(const Ref<FastNoiseLite> &noise, bool enabled)
+{
+    std::shared_ptr<const NoiseKernel> kernel;
+    NoiseKernel::Settings settings;
+    if (enabled && noise.is_valid() && read_settings(noise, settings))
+    {
+        kernel = std::make_shared<const NoiseKernel>(settings);
+        if (!matches(*kernel, noise))
+        {
+            UtilityFunctions::printerr("Native noise differs from FastNoiseLite, sampling the resource instead.");
+            kernel.reset();
+        }
+    }
+    std::atomic_store(&_kernel, kernel);
+}
+
+bool NativeNoise::read_settings(const Ref<FastNoiseLite> &noise, NoiseKernel::Settings &settings)
+{
+    if (noise->is_domain_warp_enabled())
+        return false;
+
+    switch (noise->get_noise_type())
+    {
+    case FastNoiseLite::TYPE_SIMPLEX:
+        settings.noiseType = NoiseKernel::NOISE_OPEN_SIMPLEX_2;
+        break;
+    case FastNoiseLite::TYPE_SIMPLEX_SMOOTH:
+        settings.noiseType = NoiseKernel::NOISE_OPEN_SIMPLEX_2S;
+        break;
+    default:
+        return false;
+    }
+
+    const Vector3 offset = noise->get_offset();
+    settings.seed = noise->get_seed();
+    settings.frequency = noise->get_frequency();
+    settings.offset = glm::vec3(offset.x, offset.y, offset.z);
+    settings.fractalType = static_cast<NoiseKernel::FractalType>(noise->get_fractal_type());
+    settings.octaves = noise->get_fractal_octaves();
+    settings.lacunarity = noise->get_fractal_lacunarity();
+    settings.gain = noise->get_fractal_gain();
+    settings.weightedStrength = noise->get_fractal_weighted_strength();
+    settings.pingPongStrength = noise->get_fractal_ping_pong_strength();
+    return true;
+}
+
+// a few points spread over several noise cells and both signs of every axis
+bool NativeNoise::matches(const NoiseKernel &kernel, const Ref<FastNoiseLite> &noise)
+{
+    const float Tolerance = 1e-4f;
+    const float cell = 1.0f / std::max(std::abs(kernel.get_settings().frequency), 1e-6f);
+    for (int i = 0; i < 16; i++)
+    {
+        const float x = (i * 0.49f - 3.71f) * cell;
+        const float y = (i * -0.29f + 2.13f) * cell;
+        const float z = (i * 0.17f - 1.37f) * cell;
+        if (std::abs(kernel.get_noise_2d(x, z) - noise->get_noise_2d(x, z)) > Tolerance)
+            return false;
+        if (std::abs(kernel.get_noise_3d(x, y, z) - noise->get_noise_3d(x, y, z)) > Tolerance)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef NATIVE_NOISE_H
+#define NATIVE_NOISE_H
+
+#include "noise_kernel.h"
+#include <godot_cpp/classes/fast_noise_lite.hpp>
+#include <memory>
+
+using namespace godot;
+
+// Mirror of a FastNoiseLite resource as a NoiseKernel.
+// The kernel only becomes active when it covers the resource settings (OpenSimplex2 or OpenSimplex2S without domain
+// warp) and agrees with the resource on a handful of probe points. Otherwise get_kernel returns null and the caller
+// keeps sampling the resource, so terrains look the same either way.
+class NativeNoise
+{
+  public:
+    // main thread, whenever the resource is assigned or emits changed
+    void configure(const Ref<FastNoiseLite> &noise, bool enabled);
+
+    // safe from any thread, the kernel stays alive for as long as the caller holds it
+    std::shared_ptr<const NoiseKernel> get_kernel() const
+    {
+        return std::atomic_load(&_kernel);
+    }
+
+    bool is_active() const
+    {
+        return get_kernel() != nullptr;
+    }
+
+  private:
+    std::shared_ptr<const NoiseKernel> _kernel;
+
+    static bool read_settings(const Ref<FastNoiseLite> &noise, NoiseKernel::Settings &settings);
+    static bool matches(const NoiseKernel &kernel, const Ref<FastNoiseLite> &noise);
+};
+
+#endif // NATIVE_NOISE_H
@@ -0,0 +1,828 @@
+#include "noise_kernel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JAR_NOISE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+constexpr int PrimeX = 501125321;
+constexpr int PrimeY = 1136930381;
+constexpr int PrimeZ = 1720413743;
+
+// lattice math relies on 32 bit wrap around, done in unsigned to keep it defined
+inline int wrap_mul(int a, int b)
+{
+    return static_cast<int>(static_cast<uint32_t>(a) * static_cast<uint32_t>(b));
+}
+
+inline int wrap_add(int a, int b)
+{
+    return static_cast<int>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b));
+}
+
+const float Gradients2D[256] = {
+    0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+    0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220052f, 0.99144486137381f, -0.130526192220052f, 0.923879532511287f, -0.38268343236509f,
+    0.793353340291235f, -0.608761429008721f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+    -0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+    -0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+    -0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+    0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+    0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220052f, 0.99144486137381f, -0.130526192220052f, 0.923879532511287f, -0.38268343236509f,
+    0.793353340291235f, -0.608761429008721f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+    -0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+    -0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+    -0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+    0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+    0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220052f, 0.99144486137381f, -0.130526192220052f, 0.923879532511287f, -0.38268343236509f,
+    0.793353340291235f, -0.608761429008721f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+    -0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+    -0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+    -0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+    0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+    0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220052f, 0.99144486137381f, -0.130526192220052f, 0.923879532511287f, -0.38268343236509f,
+    0.793353340291235f, -0.608761429008721f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+    -0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+    -0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+    -0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+    0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+    0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220052f, 0.99144486137381f, -0.130526192220052f, 0.923879532511287f, -0.38268343236509f,
+    0.793353340291235f, -0.608761429008721f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+    -0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+    -0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+    -0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+    0.38268343236509f, 0.923879532511287f, 0.923879532511287f, 0.38268343236509f, 0.923879532511287f, -0.38268343236509f, 0.38268343236509f, -0.923879532511287f,
+    -0.38268343236509f, -0.923879532511287f, -0.923879532511287f, -0.38268343236509f, -0.923879532511287f, 0.38268343236509f, -0.38268343236509f, 0.923879532511287f,
+};
+
+const float Gradients3D[256] = {
+    0, 1, 1, 0, 0, -1, 1, 0, 0, 1, -1, 0, 0, -1, -1, 0,
+    1, 0, 1, 0, -1, 0, 1, 0, 1, 0, -1, 0, -1, 0, -1, 0,
+    1, 1, 0, 0, -1, 1, 0, 0, 1, -1, 0, 0, -1, -1, 0, 0,
+    0, 1, 1, 0, 0, -1, 1, 0, 0, 1, -1, 0, 0, -1, -1, 0,
+    1, 0, 1, 0, -1, 0, 1, 0, 1, 0, -1, 0, -1, 0, -1, 0,
+    1, 1, 0, 0, -1, 1, 0, 0, 1, -1, 0, 0, -1, -1, 0, 0,
+    0, 1, 1, 0, 0, -1, 1, 0, 0, 1, -1, 0, 0, -1, -1, 0,
+    1, 0, 1, 0, -1, 0, 1, 0, 1, 0, -1, 0, -1, 0, -1, 0,
+    1, 1, 0, 0, -1, 1, 0, 0, 1, -1, 0, 0, -1, -1, 0, 0,
+    0, 1, 1, 0, 0, -1, 1, 0, 0, 1, -1, 0, 0, -1, -1, 0,
+    1, 0, 1, 0, -1, 0, 1, 0, 1, 0, -1, 0, -1, 0, -1, 0,
+    1, 1, 0, 0, -1, 1, 0, 0, 1, -1, 0, 0, -1, -1, 0, 0,
+    0, 1, 1, 0, 0, -1, 1, 0, 0, 1, -1, 0, 0, -1, -1, 0,
+    1, 0, 1, 0, -1, 0, 1, 0, 1, 0, -1, 0, -1, 0, -1, 0,
+    1, 1, 0, 0, -1, 1, 0, 0, 1, -1, 0, 0, -1, -1, 0, 0,
+    1, 1, 0, 0, 0, -1, 1, 0, -1, 1, 0, 0, 0, -1, -1, 0,
+};
+
+inline int fast_floor(float f)
+{
+    return f >= 0 ? static_cast<int>(f) : static_cast<int>(f) - 1;
+}
+
+inline int fast_round(float f)
+{
+    return f >= 0 ? static_cast<int>(f + 0.5f) : static_cast<int>(f - 0.5f);
+}
+
+inline float lerp(float a, float b, float t)
+{
+    return a + t * (b - a);
+}
+
+inline float ping_pong(float t)
+{
+    t -= static_cast<int>(t * 0.5f) * 2;
+    return t < 1 ? t : 2 - t;
+}
+
+inline int hash_2d(int seed, int xPrimed, int yPrimed)
+{
+    return wrap_mul(seed ^ xPrimed ^ yPrimed, 0x27d4eb2d);
+}
+
+inline int hash_3d(int seed, int xPrimed, int yPrimed, int zPrimed)
+{
+    return wrap_mul(seed ^ xPrimed ^ yPrimed ^ zPrimed, 0x27d4eb2d);
+}
+
+inline float grad_coord(int seed, int xPrimed, int yPrimed, float xd, float yd)
+{
+    int hash = hash_2d(seed, xPrimed, yPrimed);
+    hash ^= hash >> 15;
+    hash &= 127 << 1;
+    return xd * Gradients2D[hash] + yd * Gradients2D[hash | 1];
+}
+
+inline float grad_coord(int seed, int xPrimed, int yPrimed, int zPrimed, float xd, float yd, float zd)
+{
+    int hash = hash_3d(seed, xPrimed, yPrimed, zPrimed);
+    hash ^= hash >> 15;
+    hash &= 63 << 2;
+    return xd * Gradients3D[hash] + yd * Gradients3D[hash | 1] + zd * Gradients3D[hash | 2];
+}
+
+const float Sqrt3 = 1.7320508075688772935274463415059f;
+const float F2 = 0.5f * (Sqrt3 - 1);
+const float G2 = (3 - Sqrt3) / 6;
+
+// OpenSimplex2 2d is ordinary simplex noise, the skew happens in transform_2d
+float open_simplex_2_2d(int seed, float x, float y)
+{
+    int i = fast_floor(x);
+    int j = fast_floor(y);
+    const float xi = x - i;
+    const float yi = y - j;
+
+    const float t = (xi + yi) * G2;
+    const float x0 = xi - t;
+    const float y0 = yi - t;
+
+    i = wrap_mul(i, PrimeX);
+    j = wrap_mul(j, PrimeY);
+
+    float n0, n1, n2;
+
+    const float a = 0.5f - x0 * x0 - y0 * y0;
+    if (a <= 0)
+        n0 = 0;
+    else
+        n0 = (a * a) * (a * a) * grad_coord(seed, i, j, x0, y0);
+
+    const float c = static_cast<float>(2 * (1 - 2 * G2) * (1 / G2 - 2)) * t +
+                    (static_cast<float>(-2 * (1 - 2 * G2) * (1 - 2 * G2)) + a);
+    if (c <= 0)
+        n2 = 0;
+    else
+    {
+        const float x2 = x0 + (2 * G2 - 1);
+        const float y2 = y0 + (2 * G2 - 1);
+        n2 = (c * c) * (c * c) * grad_coord(seed, wrap_add(i, PrimeX), wrap_add(j, PrimeY), x2, y2);
+    }
+
+    if (y0 > x0)
+    {
+        const float x1 = x0 + G2;
+        const float y1 = y0 + (G2 - 1);
+        const float b = 0.5f - x1 * x1 - y1 * y1;
+        if (b <= 0)
+            n1 = 0;
+        else
+            n1 = (b * b) * (b * b) * grad_coord(seed, i, wrap_add(j, PrimeY), x1, y1);
+    }
+    else
+    {
+        const float x1 = x0 + (G2 - 1);
+        const float y1 = y0 + G2;
+        const float b = 0.5f - x1 * x1 - y1 * y1;
+        if (b <= 0)
+            n1 = 0;
+        else
+            n1 = (b * b) * (b * b) * grad_coord(seed, wrap_add(i, PrimeX), j, x1, y1);
+    }
+
+    return (n0 + n1 + n2) * 99.83685446303647f;
+}
+
+// adds the contribution of lattice point (i, j) + (di, dj), the falloff of OpenSimplex2S has a radius of sqrt(2/3)
+inline void open_simplex_2s_corner(int seed, int i, int j, int di, int dj, float x0, float y0, float &value)
+{
+    const float x = x0 + (static_cast<float>(di + dj) * G2 - di);
+    const float y = y0 + (static_cast<float>(di + dj) * G2 - dj);
+    const float a = (2.0f / 3.0f) - x * x - y * y;
+    if (a > 0)
+        value += (a * a) * (a * a) * grad_coord(seed, wrap_add(i, wrap_mul(di, PrimeX)), wrap_add(j, wrap_mul(dj, PrimeY)), x, y);
+}
+
+float open_simplex_2s_2d(int seed, float x, float y)
+{
+    int i = fast_floor(x);
+    int j = fast_floor(y);
+    const float xi = x - i;
+    const float yi = y - j;
+
+    i = wrap_mul(i, PrimeX);
+    j = wrap_mul(j, PrimeY);
+
+    const float t = (xi + yi) * G2;
+    const float x0 = xi - t;
+    const float y0 = yi - t;
+
+    const float a0 = (2.0f / 3.0f) - x0 * x0 - y0 * y0;
+    float value = (a0 * a0) * (a0 * a0) * grad_coord(seed, i, j, x0, y0);
+
+    const float a1 = static_cast<float>(2 * (1 - 2 * G2) * (1 / G2 - 2)) * t +
+                     (static_cast<float>(-2 * (1 - 2 * G2) * (1 - 2 * G2)) + a0);
+    const float x1 = x0 - (1 - 2 * G2);
+    const float y1 = y0 - (1 - 2 * G2);
+    value += (a1 * a1) * (a1 * a1) * grad_coord(seed, wrap_add(i, PrimeX), wrap_add(j, PrimeY), x1, y1);
+
+    // two more of the surrounding lattice points, picked by the triangle the point is in
+    const float xmyi = xi - yi;
+    if (t > G2)
+    {
+        if (xi + xmyi > 1)
+            open_simplex_2s_corner(seed, i, j, 2, 1, x0, y0, value);
+        else
+            open_simplex_2s_corner(seed, i, j, 0, 1, x0, y0, value);
+
+        if (yi - xmyi > 1)
+            open_simplex_2s_corner(seed, i, j, 1, 2, x0, y0, value);
+        else
+            open_simplex_2s_corner(seed, i, j, 1, 0, x0, y0, value);
+    }
+    else
+    {
+        if (xi + xmyi < 0)
+            open_simplex_2s_corner(seed, i, j, -1, 0, x0, y0, value);
+        else
+            open_simplex_2s_corner(seed, i, j, 1, 0, x0, y0, value);
+
+        if (yi < xmyi)
+            open_simplex_2s_corner(seed, i, j, 0, -1, x0, y0, value);
+        else
+            open_simplex_2s_corner(seed, i, j, 0, 1, x0, y0, value);
+    }
+
+    return value * 18.24196194486065f;
+}
+
+// two offset cube grids, rotated in transform_3d
+float open_simplex_2_3d(int seed, float x, float y, float z)
+{
+    int i = fast_round(x);
+    int j = fast_round(y);
+    int k = fast_round(z);
+    float x0 = x - i;
+    float y0 = y - j;
+    float z0 = z - k;
+
+    int xNSign = static_cast<int>(-1.0f - x0) | 1;
+    int yNSign = static_cast<int>(-1.0f - y0) | 1;
+    int zNSign = static_cast<int>(-1.0f - z0) | 1;
+
+    float ax0 = xNSign * -x0;
+    float ay0 = yNSign * -y0;
+    float az0 = zNSign * -z0;
+
+    i = wrap_mul(i, PrimeX);
+    j = wrap_mul(j, PrimeY);
+    k = wrap_mul(k, PrimeZ);
+
+    float value = 0;
+    float a = (0.6f - x0 * x0) - (y0 * y0 + z0 * z0);
+
+    for (int l = 0;; l++)
+    {
+        if (a > 0)
+            value += (a * a) * (a * a) * grad_coord(seed, i, j, k, x0, y0, z0);
+
+        float b = a + 1;
+        int i1 = i;
+        int j1 = j;
+        int k1 = k;
+        float x1 = x0;
+        float y1 = y0;
+        float z1 = z0;
+
+        if (ax0 >= ay0 && ax0 >= az0)
+        {
+            x1 += xNSign;
+            b -= xNSign * 2 * x1;
+            i1 = wrap_add(i1, -wrap_mul(xNSign, PrimeX));
+        }
+        else if (ay0 > ax0 && ay0 >= az0)
+        {
+            y1 += yNSign;
+            b -= yNSign * 2 * y1;
+            j1 = wrap_add(j1, -wrap_mul(yNSign, PrimeY));
+        }
+        else
+        {
+            z1 += zNSign;
+            b -= zNSign * 2 * z1;
+            k1 = wrap_add(k1, -wrap_mul(zNSign, PrimeZ));
+        }
+
+        if (b > 0)
+            value += (b * b) * (b * b) * grad_coord(seed, i1, j1, k1, x1, y1, z1);
+
+        if (l == 1)
+            break;
+
+        ax0 = 0.5f - ax0;
+        ay0 = 0.5f - ay0;
+        az0 = 0.5f - az0;
+
+        x0 = xNSign * ax0;
+        y0 = yNSign * ay0;
+        z0 = zNSign * az0;
+
+        a += (0.75f - ax0) - (ay0 + az0);
+
+        i = wrap_add(i, (xNSign >> 1) & PrimeX);
+        j = wrap_add(j, (yNSign >> 1) & PrimeY);
+        k = wrap_add(k, (zNSign >> 1) & PrimeZ);
+
+        xNSign = -xNSign;
+        yNSign = -yNSign;
+        zNSign = -zNSign;
+
+        seed = ~seed;
+    }
+
+    return value * 32.69428253173828125f;
+}
+
+float open_simplex_2s_3d(int seed, float x, float y, float z)
+{
+    int i = fast_floor(x);
+    int j = fast_floor(y);
+    int k = fast_floor(z);
+    const float xi = x - i;
+    const float yi = y - j;
+    const float zi = z - k;
+
+    i = wrap_mul(i, PrimeX);
+    j = wrap_mul(j, PrimeY);
+    k = wrap_mul(k, PrimeZ);
+    const int seed2 = wrap_add(seed, 1293373);
+
+    const int xNMask = static_cast<int>(-0.5f - xi);
+    const int yNMask = static_cast<int>(-0.5f - yi);
+    const int zNMask = static_cast<int>(-0.5f - zi);
+
+    const float x0 = xi + xNMask;
+    const float y0 = yi + yNMask;
+    const float z0 = zi + zNMask;
+    const float a0 = 0.75f - x0 * x0 - y0 * y0 - z0 * z0;
+    float value = (a0 * a0) * (a0 * a0) *
+                  grad_coord(seed, wrap_add(i, xNMask & PrimeX), wrap_add(j, yNMask & PrimeY),
+                             wrap_add(k, zNMask & PrimeZ), x0, y0, z0);
+
+    const float x1 = xi - 0.5f;
+    const float y1 = yi - 0.5f;
+    const float z1 = zi - 0.5f;
+    const float a1 = 0.75f - x1 * x1 - y1 * y1 - z1 * z1;
+    value += (a1 * a1) * (a1 * a1) *
+             grad_coord(seed2, wrap_add(i, PrimeX), wrap_add(j, PrimeY), wrap_add(k, PrimeZ), x1, y1, z1);
+
+    const float xAFlipMask0 = ((xNMask | 1) << 1) * x1;
+    const float yAFlipMask0 = ((yNMask | 1) << 1) * y1;
+    const float zAFlipMask0 = ((zNMask | 1) << 1) * z1;
+    const float xAFlipMask1 = (-2 - (xNMask * 4)) * x1 - 1.0f;
+    const float yAFlipMask1 = (-2 - (yNMask * 4)) * y1 - 1.0f;
+    const float zAFlipMask1 = (-2 - (zNMask * 4)) * z1 - 1.0f;
+
+    const int xi0 = wrap_add(i, xNMask & PrimeX), xi0Flip = wrap_add(i, ~xNMask & PrimeX);
+    const int yj0 = wrap_add(j, yNMask & PrimeY), yj0Flip = wrap_add(j, ~yNMask & PrimeY);
+    const int zk0 = wrap_add(k, zNMask & PrimeZ), zk0Flip = wrap_add(k, ~zNMask & PrimeZ);
+    const int xi1 = wrap_add(i, PrimeX), xi1Flip = wrap_add(i, xNMask & wrap_mul(PrimeX, 2));
+    const int yj1 = wrap_add(j, PrimeY), yj1Flip = wrap_add(j, yNMask & wrap_mul(PrimeY, 2));
+    const int zk1 = wrap_add(k, PrimeZ), zk1Flip = wrap_add(k, zNMask & wrap_mul(PrimeZ, 2));
+
+    bool skip5 = false;
+    const float a2 = xAFlipMask0 + a0;
+    if (a2 > 0)
+    {
+        const float x2 = x0 - (xNMask | 1);
+        value += (a2 * a2) * (a2 * a2) * grad_coord(seed, xi0Flip, yj0, zk0, x2, y0, z0);
+    }
+    else
+    {
+        const float a3 = yAFlipMask0 + zAFlipMask0 + a0;
+        if (a3 > 0)
+        {
+            const float y3 = y0 - (yNMask | 1);
+            const float z3 = z0 - (zNMask | 1);
+            value += (a3 * a3) * (a3 * a3) * grad_coord(seed, xi0, yj0Flip, zk0Flip, x0, y3, z3);
+        }
+
+        const float a4 = xAFlipMask1 + a1;
+        if (a4 > 0)
+        {
+            const float x4 = (xNMask | 1) + x1;
+            value += (a4 * a4) * (a4 * a4) * grad_coord(seed2, xi1Flip, yj1, zk1, x4, y1, z1);
+            skip5 = true;
+        }
+    }
+
+    bool skip9 = false;
+    const float a6 = yAFlipMask0 + a0;
+    if (a6 > 0)
+    {
+        const float y6 = y0 - (yNMask | 1);
+        value += (a6 * a6) * (a6 * a6) * grad_coord(seed, xi0, yj0Flip, zk0, x0, y6, z0);
+    }
+    else
+    {
+        const float a7 = xAFlipMask0 + zAFlipMask0 + a0;
+        if (a7 > 0)
+        {
+            const float x7 = x0 - (xNMask | 1);
+            const float z7 = z0 - (zNMask | 1);
+            value += (a7 * a7) * (a7 * a7) * grad_coord(seed, xi0Flip, yj0, zk0Flip, x7, y0, z7);
+        }
+
+        const float a8 = yAFlipMask1 + a1;
+        if (a8 > 0)
+        {
+            const float y8 = (yNMask | 1) + y1;
+            value += (a8 * a8) * (a8 * a8) * grad_coord(seed2, xi1, yj1Flip, zk1, x1, y8, z1);
+            skip9 = true;
+        }
+    }
+
+    bool skipD = false;
+    const float aA = zAFlipMask0 + a0;
+    if (aA > 0)
+    {
+        const float zA = z0 - (zNMask | 1);
+        value += (aA * aA) * (aA * aA) * grad_coord(seed, xi0, yj0, zk0Flip, x0, y0, zA);
+    }
+    else
+    {
+        const float aB = xAFlipMask0 + yAFlipMask0 + a0;
+        if (aB > 0)
+        {
+            const float xB = x0 - (xNMask | 1);
+            const float yB = y0 - (yNMask | 1);
+            value += (aB * aB) * (aB * aB) * grad_coord(seed, xi0Flip, yj0Flip, zk0, xB, yB, z0);
+        }
+
+        const float aC = zAFlipMask1 + a1;
+        if (aC > 0)
+        {
+            const float zC = (zNMask | 1) + z1;
+            value += (aC * aC) * (aC * aC) * grad_coord(seed2, xi1, yj1, zk1Flip, x1, y1, zC);
+            skipD = true;
+        }
+    }
+
+    if (!skip5)
+    {
+        const float a5 = yAFlipMask1 + zAFlipMask1 + a1;
+        if (a5 > 0)
+        {
+            const float y5 = (yNMask | 1) + y1;
+            const float z5 = (zNMask | 1) + z1;
+            value += (a5 * a5) * (a5 * a5) * grad_coord(seed2, xi1, yj1Flip, zk1Flip, x1, y5, z5);
+        }
+    }
+
+    if (!skip9)
+    {
+        const float a9 = xAFlipMask1 + zAFlipMask1 + a1;
+        if (a9 > 0)
+        {
+            const float x9 = (xNMask | 1) + x1;
+            const float z9 = (zNMask | 1) + z1;
+            value += (a9 * a9) * (a9 * a9) * grad_coord(seed2, xi1Flip, yj1, zk1Flip, x9, y1, z9);
+        }
+    }
+
+    if (!skipD)
+    {
+        const float aD = xAFlipMask1 + yAFlipMask1 + a1;
+        if (aD > 0)
+        {
+            const float xD = (xNMask | 1) + x1;
+            const float yD = (yNMask | 1) + y1;
+            value += (aD * aD) * (aD * aD) * grad_coord(seed2, xi1Flip, yj1Flip, zk1, xD, yD, z1);
+        }
+    }
+
+    return value * 9.046026385208288f;
+}
+} // namespace
+
+#ifdef JAR_NOISE_SSE2
+namespace
+{
+// SSE2 has no 32 bit low multiply, two 64 bit ones on the even and odd lanes do the same
+inline __m128i mul_lo(__m128i a, __m128i b)
+{
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+inline __m128 select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// same rounding as fast_floor, including negative integers going one further down
+inline __m128i fast_floor(__m128 f)
+{
+    const __m128i i = _mm_cvttps_epi32(f);
+    return _mm_add_epi32(i, _mm_castps_si128(_mm_cmplt_ps(f, _mm_setzero_ps())));
+}
+
+// the table lookup has no SSE2 form, the hashes are vectorized and the gradients gathered per lane
+inline __m128 grad_coord(int seed, __m128i xPrimed, __m128i yPrimed, __m128 xd, __m128 yd)
+{
+    __m128i hash = _mm_xor_si128(_mm_set1_epi32(seed), _mm_xor_si128(xPrimed, yPrimed));
+    hash = mul_lo(hash, _mm_set1_epi32(0x27d4eb2d));
+    hash = _mm_xor_si128(hash, _mm_srai_epi32(hash, 15));
+    hash = _mm_and_si128(hash, _mm_set1_epi32(127 << 1));
+
+    alignas(16) int index[4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(index), hash);
+    const __m128 gx = _mm_setr_ps(Gradients2D[index[0]], Gradients2D[index[1]], Gradients2D[index[2]],
+                                  Gradients2D[index[3]]);
+    const __m128 gy = _mm_setr_ps(Gradients2D[index[0] | 1], Gradients2D[index[1] | 1], Gradients2D[index[2] | 1],
+                                  Gradients2D[index[3] | 1]);
+    return _mm_add_ps(_mm_mul_ps(xd, gx), _mm_mul_ps(yd, gy));
+}
+
+inline __m128 pow4(__m128 a)
+{
+    const __m128 a2 = _mm_mul_ps(a, a);
+    return _mm_mul_ps(a2, a2);
+}
+
+// contribution of lattice point (i, j) + (di, dj), offsets given per lane
+inline __m128 corner(int seed, __m128i i, __m128i j, __m128 di, __m128 dj, __m128 x0, __m128 y0, float radius,
+                     bool clamp)
+{
+    const __m128 g2 = _mm_mul_ps(_mm_add_ps(di, dj), _mm_set1_ps(G2));
+    const __m128 x = _mm_add_ps(x0, _mm_sub_ps(g2, di));
+    const __m128 y = _mm_add_ps(y0, _mm_sub_ps(g2, dj));
+    const __m128 a = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(radius), _mm_mul_ps(x, x)), _mm_mul_ps(y, y));
+    const __m128i xPrimed = _mm_add_epi32(i, mul_lo(_mm_cvtps_epi32(di), _mm_set1_epi32(PrimeX)));
+    const __m128i yPrimed = _mm_add_epi32(j, mul_lo(_mm_cvtps_epi32(dj), _mm_set1_epi32(PrimeY)));
+    const __m128 value = _mm_mul_ps(pow4(a), grad_coord(seed, xPrimed, yPrimed, x, y));
+    return clamp ? _mm_and_ps(_mm_cmpgt_ps(a, _mm_setzero_ps()), value) : value;
+}
+
+__m128 open_simplex_2_2d(int seed, __m128 x, __m128 y)
+{
+    const __m128i fi = fast_floor(x);
+    const __m128i fj = fast_floor(y);
+    const __m128 xi = _mm_sub_ps(x, _mm_cvtepi32_ps(fi));
+    const __m128 yi = _mm_sub_ps(y, _mm_cvtepi32_ps(fj));
+    const __m128 t = _mm_mul_ps(_mm_add_ps(xi, yi), _mm_set1_ps(G2));
+    const __m128 x0 = _mm_sub_ps(xi, t);
+    const __m128 y0 = _mm_sub_ps(yi, t);
+    const __m128i i = mul_lo(fi, _mm_set1_epi32(PrimeX));
+    const __m128i j = mul_lo(fj, _mm_set1_epi32(PrimeY));
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 upper = _mm_cmpgt_ps(y0, x0);
+    __m128 value = corner(seed, i, j, zero, zero, x0, y0, 0.5f, true);
+    value = _mm_add_ps(value, corner(seed, i, j, one, one, x0, y0, 0.5f, true));
+    value = _mm_add_ps(value, corner(seed, i, j, select(upper, zero, one), select(upper, one, zero), x0, y0, 0.5f, true));
+    return _mm_mul_ps(value, _mm_set1_ps(99.83685446303647f));
+}
+
+__m128 open_simplex_2s_2d(int seed, __m128 x, __m128 y)
+{
+    const __m128i fi = fast_floor(x);
+    const __m128i fj = fast_floor(y);
+    const __m128 xi = _mm_sub_ps(x, _mm_cvtepi32_ps(fi));
+    const __m128 yi = _mm_sub_ps(y, _mm_cvtepi32_ps(fj));
+    const __m128 t = _mm_mul_ps(_mm_add_ps(xi, yi), _mm_set1_ps(G2));
+    const __m128 x0 = _mm_sub_ps(xi, t);
+    const __m128 y0 = _mm_sub_ps(yi, t);
+    const __m128i i = mul_lo(fi, _mm_set1_epi32(PrimeX));
+    const __m128i j = mul_lo(fj, _mm_set1_epi32(PrimeY));
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+    __m128 value = corner(seed, i, j, zero, zero, x0, y0, 2.0f / 3.0f, false);
+    value = _mm_add_ps(value, corner(seed, i, j, one, one, x0, y0, 2.0f / 3.0f, false));
+
+    // the scalar branches as per lane selects of the two remaining lattice offsets
+    const __m128 xmyi = _mm_sub_ps(xi, yi);
+    const __m128 far = _mm_cmpgt_ps(t, _mm_set1_ps(G2));
+    const __m128 farX = _mm_cmpgt_ps(_mm_add_ps(xi, xmyi), one);
+    const __m128 farY = _mm_cmpgt_ps(_mm_sub_ps(yi, xmyi), one);
+    const __m128 nearX = _mm_cmplt_ps(_mm_add_ps(xi, xmyi), zero);
+    const __m128 nearY = _mm_cmplt_ps(yi, xmyi);
+
+    const __m128 di2 = select(far, select(farX, two, zero), select(nearX, minusOne, one));
+    const __m128 dj2 = select(far, one, zero);
+    const __m128 di3 = select(far, one, zero);
+    const __m128 dj3 = select(far, select(farY, two, zero), select(nearY, minusOne, one));
+    value = _mm_add_ps(value, corner(seed, i, j, di2, dj2, x0, y0, 2.0f / 3.0f, true));
+    value = _mm_add_ps(value, corner(seed, i, j, di3, dj3, x0, y0, 2.0f / 3.0f, true));
+    return _mm_mul_ps(value, _mm_set1_ps(18.24196194486065f));
+}
+
+inline __m128 lerp(__m128 a, __m128 b, __m128 t)
+{
+    return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+inline __m128 ping_pong(__m128 t)
+{
+    const __m128 whole = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(t, _mm_set1_ps(0.5f))));
+    t = _mm_sub_ps(t, _mm_mul_ps(whole, _mm_set1_ps(2.0f)));
+    return select(_mm_cmplt_ps(t, _mm_set1_ps(1.0f)), t, _mm_sub_ps(_mm_set1_ps(2.0f), t));
+}
+} // namespace
+#endif // JAR_NOISE_SSE2
+
+NoiseKernel::NoiseKernel(const Settings &settings) : _settings(settings)
+{
+    const float gain = std::abs(_settings.gain);
+    float amp = gain;
+    float ampFractal = 1.0f;
+    for (int i = 1; i < _settings.octaves; i++)
+    {
+        ampFractal += amp;
+        amp *= gain;
+    }
+    _fractalBounding = 1.0f / ampFractal;
+}
+
+float NoiseKernel::single_2d(int seed, float x, float y) const
+{
+    return _settings.noiseType == NOISE_OPEN_SIMPLEX_2 ? open_simplex_2_2d(seed, x, y)
+                                                       : open_simplex_2s_2d(seed, x, y);
+}
+
+float NoiseKernel::single_3d(int seed, float x, float y, float z) const
+{
+    return _settings.noiseType == NOISE_OPEN_SIMPLEX_2 ? open_simplex_2_3d(seed, x, y, z)
+                                                       : open_simplex_2s_3d(seed, x, y, z);
+}
+
+float NoiseKernel::fractal_2d(float x, float y) const
+{
+    int seed = _settings.seed;
+    if (_settings.fractalType == FRACTAL_NONE)
+        return single_2d(seed, x, y);
+
+    float sum = 0;
+    float amp = _fractalBounding;
+    for (int i = 0; i < _settings.octaves; i++)
+    {
+        float noise = single_2d(seed++, x, y);
+        switch (_settings.fractalType)
+        {
+        case FRACTAL_RIDGED:
+            noise = std::abs(noise);
+            sum += (noise * -2 + 1) * amp;
+            amp *= lerp(1.0f, 1 - noise, _settings.weightedStrength);
+            break;
+        case FRACTAL_PING_PONG:
+            noise = ping_pong((noise + 1) * _settings.pingPongStrength);
+            sum += (noise - 0.5f) * 2 * amp;
+            amp *= lerp(1.0f, noise, _settings.weightedStrength);
+            break;
+        default:
+            sum += noise * amp;
+            amp *= lerp(1.0f, std::min(noise + 1, 2.0f) * 0.5f, _settings.weightedStrength);
+            break;
+        }
+        x *= _settings.lacunarity;
+        y *= _settings.lacunarity;
+        amp *= _settings.gain;
+    }
+    return sum;
+}
+
+float NoiseKernel::fractal_3d(float x, float y, float z) const
+{
+    int seed = _settings.seed;
+    if (_settings.fractalType == FRACTAL_NONE)
+        return single_3d(seed, x, y, z);
+
+    float sum = 0;
+    float amp = _fractalBounding;
+    for (int i = 0; i < _settings.octaves; i++)
+    {
+        float noise = single_3d(seed++, x, y, z);
+        switch (_settings.fractalType)
+        {
+        case FRACTAL_RIDGED:
+            noise = std::abs(noise);
+            sum += (noise * -2 + 1) * amp;
+            amp *= lerp(1.0f, 1 - noise, _settings.weightedStrength);
+            break;
+        case FRACTAL_PING_PONG:
+            noise = ping_pong((noise + 1) * _settings.pingPongStrength);
+            sum += (noise - 0.5f) * 2 * amp;
+            amp *= lerp(1.0f, noise, _settings.weightedStrength);
+            break;
+        default:
+            sum += noise * amp;
+            amp *= lerp(1.0f, std::min(noise + 1, 2.0f) * 0.5f, _settings.weightedStrength);
+            break;
+        }
+        x *= _settings.lacunarity;
+        y *= _settings.lacunarity;
+        z *= _settings.lacunarity;
+        amp *= _settings.gain;
+    }
+    return sum;
+}
+
+void NoiseKernel::fractal_2d_x4(const float *x, const float *y, float *out) const
+{
+#ifdef JAR_NOISE_SSE2
+    __m128 px = _mm_loadu_ps(x);
+    __m128 py = _mm_loadu_ps(y);
+    int seed = _settings.seed;
+    const bool os2 = _settings.noiseType == NOISE_OPEN_SIMPLEX_2;
+    if (_settings.fractalType == FRACTAL_NONE)
+    {
+        _mm_storeu_ps(out, os2 ? open_simplex_2_2d(seed, px, py) : open_simplex_2s_2d(seed, px, py));
+        return;
+    }
+
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 weightedStrength = _mm_set1_ps(_settings.weightedStrength);
+    const __m128 lacunarity = _mm_set1_ps(_settings.lacunarity);
+    const __m128 gain = _mm_set1_ps(_settings.gain);
+    __m128 sum = _mm_setzero_ps();
+    __m128 amp = _mm_set1_ps(_fractalBounding);
+    for (int i = 0; i < _settings.octaves; i++)
+    {
+        __m128 noise = os2 ? open_simplex_2_2d(seed, px, py) : open_simplex_2s_2d(seed, px, py);
+        seed++;
+        switch (_settings.fractalType)
+        {
+        case FRACTAL_RIDGED:
+            noise = _mm_andnot_ps(_mm_set1_ps(-0.0f), noise);
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(noise, _mm_set1_ps(-2.0f)), one), amp));
+            amp = _mm_mul_ps(amp, lerp(one, _mm_sub_ps(one, noise), weightedStrength));
+            break;
+        case FRACTAL_PING_PONG:
+            noise = ping_pong(_mm_mul_ps(_mm_add_ps(noise, one), _mm_set1_ps(_settings.pingPongStrength)));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(noise, _mm_set1_ps(0.5f)), _mm_set1_ps(2.0f)), amp));
+            amp = _mm_mul_ps(amp, lerp(one, noise, weightedStrength));
+            break;
+        default:
+            sum = _mm_add_ps(sum, _mm_mul_ps(noise, amp));
+            amp = _mm_mul_ps(amp, lerp(one,
+                                       _mm_mul_ps(_mm_min_ps(_mm_add_ps(noise, one), _mm_set1_ps(2.0f)),
+                                                  _mm_set1_ps(0.5f)),
+                                       weightedStrength));
+            break;
+        }
+        px = _mm_mul_ps(px, lacunarity);
+        py = _mm_mul_ps(py, lacunarity);
+        amp = _mm_mul_ps(amp, gain);
+    }
+    _mm_storeu_ps(out, sum);
+#else
+    for (int i = 0; i < 4; i++)
+        out[i] = fractal_2d(x[i], y[i]);
+#endif
+}
+
+// frequency, then the skew FastNoiseLite applies to OpenSimplex2 inputs
+float NoiseKernel::get_noise_2d(float x, float y) const
+{
+    x = (x + _settings.offset.x) * _settings.frequency;
+    y = (y + _settings.offset.y) * _settings.frequency;
+    const float t = (x + y) * F2;
+    return fractal_2d(x + t, y + t);
+}
+
+// frequency, then the rotation FastNoiseLite applies to OpenSimplex2 inputs
+float NoiseKernel::get_noise_3d(float x, float y, float z) const
+{
+    x = (x + _settings.offset.x) * _settings.frequency;
+    y = (y + _settings.offset.y) * _settings.frequency;
+    z = (z + _settings.offset.z) * _settings.frequency;
+    const float r = (x + y + z) * (2.0f / 3.0f);
+    return fractal_3d(r - x, r - y, r - z);
+}
+
+void NoiseKernel::get_noise_2d_batch(const float *x, const float *y, float *out, size_t n) const
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        float sx[4], sy[4];
+        for (int l = 0; l < 4; l++)
+        {
+            const float px = (x[i + l] + _settings.offset.x) * _settings.frequency;
+            const float py = (y[i + l] + _settings.offset.y) * _settings.frequency;
+            const float t = (px + py) * F2;
+            sx[l] = px + t;
+            sy[l] = py + t;
+        }
+        fractal_2d_x4(sx, sy, out + i);
+    }
+    for (; i < n; i++)
+        out[i] = get_noise_2d(x[i], y[i]);
+}
+
+void NoiseKernel::get_noise_3d_batch(const float *x, const float *y, const float *z, float *out, size_t n) const
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = get_noise_3d(x[i], y[i], z[i]);
+}
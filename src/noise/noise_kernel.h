@@ -0,0 +1,71 @@
+#ifndef NOISE_KERNEL_H
+#define NOISE_KERNEL_H
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// Port of the OpenSimplex2 and OpenSimplex2S noise and the fractals of FastNoiseLite (MIT, Jordan Peck), the library
+// behind Godot's FastNoiseLite resource. For the settings it supports it returns the same values as the resource, but it
+// is a plain object, worker threads sample it without calling into the engine.
+class NoiseKernel
+{
+  public:
+    // values match the FastNoiseLite resource enums
+    enum NoiseType
+    {
+        NOISE_OPEN_SIMPLEX_2 = 0,
+        NOISE_OPEN_SIMPLEX_2S = 1,
+    };
+
+    enum FractalType
+    {
+        FRACTAL_NONE = 0,
+        FRACTAL_FBM = 1,
+        FRACTAL_RIDGED = 2,
+        FRACTAL_PING_PONG = 3,
+    };
+
+    // defaults of the FastNoiseLite resource
+    struct Settings
+    {
+        NoiseType noiseType = NOISE_OPEN_SIMPLEX_2S;
+        int seed = 0;
+        float frequency = 0.01f;
+        glm::vec3 offset{0.0f};
+        FractalType fractalType = FRACTAL_FBM;
+        int octaves = 5;
+        float lacunarity = 2.0f;
+        float gain = 0.5f;
+        float weightedStrength = 0.0f;
+        float pingPongStrength = 2.0f;
+    };
+
+    NoiseKernel() = default;
+    explicit NoiseKernel(const Settings &settings);
+
+    const Settings &get_settings() const
+    {
+        return _settings;
+    }
+
+    float get_noise_2d(float x, float y) const;
+    float get_noise_3d(float x, float y, float z) const;
+
+    // n points at once, 2d noise runs four points per step with SSE2
+    void get_noise_2d_batch(const float *x, const float *y, float *out, size_t n) const;
+    void get_noise_3d_batch(const float *x, const float *y, const float *z, float *out, size_t n) const;
+
+  private:
+    Settings _settings;
+    float _fractalBounding = 1.0f;
+
+    float single_2d(int seed, float x, float y) const;
+    float single_3d(int seed, float x, float y, float z) const;
+    float fractal_2d(float x, float y) const;
+    float fractal_3d(float x, float y, float z) const;
+
+    // four skewed points in, four fractal values out
+    void fractal_2d_x4(const float *x, const float *y, float *out) const;
+};
+
+#endif // NOISE_KERNEL_H
@@ -1,6 +1,7 @@
 #ifndef AABB_SDF_H
 #define AABB_SDF_H
 
+#include "sdf_simd.h"
 #include "signed_distance_field.h"
 
 class JarBoxSdf : public JarSignedDistanceField
@@ -11,6 +12,11 @@ class JarBoxSdf : public JarSignedDistanceField
     glm::vec3 _center;
     glm::vec3 _extent;
 
+    static float distance_from_q(const glm::vec3 &q)
+    {
+        return glm::length(glm::max(q, 0.0f)) + glm::min(glm::max(q.x, glm::max(q.y, q.z)), 0.0f);
+    }
+
   public:
     JarBoxSdf() : _center(0.0f, 0.0f, 0.0f), _extent(1.0f, 1.0f, 1.0f)
     {
@@ -34,8 +40,41 @@ class JarBoxSdf : public JarSignedDistanceField
 
     virtual float distance(const glm::vec3 &pos) const override
     {
-        glm::vec3 q = glm::abs(pos - _center) - _extent;
-        return glm::length(glm::max(q, 0.0f)) + glm::min(glm::max(q.x, glm::max(q.y, q.z)), 0.0f);
+        return distance_from_q(glm::abs(pos - _center) - _extent);
+    }
+
+    virtual void distance_batch(const glm::vec3 *positions, float *out, size_t n) const override
+    {
+        size_t i = 0;
+#ifdef JAR_SDF_SSE2
+        const SdfSimd::Vec3x4 center = SdfSimd::splat(_center);
+        const SdfSimd::Vec3x4 extent = SdfSimd::splat(_extent);
+        const __m128 zero = _mm_setzero_ps();
+        for (; i + 4 <= n; i += 4)
+        {
+            const SdfSimd::Vec3x4 p = SdfSimd::sub(SdfSimd::load(positions + i), center);
+            const SdfSimd::Vec3x4 q =
+                SdfSimd::sub({SdfSimd::abs(p.x), SdfSimd::abs(p.y), SdfSimd::abs(p.z)}, extent);
+            const __m128 outside =
+                SdfSimd::length({_mm_max_ps(q.x, zero), _mm_max_ps(q.y, zero), _mm_max_ps(q.z, zero)});
+            const __m128 inside = _mm_min_ps(_mm_max_ps(q.x, _mm_max_ps(q.y, q.z)), zero);
+            _mm_storeu_ps(out + i, _mm_add_ps(outside, inside));
+        }
+#endif
+        for (; i < n; ++i)
+            out[i] = JarBoxSdf::distance(positions[i]);
+    }
+
+    // exact, the distance only grows with each component of q = |p - center| - extent
+    virtual Range distance_range(const Bounds &bounds) const override
+    {
+        const glm::vec3 a = bounds.min - _center;
+        const glm::vec3 b = bounds.max - _center;
+        const glm::vec3 farthest = glm::max(glm::abs(a), glm::abs(b));
+        const glm::vec3 closest =
+            glm::mix(glm::min(glm::abs(a), glm::abs(b)), glm::vec3(0.0f),
+                     glm::vec3(glm::lessThanEqual(a, glm::vec3(0.0f)) && glm::greaterThanEqual(b, glm::vec3(0.0f))));
+        return {distance_from_q(closest - _extent), distance_from_q(farthest - _extent)};
     }
 
   protected:
@@ -1,6 +1,7 @@
 #ifndef PLANE_SDF_H
 #define PLANE_SDF_H
 
+#include "sdf_simd.h"
 #include "signed_distance_field.h"
 
 class JarPlaneSdf : public JarSignedDistanceField
@@ -42,6 +43,26 @@ class JarPlaneSdf : public JarSignedDistanceField
         return glm::dot(_normal, pos) + _d;
     }
 
+    virtual void distance_batch(const glm::vec3 *positions, float *out, size_t n) const override
+    {
+        size_t i = 0;
+#ifdef JAR_SDF_SSE2
+        const SdfSimd::Vec3x4 normal = SdfSimd::splat(_normal);
+        const __m128 d = _mm_set1_ps(_d);
+        for (; i + 4 <= n; i += 4)
+            _mm_storeu_ps(out + i, _mm_add_ps(SdfSimd::dot(SdfSimd::load(positions + i), normal), d));
+#endif
+        for (; i < n; ++i)
+            out[i] = JarPlaneSdf::distance(positions[i]);
+    }
+
+    virtual Range distance_range(const Bounds &bounds) const override
+    {
+        const float center = distance(bounds.get_center());
+        const float reach = glm::dot(glm::abs(_normal), bounds.get_size() * 0.5f);
+        return {center - reach, center + reach};
+    }
+
   protected:
     static void _bind_methods()
     {
@@ -1,6 +1,7 @@
 #ifndef PLANET_SDF_H
 #define PLANET_SDF_H
 
+#include "native_noise.h"
 #include "signed_distance_field.h"
 #include <godot_cpp/classes/fast_noise_lite.hpp>
 #include <glm/glm.hpp>
@@ -11,6 +12,8 @@ class JarPlanetSdf : public JarSignedDistanceField
 
 private:
     Ref<FastNoiseLite> _noiseLite;
+    NativeNoise _nativeNoise;
+    bool _useNativeNoise = true;
     glm::vec3 _center = glm::vec3(0.0f);
     float _radius = 1000.0f;
     float _noiseScale = 50.0f;
@@ -19,9 +22,28 @@ private:
 public:
     JarPlanetSdf() {}
 
-    void set_noise(Ref<FastNoiseLite> noise) { _noiseLite = noise; }
+    void set_noise(Ref<FastNoiseLite> noise) {
+        if (_noiseLite.is_valid())
+            _noiseLite->disconnect("changed", callable_mp(this, &JarPlanetSdf::noise_changed));
+        _noiseLite = noise;
+        if (_noiseLite.is_valid())
+            _noiseLite->connect("changed", callable_mp(this, &JarPlanetSdf::noise_changed));
+        noise_changed();
+    }
     Ref<FastNoiseLite> get_noise() const { return _noiseLite; }
 
+    void set_use_native_noise(bool value) {
+        _useNativeNoise = value;
+        noise_changed();
+    }
+    bool get_use_native_noise() const { return _useNativeNoise; }
+
+    virtual Dictionary get_statistics() const override {
+        Dictionary stats;
+        stats["native_noise_active"] = _nativeNoise.is_active();
+        return stats;
+    }
+
     void set_radius(float value) { _radius = value; }
     float get_radius() const { return _radius; }
 
@@ -36,6 +58,8 @@ public:
     float get_noise_scale() const { return _noiseScale; }
 
 protected:
+    void noise_changed() { _nativeNoise.configure(_noiseLite, _useNativeNoise); }
+
     // Spherical noise displacement using 3D noise
     float get_spherical_displacement(const glm::vec3& pos) const {
         if(_noiseLite.is_null()) return 0.0f;
@@ -46,11 +70,9 @@ protected:
         const float longitude = atan2(dir.z, dir.x);
         
         // Sample 3D noise with spherical warping
-        const float height = _noiseLite->get_noise_3d(
-            pos.x,
-            pos.y,
-            pos.z
-        );
+        const std::shared_ptr<const NoiseKernel> kernel = _nativeNoise.get_kernel();
+        const float height = kernel ? kernel->get_noise_3d(pos.x, pos.y, pos.z)
+                                    : _noiseLite->get_noise_3d(pos.x, pos.y, pos.z);
 
         if(height < 0.0f) return 0.5f * height * _noiseScale;
         return (height) * _noiseScale;
@@ -70,9 +92,25 @@ protected:
         return base_distance - displacement;
     }
 
+    // the sphere range, widened by the displacement which stays within [-0.5, 1] * _noiseScale
+    virtual Range distance_range(const Bounds& bounds) const override {
+        const glm::vec3 closest = glm::clamp(_center, bounds.min, bounds.max);
+        const glm::vec3 farthest = glm::max(glm::abs(bounds.min - _center), glm::abs(bounds.max - _center));
+        float minDisplacement = 0.0f;
+        float maxDisplacement = 0.0f;
+        if (_noiseLite.is_valid()) {
+            minDisplacement = std::min(-0.5f * _noiseScale, _noiseScale);
+            maxDisplacement = std::max(-0.5f * _noiseScale, _noiseScale);
+        }
+        return {glm::length(closest - _center) - _radius - std::max(maxDisplacement, 0.0f),
+                glm::length(farthest) - _radius - std::min(minDisplacement, 0.0f)};
+    }
+
     static void _bind_methods() {
         ClassDB::bind_method(D_METHOD("set_noise", "noise"), &JarPlanetSdf::set_noise);
         ClassDB::bind_method(D_METHOD("get_noise"), &JarPlanetSdf::get_noise);
+        ClassDB::bind_method(D_METHOD("set_use_native_noise", "value"), &JarPlanetSdf::set_use_native_noise);
+        ClassDB::bind_method(D_METHOD("get_use_native_noise"), &JarPlanetSdf::get_use_native_noise);
         ClassDB::bind_method(D_METHOD("set_radius", "radius"), &JarPlanetSdf::set_radius);
         ClassDB::bind_method(D_METHOD("get_radius"), &JarPlanetSdf::get_radius);
         ClassDB::bind_method(D_METHOD("set_center", "center"), &JarPlanetSdf::set_center);
@@ -82,6 +120,7 @@ protected:
 
         ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "noise", PROPERTY_HINT_RESOURCE_TYPE, "FastNoiseLite"), 
                     "set_noise", "get_noise");
+        ADD_PROPERTY(PropertyInfo(Variant::BOOL, "use_native_noise"), "set_use_native_noise", "get_use_native_noise");
         ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "radius"), "set_radius", "get_radius");
         ADD_PROPERTY(PropertyInfo(Variant::VECTOR3, "center"), "set_center", "get_center");
         ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "noise_scale"), "set_noise_scale", "get_noise_scale");
@@ -0,0 +1,65 @@
+#ifndef SDF_SIMD_H
+#define SDF_SIMD_H
+
+#include <glm/glm.hpp>
+
+// SSE2 is part of every x86-64 target, other architectures use the scalar fallback of distance_batch.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JAR_SDF_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef JAR_SDF_SSE2
+// Four points at once in structure of arrays layout, one lane per point.
+namespace SdfSimd
+{
+struct Vec3x4
+{
+    __m128 x, y, z;
+};
+
+// transposes four tightly packed glm::vec3 (12 floats) into lanes
+inline Vec3x4 load(const glm::vec3 *points)
+{
+    const float *f = &points[0].x;
+    const __m128 a = _mm_loadu_ps(f);     // x0 y0 z0 x1
+    const __m128 b = _mm_loadu_ps(f + 4); // y1 z1 x2 y2
+    const __m128 c = _mm_loadu_ps(f + 8); // z2 x3 y3 z3
+
+    const __m128 x01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 3, 0));  // x0 x1 y1 z1
+    const __m128 x23 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 3, 2));  // x2 y2 z2 x3
+    const __m128 yz01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1)); // y0 z0 y1 z1
+    const __m128 yz23 = _mm_shuffle_ps(x23, c, _MM_SHUFFLE(3, 2, 2, 1)); // y2 z2 y3 z3
+
+    return {_mm_shuffle_ps(x01, x23, _MM_SHUFFLE(3, 0, 1, 0)), _mm_shuffle_ps(yz01, yz23, _MM_SHUFFLE(2, 0, 2, 0)),
+            _mm_shuffle_ps(yz01, yz23, _MM_SHUFFLE(3, 1, 3, 1))};
+}
+
+inline Vec3x4 splat(const glm::vec3 &v)
+{
+    return {_mm_set1_ps(v.x), _mm_set1_ps(v.y), _mm_set1_ps(v.z)};
+}
+
+inline Vec3x4 sub(const Vec3x4 &a, const Vec3x4 &b)
+{
+    return {_mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z)};
+}
+
+inline __m128 dot(const Vec3x4 &a, const Vec3x4 &b)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+inline __m128 length(const Vec3x4 &a)
+{
+    return _mm_sqrt_ps(dot(a, a));
+}
+
+inline __m128 abs(__m128 v)
+{
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+} // namespace SdfSimd
+#endif // JAR_SDF_SSE2
+
+#endif // SDF_SIMD_H
@@ -1,11 +1,14 @@
 #ifndef JAR_SIGNED_DISTANCE_FIELD_H
 #define JAR_SIGNED_DISTANCE_FIELD_H
 
+#include "bounds.h"
 #include <algorithm>
 #include <glm/glm.hpp>
 #include <godot_cpp/classes/resource.hpp>
 #include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
+#include <limits>
 #include <optional>
 #include "sdf_operations.h"
 
@@ -18,6 +21,13 @@ class JarSignedDistanceField : public Resource
     GDCLASS(JarSignedDistanceField, Resource);
 
   public:
+    // every distance() inside of a region lies within [min, max]
+    struct Range
+    {
+        float min;
+        float max;
+    };
+
     virtual ~JarSignedDistanceField() = default;
 
     std::optional<glm::vec3> ray_march(const glm::vec3 &from, const glm::vec3 &dir, float epsilon = 0.01f,
@@ -47,10 +57,34 @@ class JarSignedDistanceField : public Resource
 
     virtual float distance(const glm::vec3 &pos) const = 0;
 
+    // evaluates n points in one call. Shapes override it to vectorize, or to share work between nearby points.
+    virtual void distance_batch(const glm::vec3 *positions, float *out, size_t n) const
+    {
+        for (size_t i = 0; i < n; ++i)
+            out[i] = distance(positions[i]);
+    }
+
+    // bounds of the field over a box, used to skip sampling regions that can't contain the surface.
+    // Optional, the default knows nothing about the field.
+    virtual Range distance_range(const Bounds & /*bounds*/) const
+    {
+        return {-std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity()};
+    }
+
+    // counters of caches or other internals, merged into the statistics of the terrain
+    virtual Dictionary get_statistics() const
+    {
+        return Dictionary();
+    }
+    virtual void reset_statistics()
+    {
+    }
+
   protected:
     static void _bind_methods()
     {
-        // Binding methods for Godot        
+        // Binding methods for Godot
+        ClassDB::bind_method(D_METHOD("get_statistics"), &JarSignedDistanceField::get_statistics);
 
     }
 };
@@ -1,6 +1,7 @@
 #ifndef SPHERE_SDF_H
 #define SPHERE_SDF_H
 
+#include "sdf_simd.h"
 #include "signed_distance_field.h"
 
 class JarSphereSdf : public JarSignedDistanceField
@@ -37,6 +38,29 @@ class JarSphereSdf : public JarSignedDistanceField
         return glm::length(pos - _center) - _radius;
     }
 
+    virtual void distance_batch(const glm::vec3 *positions, float *out, size_t n) const override
+    {
+        size_t i = 0;
+#ifdef JAR_SDF_SSE2
+        const SdfSimd::Vec3x4 center = SdfSimd::splat(_center);
+        const __m128 radius = _mm_set1_ps(_radius);
+        for (; i + 4 <= n; i += 4)
+        {
+            const SdfSimd::Vec3x4 p = SdfSimd::sub(SdfSimd::load(positions + i), center);
+            _mm_storeu_ps(out + i, _mm_sub_ps(SdfSimd::length(p), radius));
+        }
+#endif
+        for (; i < n; ++i)
+            out[i] = JarSphereSdf::distance(positions[i]);
+    }
+
+    virtual Range distance_range(const Bounds &bounds) const override
+    {
+        const glm::vec3 closest = glm::clamp(_center, bounds.min, bounds.max);
+        const glm::vec3 farthest = glm::max(glm::abs(bounds.min - _center), glm::abs(bounds.max - _center));
+        return {glm::length(closest - _center) - _radius, glm::length(farthest) - _radius};
+    }
+
   protected:
     static void _bind_methods()
     {
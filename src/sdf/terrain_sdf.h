@@ -1,8 +1,16 @@
 #ifndef TERRAIN_SDF_H
 #define TERRAIN_SDF_H
 
+#include "native_noise.h"
 #include "signed_distance_field.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
 #include <godot_cpp/classes/fast_noise_lite.hpp>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 class JarTerrainSdf : public JarSignedDistanceField
 {
@@ -10,10 +18,35 @@ class JarTerrainSdf : public JarSignedDistanceField
 
   private:
     Ref<FastNoiseLite> _noiseLite;
+    NativeNoise _nativeNoise;
+    bool _useNativeNoise = true;
     float _heightScale = 256.0f;
     const float Epsilon = 0.01f;
     const float InvEps = 1.0f / Epsilon;
 
+    // Height and slope of one xz column. Octree nodes of one size share their column with every node above and below
+    // them, so each column only needs the three noise lookups once per resolution level.
+    struct Column
+    {
+        float height;
+        Vector2 gradient;
+    };
+
+    // sharded, so the build threads rarely wait on each other
+    static constexpr int CacheShards = 64;
+    struct CacheShard
+    {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, Column> columns;
+    };
+
+    bool _heightCacheEnabled = true;
+    int _heightCacheSize = 1 << 18; // columns, over all shards
+    mutable std::array<CacheShard, CacheShards> _cache;
+    mutable std::atomic<uint64_t> _cacheHits{0};
+    mutable std::atomic<uint64_t> _cacheMisses{0};
+    mutable std::atomic<uint64_t> _noiseCalls{0};
+
   public:
     JarTerrainSdf()
     {
@@ -21,7 +54,12 @@ class JarTerrainSdf : public JarSignedDistanceField
 
     void set_noise(Ref<FastNoiseLite> noise)
     {
+        if (_noiseLite.is_valid())
+            _noiseLite->disconnect("changed", callable_mp(this, &JarTerrainSdf::noise_changed));
         _noiseLite = noise;
+        if (_noiseLite.is_valid())
+            _noiseLite->connect("changed", callable_mp(this, &JarTerrainSdf::noise_changed));
+        noise_changed();
     }
 
     Ref<FastNoiseLite> get_noise() const
@@ -29,9 +67,21 @@ class JarTerrainSdf : public JarSignedDistanceField
         return _noiseLite;
     }
 
+    void set_use_native_noise(bool value)
+    {
+        _useNativeNoise = value;
+        noise_changed();
+    }
+
+    bool get_use_native_noise() const
+    {
+        return _useNativeNoise;
+    }
+
     void set_height_scale(float heightScale)
     {
         _heightScale = heightScale;
+        clear_height_cache();
     }
 
     float get_height_scale() const
@@ -39,33 +89,244 @@ class JarTerrainSdf : public JarSignedDistanceField
         return _heightScale;
     }
 
+    void set_height_cache_enabled(bool value)
+    {
+        _heightCacheEnabled = value;
+        clear_height_cache();
+    }
+
+    bool get_height_cache_enabled() const
+    {
+        return _heightCacheEnabled;
+    }
+
+    void set_height_cache_size(int value)
+    {
+        _heightCacheSize = std::max(CacheShards, value);
+        clear_height_cache();
+    }
+
+    int get_height_cache_size() const
+    {
+        return _heightCacheSize;
+    }
+
+    void clear_height_cache()
+    {
+        for (auto &shard : _cache)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.columns.clear();
+        }
+    }
+
+    virtual Dictionary get_statistics() const override
+    {
+        const uint64_t hits = _cacheHits.load();
+        const uint64_t misses = _cacheMisses.load();
+        size_t columns = 0;
+        for (auto &shard : _cache)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            columns += shard.columns.size();
+        }
+
+        Dictionary stats;
+        stats["height_cache_hits"] = static_cast<int64_t>(hits);
+        stats["height_cache_misses"] = static_cast<int64_t>(misses);
+        stats["height_cache_hit_rate"] = hits + misses > 0 ? static_cast<double>(hits) / (hits + misses) : 0.0;
+        stats["height_cache_columns"] = static_cast<int64_t>(columns);
+        // every hit would have cost the three noise lookups of a column
+        stats["noise_calls"] = static_cast<int64_t>(_noiseCalls.load());
+        stats["noise_calls_saved"] = static_cast<int64_t>(hits * 3);
+        stats["native_noise_active"] = _nativeNoise.is_active();
+        return stats;
+    }
+
+    virtual void reset_statistics() override
+    {
+        _cacheHits = 0;
+        _cacheMisses = 0;
+        _noiseCalls = 0;
+    }
+
   protected:
-    float sample_height(const Vector2 &pos) const
+    void noise_changed()
+    {
+        _nativeNoise.configure(_noiseLite, _useNativeNoise);
+        clear_height_cache();
+    }
+
+    float to_height(float noise) const
     {
-        float noise = _noiseLite->get_noise_2d(pos.x, pos.y);
         return _heightScale * (noise > 0 ? 2.0f * noise : 1.0f * noise);
     }
 
-    Vector2 sample_gradient(const Vector2 &pos, float height) const
+    Column make_column(float height, float heightX, float heightZ) const
+    {
+        return {height, Vector2((heightX - height) * InvEps, (heightZ - height) * InvEps)};
+    }
+
+    float sample_height(const NoiseKernel *kernel, float x, float z) const
     {
-        float heightX = sample_height(pos + Vector2(Epsilon, 0));
-        float heightZ = sample_height(pos + Vector2(0, Epsilon));
+        _noiseCalls.fetch_add(1, std::memory_order_relaxed);
+        return to_height(kernel ? kernel->get_noise_2d(x, z) : _noiseLite->get_noise_2d(x, z));
+    }
+
+    Column compute_column(float x, float z) const
+    {
+        const std::shared_ptr<const NoiseKernel> kernel = _nativeNoise.get_kernel();
+        return make_column(sample_height(kernel.get(), x, z), sample_height(kernel.get(), x + Epsilon, z),
+                           sample_height(kernel.get(), x, z + Epsilon));
+    }
 
-        float gradientX = (heightX - height) * InvEps;
-        float gradientZ = (heightZ - height) * InvEps;
+    // node centers of one size sit on the same grid, the exact coordinates make a good key
+    static uint64_t column_key(float x, float z)
+    {
+        uint32_t xBits, zBits;
+        std::memcpy(&xBits, &x, sizeof(float));
+        std::memcpy(&zBits, &z, sizeof(float));
+        return (static_cast<uint64_t>(xBits) << 32) | zBits;
+    }
 
-        return Vector2(gradientX, gradientZ);
+    CacheShard &column_shard(uint64_t key) const
+    {
+        return _cache[(key * 0x9E3779B97F4A7C15ULL) >> 58];
     }
 
-    virtual float distance(const glm::vec3 &pos) const override
+    bool find_column(uint64_t key, Column &column) const
     {
-        Vector2 samplePos(pos.x, pos.z);
-        float height = sample_height(samplePos);
-        Vector2 gradient = sample_gradient(samplePos, height);
-        Vector3 normal = Vector3(gradient.x, 1, gradient.y).normalized();
+        CacheShard &shard = column_shard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.columns.find(key);
+        if (it == shard.columns.end())
+        {
+            _cacheMisses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        _cacheHits.fetch_add(1, std::memory_order_relaxed);
+        column = it->second;
+        return true;
+    }
 
+    // columns are computed outside of the lock, two threads may race on the same column which is harmless
+    void store_column(uint64_t key, const Column &column) const
+    {
+        CacheShard &shard = column_shard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (static_cast<int>(shard.columns.size()) >= _heightCacheSize / CacheShards)
+            shard.columns.clear();
+        shard.columns.emplace(key, column);
+    }
+
+    Column sample_column(float x, float z) const
+    {
+        if (!_heightCacheEnabled)
+            return compute_column(x, z);
+
+        const uint64_t key = column_key(x, z);
+        Column column;
+        if (find_column(key, column))
+            return column;
+        column = compute_column(x, z);
+        store_column(key, column);
+        return column;
+    }
+
+    static float column_distance(float y, const Column &column)
+    {
         // Adjust SDF based on gradient
-        return (pos.y - height) / sqrt(1 + gradient.x * gradient.x + gradient.y * gradient.y);
+        const Vector2 &gradient = column.gradient;
+        return (y - column.height) / sqrt(1 + gradient.x * gradient.x + gradient.y * gradient.y);
+    }
+
+    virtual float distance(const glm::vec3 &pos) const override
+    {
+        return column_distance(pos.y, sample_column(pos.x, pos.z));
+    }
+
+    // the columns missing from the cache go through the native noise in one batch, three lookups each. Positions
+    // sharing a column, like the samples above each other in a brick slice, are grouped by key first, so every
+    // column is looked up and evaluated once per batch.
+    virtual void distance_batch(const glm::vec3 *positions, float *out, size_t n) const override
+    {
+        const std::shared_ptr<const NoiseKernel> kernel = _nativeNoise.get_kernel();
+        if (!kernel)
+        {
+            JarSignedDistanceField::distance_batch(positions, out, n);
+            return;
+        }
+
+        thread_local std::vector<std::pair<uint64_t, size_t>> keys; // column key, position
+        thread_local std::vector<uint64_t> columnKeys;
+        thread_local std::vector<size_t> columnPositions; // one of the positions in the column
+        thread_local std::vector<size_t> columnOf;
+        thread_local std::vector<Column> columns;
+        thread_local std::vector<size_t> misses;
+        thread_local std::vector<float> xs, zs, noise;
+        keys.resize(n);
+        for (size_t i = 0; i < n; ++i)
+            keys[i] = {column_key(positions[i].x, positions[i].z), i};
+        std::sort(keys.begin(), keys.end());
+
+        columnKeys.clear();
+        columnPositions.clear();
+        columnOf.resize(n);
+        for (const auto &[key, i] : keys)
+        {
+            if (columnKeys.empty() || columnKeys.back() != key)
+            {
+                columnKeys.push_back(key);
+                columnPositions.push_back(i);
+            }
+            columnOf[i] = columnKeys.size() - 1;
+        }
+
+        columns.resize(columnKeys.size());
+        misses.clear();
+        for (size_t c = 0; c < columns.size(); ++c)
+            if (!_heightCacheEnabled || !find_column(columnKeys[c], columns[c]))
+                misses.push_back(c);
+
+        xs.resize(misses.size() * 3);
+        zs.resize(misses.size() * 3);
+        noise.resize(misses.size() * 3);
+        for (size_t m = 0; m < misses.size(); ++m)
+        {
+            const glm::vec3 &pos = positions[columnPositions[misses[m]]];
+            xs[3 * m] = pos.x;
+            zs[3 * m] = pos.z;
+            xs[3 * m + 1] = pos.x + Epsilon;
+            zs[3 * m + 1] = pos.z;
+            xs[3 * m + 2] = pos.x;
+            zs[3 * m + 2] = pos.z + Epsilon;
+        }
+        kernel->get_noise_2d_batch(xs.data(), zs.data(), noise.data(), noise.size());
+        _noiseCalls.fetch_add(noise.size(), std::memory_order_relaxed);
+
+        for (size_t m = 0; m < misses.size(); ++m)
+        {
+            const size_t c = misses[m];
+            columns[c] = make_column(to_height(noise[3 * m]), to_height(noise[3 * m + 1]), to_height(noise[3 * m + 2]));
+            if (_heightCacheEnabled)
+                store_column(columnKeys[c], columns[c]);
+        }
+
+        for (size_t i = 0; i < n; ++i)
+            out[i] = column_distance(positions[i].y, columns[columnOf[i]]);
+    }
+
+    // the height stays within [-1, 2] * _heightScale. Dividing by the slope keeps the sign of the vertical distance
+    // and only shrinks it, so above or below that band the sign is all that is known.
+    virtual Range distance_range(const Bounds &bounds) const override
+    {
+        const float minHeight = std::min(-_heightScale, 2.0f * _heightScale);
+        const float maxHeight = std::max(-_heightScale, 2.0f * _heightScale);
+        if (bounds.min.y > maxHeight)
+            return {std::numeric_limits<float>::min(), bounds.max.y - minHeight};
+        if (bounds.max.y < minHeight)
+            return {bounds.min.y - maxHeight, -std::numeric_limits<float>::min()};
+        return {bounds.min.y - maxHeight, bounds.max.y - minHeight};
     }
 
     static void _bind_methods()
@@ -75,9 +336,25 @@ class JarTerrainSdf : public JarSignedDistanceField
         ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "noise", PROPERTY_HINT_RESOURCE_TYPE, "FastNoiseLite"), "set_noise",
                      "get_noise");
 
+        ClassDB::bind_method(D_METHOD("set_use_native_noise", "value"), &JarTerrainSdf::set_use_native_noise);
+        ClassDB::bind_method(D_METHOD("get_use_native_noise"), &JarTerrainSdf::get_use_native_noise);
+        ADD_PROPERTY(PropertyInfo(Variant::BOOL, "use_native_noise"), "set_use_native_noise", "get_use_native_noise");
+
         ClassDB::bind_method(D_METHOD("set_height_scale", "height_scale"), &JarTerrainSdf::set_height_scale);
         ClassDB::bind_method(D_METHOD("get_height_scale"), &JarTerrainSdf::get_height_scale);
         ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "height_scale"), "set_height_scale", "get_height_scale");
+
+        ClassDB::bind_method(D_METHOD("set_height_cache_enabled", "value"), &JarTerrainSdf::set_height_cache_enabled);
+        ClassDB::bind_method(D_METHOD("get_height_cache_enabled"), &JarTerrainSdf::get_height_cache_enabled);
+        ADD_PROPERTY(PropertyInfo(Variant::BOOL, "height_cache_enabled"), "set_height_cache_enabled",
+                     "get_height_cache_enabled");
+
+        ClassDB::bind_method(D_METHOD("set_height_cache_size", "value"), &JarTerrainSdf::set_height_cache_size);
+        ClassDB::bind_method(D_METHOD("get_height_cache_size"), &JarTerrainSdf::get_height_cache_size);
+        ADD_PROPERTY(PropertyInfo(Variant::INT, "height_cache_size"), "set_height_cache_size",
+                     "get_height_cache_size");
+
+        ClassDB::bind_method(D_METHOD("clear_height_cache"), &JarTerrainSdf::clear_height_cache);
     }
 };
 
@@ -0,0 +1,108 @@
+#ifndef BLOCK_ALLOCATOR_H
+#define BLOCK_ALLOCATOR_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Hands out uninitialized storage for BlockSize contiguous objects of type T.
+// Blocks are carved out of large slabs and recycled through an intrusive free list, so allocating a block is a pointer
+// pop instead of BlockSize separate mallocs, and the objects of one block always sit next to each other in memory.
+// The allocator never runs constructors or destructors, that is up to the caller.
+template <typename T, size_t BlockSize, size_t BlocksPerSlab = 512> class BlockAllocator
+{
+  private:
+    // storage comes first, so a pointer to the first object is also a pointer to its block.
+    struct Block
+    {
+        alignas(T) unsigned char storage[sizeof(T) * BlockSize];
+        Block *next;
+        bool inUse;
+    };
+
+    std::vector<std::unique_ptr<Block[]>> _slabs;
+    Block *_freeList = nullptr;
+    size_t _blocksInUse = 0;
+    mutable std::mutex _mutex;
+
+    void grow()
+    {
+        std::unique_ptr<Block[]> slab(new Block[BlocksPerSlab]);
+        for (size_t i = BlocksPerSlab; i-- > 0;)
+        {
+            slab[i].inUse = false;
+            slab[i].next = _freeList;
+            _freeList = &slab[i];
+        }
+        _slabs.push_back(std::move(slab));
+    }
+
+  public:
+    BlockAllocator() = default;
+    BlockAllocator(const BlockAllocator &) = delete;
+    BlockAllocator &operator=(const BlockAllocator &) = delete;
+
+    T *allocate()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_freeList == nullptr)
+            grow();
+        Block *block = _freeList;
+        _freeList = block->next;
+        block->inUse = true;
+        ++_blocksInUse;
+        return reinterpret_cast<T *>(block->storage);
+    }
+
+    void deallocate(T *objects)
+    {
+        if (objects == nullptr)
+            return;
+        std::lock_guard<std::mutex> lock(_mutex);
+        Block *block = reinterpret_cast<Block *>(objects);
+        block->inUse = false;
+        block->next = _freeList;
+        _freeList = block;
+        --_blocksInUse;
+    }
+
+    // releases every slab at once, any pointer handed out before is invalid afterwards.
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _slabs.clear();
+        _freeList = nullptr;
+        _blocksInUse = 0;
+    }
+
+    // visits every block that is currently handed out, in memory order rather than allocation order.
+    // Blocks must not be allocated or released while iterating.
+    template <typename TFunc> void for_each_block(TFunc &&func) const
+    {
+        for (const auto &slab : _slabs)
+            for (size_t i = 0; i < BlocksPerSlab; ++i)
+                if (slab[i].inUse)
+                    func(reinterpret_cast<T *>(const_cast<unsigned char *>(slab[i].storage)));
+    }
+
+    size_t get_blocks_in_use() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _blocksInUse;
+    }
+
+    size_t get_blocks_reserved() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _slabs.size() * BlocksPerSlab;
+    }
+
+    size_t get_bytes_reserved() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _slabs.size() * BlocksPerSlab * sizeof(Block);
+    }
+};
+
+#endif // BLOCK_ALLOCATOR_H
@@ -0,0 +1,69 @@
+#include "job_benchmark.h"
+#include "job_system.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ms(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// a few hundred cycles of integer work per 64 iterations, the sum keeps the compiler from dropping it
+void busy_work(int iterations, std::atomic<uint64_t> &sink)
+{
+    uint64_t x = static_cast<uint64_t>(iterations) + 1;
+    for (int i = 0; i < iterations; ++i)
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    sink.fetch_add(x & 1, std::memory_order_relaxed);
+}
+
+double run_thread_pool(int threadCount, int jobCount, int workPerJob, std::atomic<uint64_t> &sink)
+{
+    ThreadPool pool(threadCount);
+    std::atomic<int> remaining{jobCount};
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < jobCount; ++i)
+        pool.enqueue([workPerJob, &sink, &remaining]() {
+            busy_work(workPerJob, sink);
+            remaining.fetch_sub(1, std::memory_order_release);
+        });
+    while (remaining.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+    return elapsed_ms(start);
+}
+
+double run_job_system(int threadCount, int jobCount, int workPerJob, std::atomic<uint64_t> &sink)
+{
+    JobSystem jobs(threadCount);
+    JobSystem::Counter counter{0};
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < jobCount; ++i)
+        jobs.submit([workPerJob, &sink]() { busy_work(workPerJob, sink); }, counter,
+                    static_cast<JobSystem::Priority>(i % JobSystem::PRIORITY_COUNT));
+    // like the pool run, the submitting thread only waits and does not help
+    while (counter.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+    return elapsed_ms(start);
+}
+} // namespace
+
+JobBenchmarkResult run_job_benchmark(int threadCount, int jobCount, int workPerJob)
+{
+    threadCount = std::max(1, threadCount);
+    jobCount = std::max(1, jobCount);
+    workPerJob = std::max(0, workPerJob);
+
+    std::atomic<uint64_t> sink{0};
+    JobBenchmarkResult result;
+    result.threadPoolMs = run_thread_pool(threadCount, jobCount, workPerJob, sink);
+    result.jobSystemMs = run_job_system(threadCount, jobCount, workPerJob, sink);
+    return result;
+}
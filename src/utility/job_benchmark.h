@@ -0,0 +1,15 @@
+#ifndef JOB_BENCHMARK_H
+#define JOB_BENCHMARK_H
+
+struct JobBenchmarkResult
+{
+    double threadPoolMs = 0.0;
+    double jobSystemMs = 0.0;
+};
+
+// Pushes jobCount small jobs from one thread through the old ThreadPool and through the JobSystem, both with
+// threadCount threads, and measures how long it takes until all of them ran. The jobs are as short as the cheap mesh
+// jobs of empty chunks, so the numbers are dominated by the scheduling cost.
+JobBenchmarkResult run_job_benchmark(int threadCount, int jobCount, int workPerJob);
+
+#endif // JOB_BENCHMARK_H
@@ -0,0 +1,149 @@
+#include "job_system.h"
+#include <algorithm>
+
+namespace
+{
+// set on the worker threads, so submit and wait know which deque belongs to the calling thread
+thread_local const JobSystem *t_jobSystem = nullptr;
+thread_local int t_workerIndex = -1;
+} // namespace
+
+JobSystem::JobSystem(int threadCount)
+{
+    if (threadCount <= 0)
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    for (int i = 0; i <= threadCount; ++i)
+        _queues.push_back(std::make_unique<Queue>());
+
+    for (int i = 0; i < threadCount; ++i)
+        _workers.emplace_back([this, i] { worker_loop(i); });
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _stop = true;
+    }
+    _wakeCondition.notify_all();
+    // workers only leave once every queue is empty, a job waiting on its children never loses them
+    for (auto &worker : _workers)
+        worker.join();
+}
+
+int JobSystem::get_thread_count() const
+{
+    return static_cast<int>(_workers.size());
+}
+
+int JobSystem::current_queue() const
+{
+    return t_jobSystem == this ? t_workerIndex : static_cast<int>(_workers.size());
+}
+
+void JobSystem::submit(Job job, Counter &counter, Priority priority)
+{
+    counter.fetch_add(1, std::memory_order_relaxed);
+    {
+        Queue &queue = *_queues[current_queue()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.lanes[priority].push_back({std::move(job), &counter});
+        queue.sizes[priority].store(static_cast<int>(queue.lanes[priority].size()), std::memory_order_relaxed);
+    }
+    // Pairs with worker_loop, which counts itself as sleeping before it checks _pending. Both are sequentially
+    // consistent, so either the worker sees the job or this sees the sleeper.
+    _pending.fetch_add(1);
+    if (_sleeping.load() <= 0)
+        return;
+    {
+        // taken so a worker can't miss the wake up between checking _pending and going to sleep
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+    }
+    _wakeCondition.notify_one();
+}
+
+void JobSystem::wait(Counter &counter)
+{
+    while (counter.load(std::memory_order_acquire) > 0)
+    {
+        if (!try_run_one())
+            std::this_thread::yield();
+    }
+}
+
+bool JobSystem::try_pop(int index, int lane, Entry &entry)
+{
+    Queue &queue = *_queues[index];
+    if (queue.sizes[lane].load(std::memory_order_relaxed) <= 0)
+        return false;
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    std::deque<Entry> &entries = queue.lanes[lane];
+    if (entries.empty())
+        return false;
+    entry = std::move(entries.back());
+    entries.pop_back();
+    queue.sizes[lane].store(static_cast<int>(entries.size()), std::memory_order_relaxed);
+    return true;
+}
+
+bool JobSystem::try_steal(int thief, int lane, Entry &entry)
+{
+    const int count = static_cast<int>(_queues.size());
+    for (int offset = 1; offset <= count; ++offset)
+    {
+        const int index = (thief + offset) % count;
+        if (index == thief)
+            continue;
+        Queue &queue = *_queues[index];
+        if (queue.sizes[lane].load(std::memory_order_relaxed) <= 0)
+            continue;
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        std::deque<Entry> &entries = queue.lanes[lane];
+        if (entries.empty())
+            continue;
+        entry = std::move(entries.front());
+        entries.pop_front();
+        queue.sizes[lane].store(static_cast<int>(entries.size()), std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+bool JobSystem::try_run_one()
+{
+    if (_pending.load(std::memory_order_acquire) <= 0)
+        return false;
+
+    const int index = current_queue();
+    Entry entry;
+    int lane = 0;
+    while (lane < PRIORITY_COUNT && !try_pop(index, lane, entry) && !try_steal(index, lane, entry))
+        ++lane;
+    if (lane == PRIORITY_COUNT)
+        return false;
+    _pending.fetch_sub(1, std::memory_order_relaxed);
+
+    entry.job();
+    entry.counter->fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void JobSystem::worker_loop(int index)
+{
+    t_jobSystem = this;
+    t_workerIndex = index;
+
+    while (true)
+    {
+        if (try_run_one())
+            continue;
+
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _sleeping.fetch_add(1);
+        _wakeCondition.wait(lock, [this] { return _stop || _pending.load() > 0; });
+        _sleeping.fetch_sub(1);
+        if (_stop && _pending.load(std::memory_order_acquire) <= 0)
+            return;
+    }
+}
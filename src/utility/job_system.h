@@ -0,0 +1,198 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Fork/join scheduler with one job deque per worker.
+// A worker pushes and pops its own jobs at the back, so it walks a tree depth first, and steals from the front of the
+// other deques when it runs dry, which is where the oldest and therefore largest pieces of work are.
+// Every submitted job counts towards a Counter, wait() returns once it dropped back to zero. A thread that waits keeps
+// running jobs in the meantime, so jobs can fork and wait on their own children without tying up a worker.
+// Jobs go into one of three priority lanes, every thread empties the urgent lane of all deques before it looks at the
+// next one. The octree build and the meshes of edited chunks are urgent, visible chunks come next, the rest is
+// background work.
+class JobSystem
+{
+  public:
+    using Counter = std::atomic<int>;
+
+    enum Priority
+    {
+        PRIORITY_URGENT,
+        PRIORITY_VISIBLE,
+        PRIORITY_BACKGROUND,
+        PRIORITY_COUNT
+    };
+
+    // Move-only callable. Callables of up to InlineSize bytes, which covers the lambdas of the build and the mesh
+    // jobs, are stored in place so submitting does not allocate. Larger ones fall back to the heap.
+    class Job
+    {
+      public:
+        static constexpr size_t InlineSize = 48;
+
+        Job() = default;
+
+        template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Job>>>
+        Job(F &&function)
+        {
+            using Fn = std::decay_t<F>;
+            if constexpr (sizeof(Fn) <= InlineSize && alignof(Fn) <= alignof(std::max_align_t) &&
+                          std::is_nothrow_move_constructible_v<Fn>)
+            {
+                new (_storage) Fn(std::forward<F>(function));
+                _ops = &InlineOps<Fn>::Table;
+            }
+            else
+            {
+                new (_storage) Fn *(new Fn(std::forward<F>(function)));
+                _ops = &HeapOps<Fn>::Table;
+            }
+        }
+
+        Job(Job &&other) noexcept
+        {
+            take(other);
+        }
+
+        Job &operator=(Job &&other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                take(other);
+            }
+            return *this;
+        }
+
+        Job(const Job &) = delete;
+        Job &operator=(const Job &) = delete;
+
+        ~Job()
+        {
+            reset();
+        }
+
+        void operator()()
+        {
+            _ops->invoke(_storage);
+        }
+
+      private:
+        struct Ops
+        {
+            void (*invoke)(void *);
+            void (*move)(void *destination, void *source);
+            void (*destroy)(void *);
+        };
+
+        template <typename Fn> struct InlineOps
+        {
+            static void invoke(void *p)
+            {
+                (*static_cast<Fn *>(p))();
+            }
+            static void move(void *destination, void *source)
+            {
+                new (destination) Fn(std::move(*static_cast<Fn *>(source)));
+                static_cast<Fn *>(source)->~Fn();
+            }
+            static void destroy(void *p)
+            {
+                static_cast<Fn *>(p)->~Fn();
+            }
+            static constexpr Ops Table{invoke, move, destroy};
+        };
+
+        template <typename Fn> struct HeapOps
+        {
+            static void invoke(void *p)
+            {
+                (**static_cast<Fn **>(p))();
+            }
+            static void move(void *destination, void *source)
+            {
+                new (destination) Fn *(*static_cast<Fn **>(source));
+            }
+            static void destroy(void *p)
+            {
+                delete *static_cast<Fn **>(p);
+            }
+            static constexpr Ops Table{invoke, move, destroy};
+        };
+
+        alignas(std::max_align_t) unsigned char _storage[InlineSize];
+        const Ops *_ops = nullptr;
+
+        void take(Job &other)
+        {
+            _ops = other._ops;
+            if (_ops != nullptr)
+                _ops->move(_storage, other._storage);
+            other._ops = nullptr;
+        }
+
+        void reset()
+        {
+            if (_ops != nullptr)
+                _ops->destroy(_storage);
+            _ops = nullptr;
+        }
+    };
+
+    // threadCount <= 0 uses one worker per hardware thread.
+    explicit JobSystem(int threadCount);
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    void submit(Job job, Counter &counter, Priority priority = PRIORITY_VISIBLE);
+    void wait(Counter &counter);
+
+    int get_thread_count() const;
+
+  private:
+    struct Entry
+    {
+        Job job;
+        Counter *counter = nullptr;
+    };
+
+    // sizes mirror the lanes and are only written under the mutex, thieves read them to skip empty lanes unlocked
+    struct Queue
+    {
+        std::mutex mutex;
+        std::array<std::deque<Entry>, PRIORITY_COUNT> lanes;
+        std::array<std::atomic<int>, PRIORITY_COUNT> sizes{};
+    };
+
+    // one queue per worker, the last one takes the jobs submitted from other threads
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _workers;
+
+    std::atomic<int> _pending{0};
+    std::atomic<int> _sleeping{0};
+    std::atomic<bool> _stop{false};
+    std::mutex _sleepMutex;
+    std::condition_variable _wakeCondition;
+
+    int current_queue() const;
+    bool try_pop(int index, int lane, Entry &entry);
+    bool try_steal(int thief, int lane, Entry &entry);
+    bool try_run_one();
+    void worker_loop(int index);
+};
+
+#endif // JOB_SYSTEM_H
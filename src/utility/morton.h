@@ -0,0 +1,100 @@
+#ifndef MORTON_H
+#define MORTON_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Morton (z-order) codes and octree locational keys.
+// A locational key is a morton code of the node coordinates at its depth, prefixed with a sentinel 1 bit:
+// the root is 1, its children 0b1xxx, grandchildren 0b1xxxyyy and so on. Each 3 bit digit is the child index
+// (bit 0 = +x, bit 1 = +y, bit 2 = +z), so parent and child keys are shifts, a neighbour key is a decode, an add and
+// an encode, and the depth follows from the position of the sentinel. Up to 21 levels fit in 64 bits.
+namespace Morton
+{
+static constexpr int MaxDepth = 21;
+static constexpr uint64_t RootKey = 1;
+
+inline uint64_t spread_bits(uint32_t v)
+{
+    uint64_t x = v & 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffULL;
+    x = (x | x << 16) & 0x1f0000ff0000ffULL;
+    x = (x | x << 8) & 0x100f00f00f00f00fULL;
+    x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+    x = (x | x << 2) & 0x1249249249249249ULL;
+    return x;
+}
+
+inline uint32_t compact_bits(uint64_t x)
+{
+    x &= 0x1249249249249249ULL;
+    x = (x ^ (x >> 2)) & 0x10c30c30c30c30c3ULL;
+    x = (x ^ (x >> 4)) & 0x100f00f00f00f00fULL;
+    x = (x ^ (x >> 8)) & 0x1f0000ff0000ffULL;
+    x = (x ^ (x >> 16)) & 0x1f00000000ffffULL;
+    x = (x ^ (x >> 32)) & 0x1fffffULL;
+    return static_cast<uint32_t>(x);
+}
+
+inline uint64_t encode(const glm::uvec3 &coords)
+{
+    return spread_bits(coords.x) | (spread_bits(coords.y) << 1) | (spread_bits(coords.z) << 2);
+}
+
+inline glm::uvec3 decode(uint64_t code)
+{
+    return glm::uvec3(compact_bits(code), compact_bits(code >> 1), compact_bits(code >> 2));
+}
+
+inline int key_depth(uint64_t key)
+{
+    int depth = 0;
+    while (key > 1)
+    {
+        key >>= 3;
+        ++depth;
+    }
+    return depth;
+}
+
+inline uint64_t make_key(const glm::uvec3 &coords, int depth)
+{
+    return (RootKey << (3 * depth)) | encode(coords);
+}
+
+// the coordinates of the node at its depth, in units of its edge length
+inline glm::uvec3 key_coords(uint64_t key)
+{
+    return decode(key & ~(RootKey << (3 * key_depth(key))));
+}
+
+inline uint64_t parent_key(uint64_t key)
+{
+    return key >> 3;
+}
+
+inline uint64_t child_key(uint64_t key, int childIndex)
+{
+    return (key << 3) | static_cast<uint64_t>(childIndex & 7);
+}
+
+inline int child_index(uint64_t key)
+{
+    return static_cast<int>(key & 7);
+}
+
+// the key of the node of the same depth offset nodes away, false if that lies outside of the tree
+inline bool neighbour_key(uint64_t key, const glm::ivec3 &offset, uint64_t &result)
+{
+    const int depth = key_depth(key);
+    const glm::ivec3 coords = glm::ivec3(key_coords(key)) + offset;
+    const int resolution = 1 << depth;
+    if (glm::any(glm::lessThan(coords, glm::ivec3(0))) ||
+        glm::any(glm::greaterThanEqual(coords, glm::ivec3(resolution))))
+        return false;
+    result = make_key(glm::uvec3(coords), depth);
+    return true;
+}
+} // namespace Morton
+
+#endif // MORTON_H
@@ -0,0 +1,76 @@
+#include "brick_edit_index.h"
+#include <algorithm>
+
+void BrickEditIndex::reset(float cellSize)
+{
+    _cellSize = cellSize;
+    _edits.clear();
+    _largeEdits.clear();
+    _cells.clear();
+}
+
+uint64_t BrickEditIndex::cell_key(const glm::ivec3 &cell)
+{
+    constexpr uint64_t Mask = (1ULL << 21) - 1;
+    return (static_cast<uint64_t>(cell.x) & Mask) | ((static_cast<uint64_t>(cell.y) & Mask) << 21) |
+           ((static_cast<uint64_t>(cell.z) & Mask) << 42);
+}
+
+int64_t BrickEditIndex::cell_count(const glm::ivec3 &first, const glm::ivec3 &last)
+{
+    const glm::i64vec3 extent = glm::i64vec3(last) - glm::i64vec3(first) + glm::i64vec3(1);
+    return extent.x * extent.y * extent.z;
+}
+
+void BrickEditIndex::add(const ModifySettings &settings)
+{
+    const uint32_t edit = static_cast<uint32_t>(_edits.size());
+    _edits.push_back(settings);
+
+    // a point in the bounds always lands in one of these cells, as floor keeps the order of the coordinates
+    const glm::ivec3 first = cell_of(settings.bounds.min);
+    const glm::ivec3 last = cell_of(settings.bounds.max);
+    if (cell_count(first, last) > MaxCellsPerEdit)
+    {
+        _largeEdits.push_back(edit);
+        return;
+    }
+    for (int z = first.z; z <= last.z; ++z)
+        for (int y = first.y; y <= last.y; ++y)
+            for (int x = first.x; x <= last.x; ++x)
+                _cells[cell_key(glm::ivec3(x, y, z))].push_back(edit);
+}
+
+void BrickEditIndex::find_in_bounds(const Bounds &bounds, std::vector<uint32_t> &edits) const
+{
+    const size_t begin = edits.size();
+    const glm::ivec3 first = cell_of(bounds.min);
+    const glm::ivec3 last = cell_of(bounds.max);
+    if (cell_count(first, last) > static_cast<int64_t>(_edits.size()))
+    {
+        // more cells than edits, e.g. the upper levels of the octree
+        for (uint32_t edit = 0; edit < _edits.size(); ++edit)
+            if (_edits[edit].bounds.intersects(bounds))
+                edits.push_back(edit);
+        return;
+    }
+
+    for (int z = first.z; z <= last.z; ++z)
+        for (int y = first.y; y <= last.y; ++y)
+            for (int x = first.x; x <= last.x; ++x)
+            {
+                const auto it = _cells.find(cell_key(glm::ivec3(x, y, z)));
+                if (it == _cells.end())
+                    continue;
+                for (const uint32_t edit : it->second)
+                    if (_edits[edit].bounds.intersects(bounds))
+                        edits.push_back(edit);
+            }
+    for (const uint32_t edit : _largeEdits)
+        if (_edits[edit].bounds.intersects(bounds))
+            edits.push_back(edit);
+
+    // an edit spanning several of the cells was found once per cell
+    std::sort(edits.begin() + begin, edits.end());
+    edits.erase(std::unique(edits.begin() + begin, edits.end()), edits.end());
+}
@@ -0,0 +1,65 @@
+#ifndef BRICK_EDIT_INDEX_H
+#define BRICK_EDIT_INDEX_H
+
+#include "bounds.h"
+#include "modify_settings.h"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+
+// The edits of a brick mode terrain, by the region they touch.
+// Every edit is kept in the order it was made and listed in each cell of a uniform grid that its bounds overlap, so a
+// sample only walks the edits of its own cell. Edits spanning more than MaxCellsPerEdit cells are rare and go to a
+// list every query includes instead.
+class BrickEditIndex
+{
+  public:
+    void reset(float cellSize);
+    void add(const ModifySettings &settings);
+
+    inline size_t size() const
+    {
+        return _edits.size();
+    }
+    inline const ModifySettings &get(uint32_t edit) const
+    {
+        return _edits[edit];
+    }
+
+    // calls f with every edit that may contain position, in the order they were made
+    template <typename F> void for_each_at(const glm::vec3 &position, F &&f) const
+    {
+        const auto it = _cells.find(cell_key(cell_of(position)));
+        const std::vector<uint32_t> *cell = it != _cells.end() ? &it->second : nullptr;
+        const size_t cellCount = cell != nullptr ? cell->size() : 0;
+        size_t i = 0, j = 0;
+        while (i < cellCount || j < _largeEdits.size())
+        {
+            if (j == _largeEdits.size() || (i < cellCount && (*cell)[i] < _largeEdits[j]))
+                f(_edits[(*cell)[i++]]);
+            else
+                f(_edits[_largeEdits[j++]]);
+        }
+    }
+
+    // the edits whose bounds intersect bounds, in the order they were made
+    void find_in_bounds(const Bounds &bounds, std::vector<uint32_t> &edits) const;
+
+  private:
+    static constexpr int64_t MaxCellsPerEdit = 512;
+
+    float _cellSize = 16.0f;
+    std::vector<ModifySettings> _edits;
+    std::vector<uint32_t> _largeEdits;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> _cells; // edits in ascending order
+
+    inline glm::ivec3 cell_of(const glm::vec3 &position) const
+    {
+        return glm::ivec3(glm::floor(position / _cellSize));
+    }
+    static uint64_t cell_key(const glm::ivec3 &cell);
+    static int64_t cell_count(const glm::ivec3 &first, const glm::ivec3 &last);
+};
+
+#endif // BRICK_EDIT_INDEX_H
@@ -0,0 +1,125 @@
+#include "chunk_backend.h"
+#include "voxel_chunk.h"
+#include "voxel_terrain.h"
+#include <algorithm>
+
+void ChunkBackend::set_pool_capacity(int value)
+{
+    _poolCapacity = static_cast<size_t>(std::max(0, value));
+}
+
+int64_t ChunkBackend::get_pool_high_water() const
+{
+    return static_cast<int64_t>(_poolHighWater);
+}
+
+int64_t ChunkBackend::get_chunks_created() const
+{
+    return _chunksCreated;
+}
+
+int64_t ChunkBackend::get_chunks_reused() const
+{
+    return _chunksReused;
+}
+
+int64_t ChunkBackend::get_chunks_trimmed() const
+{
+    return _chunksTrimmed;
+}
+
+size_t ChunkBackend::pool_trim_count(size_t poolSize)
+{
+    _poolHighWater = std::max(_poolHighWater, poolSize);
+    _poolLowWater = std::min(_poolLowWater, poolSize);
+    size_t trim = poolSize > _poolCapacity ? poolSize - _poolCapacity : 0;
+    if (++_trimFrame >= PoolTrimInterval)
+    {
+        trim = std::max(trim, _poolLowWater / 2);
+        _trimFrame = 0;
+        _poolLowWater = SIZE_MAX;
+    }
+    _chunksTrimmed += static_cast<int64_t>(trim);
+    return trim;
+}
+
+SceneChunkBackend::SceneChunkBackend(JarVoxelTerrain &terrain) : _terrain(terrain)
+{
+}
+
+// the chunks in the tree are freed with the terrain or stay its children after a new initialize, the pooled ones
+// belong to nobody else
+SceneChunkBackend::~SceneChunkBackend()
+{
+    for (JarVoxelChunk *chunk : _pool)
+        memdelete(chunk);
+}
+
+VoxelChunk *SceneChunkBackend::create_chunk()
+{
+    JarVoxelChunk *chunk;
+    if (_pool.empty())
+    {
+        chunk = _terrain.is_collision_only()
+                    ? JarVoxelChunk::create_collision_only(_terrain.get_collider_lod_threshold())
+                    : static_cast<JarVoxelChunk *>(_terrain.get_chunk_scene()->instantiate());
+        chunk->set_backend(this);
+        _chunksCreated++;
+    }
+    else
+    {
+        chunk = _pool.back();
+        _pool.pop_back();
+        chunk->show();
+        _chunksReused++;
+    }
+    _terrain.add_child(chunk);
+    _chunks.insert(chunk);
+    return chunk;
+}
+
+void SceneChunkBackend::release_chunk(JarVoxelChunk *chunk)
+{
+    std::lock_guard<std::mutex> lock(_releasedMutex);
+    _released.push_back(chunk);
+}
+
+void SceneChunkBackend::process()
+{
+    std::vector<JarVoxelChunk *> released;
+    {
+        std::lock_guard<std::mutex> lock(_releasedMutex);
+        released.swap(_released);
+    }
+    for (JarVoxelChunk *chunk : released)
+    {
+        chunk->reset_chunk();
+        _terrain.remove_child(chunk);
+        _chunks.erase(chunk);
+        _pool.push_back(chunk);
+    }
+
+    for (size_t trim = pool_trim_count(_pool.size()); trim > 0; --trim)
+    {
+        memdelete(_pool.back());
+        _pool.pop_back();
+    }
+}
+
+int64_t SceneChunkBackend::get_chunk_count() const
+{
+    return static_cast<int64_t>(_chunks.size());
+}
+
+int64_t SceneChunkBackend::get_memory_usage() const
+{
+    int64_t memory = 0;
+    for (const JarVoxelChunk *chunk : _chunks)
+        memory += chunk->get_memory_usage();
+    return memory;
+}
+
+int64_t SceneChunkBackend::get_pool_size() const
+{
+    return static_cast<int64_t>(_pool.size());
+}
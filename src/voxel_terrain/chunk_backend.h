@@ -0,0 +1,108 @@
+#ifndef CHUNK_BACKEND_H
+#define CHUNK_BACKEND_H
+
+#include "chunk_mesh_data.h"
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+class JarVoxelChunk;
+class JarVoxelTerrain;
+class VoxelOctreeNode;
+
+// What the octree sees of a chunk, whichever way it is put into the world.
+class VoxelChunk
+{
+  public:
+    virtual ~VoxelChunk() = default;
+
+    virtual int get_lod() const = 0;
+    virtual uint16_t get_boundaries() const = 0;
+    // main thread, takes ownership of chunkMeshData
+    virtual void update_chunk(JarVoxelTerrain &terrain, VoxelOctreeNode *node, ChunkMeshData *chunkMeshData) = 0;
+    // main thread
+    virtual void update_collision_mesh() = 0;
+    // estimated size of the surface and collider data the chunk holds
+    virtual int64_t get_memory_usage() const = 0;
+    // the octree is done with the chunk, callable from the build threads
+    virtual void release() = 0;
+};
+
+// Creates the chunks of a terrain. Released chunks go to a pool and are handed out again by create_chunk, which
+// saves the allocation of a new chunk and its engine objects on every lod change.
+class ChunkBackend
+{
+  public:
+    virtual ~ChunkBackend() = default;
+
+    // main thread
+    virtual VoxelChunk *create_chunk() = 0;
+    // main thread, every frame
+    virtual void process()
+    {
+    }
+    // main thread, the terrain left the scene tree
+    virtual void exit_world()
+    {
+    }
+
+    virtual int64_t get_chunk_count() const = 0;
+    virtual int64_t get_memory_usage() const = 0;
+    // released chunks kept for reuse
+    virtual int64_t get_pool_size() const = 0;
+
+    // pooled chunks above it are freed
+    void set_pool_capacity(int value);
+    int64_t get_pool_high_water() const;
+    int64_t get_chunks_created() const;
+    // every reused chunk is an allocation avoided
+    int64_t get_chunks_reused() const;
+    int64_t get_chunks_trimmed() const;
+
+  protected:
+    // process calls over which the smallest pool size is tracked
+    static constexpr int PoolTrimInterval = 120;
+
+    int64_t _chunksCreated = 0;
+    int64_t _chunksReused = 0;
+
+    // how many pooled chunks process should free: the ones above the capacity, and half of the ones that stayed in
+    // the pool for a whole trim interval, those are more than the lod changes need
+    size_t pool_trim_count(size_t poolSize);
+
+  private:
+    size_t _poolCapacity = 512;
+    size_t _poolHighWater = 0;
+    size_t _poolLowWater = SIZE_MAX;
+    int _trimFrame = 0;
+    int64_t _chunksTrimmed = 0;
+};
+
+// A JarVoxelChunk node per chunk, instantiated from the chunk scene of the terrain and added as its child. Released
+// chunks are cleared and taken out of the tree, reusing one only re-parents it.
+class SceneChunkBackend : public ChunkBackend
+{
+  public:
+    explicit SceneChunkBackend(JarVoxelTerrain &terrain);
+    ~SceneChunkBackend() override;
+
+    VoxelChunk *create_chunk() override;
+    void process() override;
+
+    int64_t get_chunk_count() const override;
+    int64_t get_memory_usage() const override;
+    int64_t get_pool_size() const override;
+
+    // any thread, the chunk leaves the tree with the next process
+    void release_chunk(JarVoxelChunk *chunk);
+
+  private:
+    JarVoxelTerrain &_terrain;
+    std::unordered_set<JarVoxelChunk *> _chunks; // children of the terrain, main thread
+    std::vector<JarVoxelChunk *> _pool;          // out of the tree, owned
+    std::mutex _releasedMutex;
+    std::vector<JarVoxelChunk *> _released;
+};
+
+#endif // CHUNK_BACKEND_H
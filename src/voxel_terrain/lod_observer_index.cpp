@@ -0,0 +1,82 @@
+#include "lod_observer_index.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// JarVoxelLoD measures positions in units of 16
+constexpr float ChunkSize = 16.0f;
+// as many as JarVoxelLoD::append_changed_shells looks at, coarse levels cost little once all observers share a cell
+constexpr int MaxLevels = 30;
+} // namespace
+
+void LodObserverIndex::clear()
+{
+    _levels.clear();
+}
+
+uint64_t LodObserverIndex::cell_key(const glm::ivec3 &cell)
+{
+    constexpr uint64_t Mask = (1ULL << 21) - 1;
+    return (static_cast<uint64_t>(cell.x) & Mask) | ((static_cast<uint64_t>(cell.y) & Mask) << 21) |
+           ((static_cast<uint64_t>(cell.z) & Mask) << 42);
+}
+
+void LodObserverIndex::build(const std::vector<glm::vec3> &observers, float octreeScale, int shellSize)
+{
+    _levels.clear();
+    _shellSize = std::max(1, shellSize);
+    if (observers.empty())
+        return;
+
+    for (int lod = 0; lod < MaxLevels; ++lod)
+    {
+        Level level;
+        level.cellSize = std::ldexp(octreeScale, lod + 2);
+        for (const glm::vec3 &observer : observers)
+        {
+            const glm::vec3 snapped = glm::floor(observer / ChunkSize / level.cellSize) * level.cellSize;
+            if (std::find(level.centers.begin(), level.centers.end(), snapped) != level.centers.end())
+                continue;
+            level.centers.push_back(snapped);
+
+            // a position in cell f is within shellSize cells of the center if f is in
+            // [center - shellSize, center + shellSize - 1] on every axis
+            const glm::ivec3 center(glm::round(snapped / level.cellSize));
+            for (int x = center.x - _shellSize; x < center.x + _shellSize; ++x)
+                for (int y = center.y - _shellSize; y < center.y + _shellSize; ++y)
+                    for (int z = center.z - _shellSize; z < center.z + _shellSize; ++z)
+                        level.cells.insert(cell_key(glm::ivec3(x, y, z)));
+        }
+        _levels.push_back(std::move(level));
+    }
+}
+
+// The cell set alone is exact away from the cell borders. On and close to one the shell test of JarVoxelLoD decides,
+// with the same arithmetic, so the index never disagrees with a loop over the observers.
+bool LodObserverIndex::contains(const Level &level, const glm::vec3 &position) const
+{
+    constexpr float BorderMargin = 1e-3f;
+    const glm::vec3 p = position / ChunkSize;
+    const glm::vec3 q = p / level.cellSize;
+    const glm::vec3 f = glm::floor(q);
+    const glm::vec3 fraction = q - f;
+    if (glm::all(glm::greaterThan(fraction, glm::vec3(BorderMargin))) &&
+        glm::all(glm::lessThan(fraction, glm::vec3(1.0f - BorderMargin))))
+        return level.cells.find(cell_key(glm::ivec3(f))) != level.cells.end();
+    for (const glm::vec3 &center : level.centers)
+    {
+        const glm::vec3 delta = glm::abs(p - center);
+        if (glm::max(delta.x, glm::max(delta.y, delta.z)) < level.cellSize * _shellSize)
+            return true;
+    }
+    return false;
+}
+
+int LodObserverIndex::lod_at(const glm::vec3 &position) const
+{
+    for (size_t lod = 0; lod < _levels.size(); ++lod)
+        if (contains(_levels[lod], position))
+            return static_cast<int>(lod);
+    return static_cast<int>(_levels.size());
+}
@@ -0,0 +1,60 @@
+#ifndef LOD_OBSERVER_INDEX_H
+#define LOD_OBSERVER_INDEX_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <unordered_set>
+#include <vector>
+
+// Finest lod shell around any of a set of observers, independent of how many there are.
+// A shell of level l is the cube of shellSize cells around the observer snapped to the grid of that level. Per level
+// the index holds every grid cell such a cube covers, so overlapping shells of observers close to each other merge
+// and a lookup walks up the levels with one hash probe each.
+class LodObserverIndex
+{
+  public:
+    // positions relative to the terrain, the levels match JarVoxelLoD::is_in_lod_shell
+    void build(const std::vector<glm::vec3> &observers, float octreeScale, int shellSize);
+    void clear();
+    bool empty() const
+    {
+        return _levels.empty();
+    }
+
+    // the smallest lod any of the observers asks for
+    int lod_at(const glm::vec3 &position) const;
+
+  private:
+    struct Level
+    {
+        float cellSize;
+        std::unordered_set<uint64_t> cells;
+        std::vector<glm::vec3> centers; // snapped observers in cells of 16, unique
+    };
+    std::vector<Level> _levels;
+    int _shellSize = 2;
+
+    static uint64_t cell_key(const glm::ivec3 &cell);
+    bool contains(const Level &level, const glm::vec3 &position) const;
+};
+
+// an observer besides the camera, position relative to the terrain
+struct LodObserver
+{
+    uint64_t id;
+    glm::vec3 position;
+};
+
+// Where the observers were at one lod update. Never changed once published, a mesh job keeps the state it was
+// submitted with while the main thread publishes the next one.
+struct LodObserverState
+{
+    glm::vec3 cameraPosition{0.0f};
+    glm::vec3 predictedPosition{0.0f};
+    bool predicting = false;
+    std::vector<LodObserver> observers;
+    // built past JarVoxelLoD::ObserverIndexThreshold observers, empty below
+    LodObserverIndex index;
+};
+
+#endif // LOD_OBSERVER_INDEX_H
@@ -23,7 +23,7 @@ const std::vector<std::vector<glm::ivec3>> AdaptiveMeshChunk::FaceOffsets = {YzO
 
 AdaptiveMeshChunk::AdaptiveMeshChunk(const JarVoxelTerrain &terrain, const VoxelOctreeNode &chunk)
 {
-    glm::vec3 chunkCenter = chunk._center;
+    chunkCenter = chunk.get_center(terrain.get_octree_scale());
     auto cameraPosition = terrain.get_camera_position();
     Octant = glm::ivec3(chunkCenter.x > cameraPosition.x ? 1 : -1, chunkCenter.y > cameraPosition.y ? 1 : -1,
                         chunkCenter.z > cameraPosition.z ? 1 : -1);
@@ -34,7 +34,8 @@ AdaptiveMeshChunk::AdaptiveMeshChunk(const JarVoxelTerrain &terrain, const Voxel
     // UtilityFunctions::print("Bounds: " + Utils::to_string(bounds));
 
     nodes.clear();
-    terrain.get_voxel_leaves_in_bounds(bounds, nodes);
+    centers.clear();
+    terrain.get_voxel_leaves_in_bounds(bounds, nodes, centers);
     bounds = bounds.expanded(0.001f);
 
     if (nodes.empty())
@@ -57,7 +57,9 @@ class AdaptiveMeshChunk
     }
 
     glm::ivec3 Octant{1, 1, 1};
+    glm::vec3 chunkCenter{0.0f};
     std::vector<VoxelOctreeNode *> nodes;
+    std::vector<glm::vec3> centers;
     std::vector<glm::ivec3> positions;
     std::vector<int> vertexIndices;
     std::vector<int> faceDirs;
@@ -48,10 +48,10 @@ ChunkMeshData *AdaptiveSurfaceNets::generate_mesh_data(const JarVoxelTerrain &te
             auto na = _meshChunk.nodes[ai];
             auto nb = _meshChunk.nodes[bi];
 
-            float valueA = na->get_value();
-            float valueB = nb->get_value();
-            glm::vec3 posA = na->_center;
-            glm::vec3 posB = nb->_center;
+            float valueA = na->get_value(terrain);
+            float valueB = nb->get_value(terrain);
+            glm::vec3 posA = _meshChunk.centers[ai];
+            glm::vec3 posB = _meshChunk.centers[bi];
             // glm::vec3 nPosA = _meshChunk.Offsets[edge.x];
             // glm::vec3 nPosB = _meshChunk.Offsets[edge.y];
 
@@ -79,16 +79,16 @@ ChunkMeshData *AdaptiveSurfaceNets::generate_mesh_data(const JarVoxelTerrain &te
            
 
         _meshChunk.faceDirs[node_id] =
-            (static_cast<int>(flip * glm::sign(glm::sign(_meshChunk.nodes[neighbours[6]]->get_value()) -
-                                               glm::sign(_meshChunk.nodes[neighbours[7]]->get_value())) +
+            (static_cast<int>(flip * glm::sign(glm::sign(_meshChunk.nodes[neighbours[6]]->get_value(terrain)) -
+                                               glm::sign(_meshChunk.nodes[neighbours[7]]->get_value(terrain))) +
                               1))
                 << 0 |
-            (static_cast<int>(flip * glm::sign(glm::sign(_meshChunk.nodes[neighbours[7]]->get_value()) -
-                                               glm::sign(_meshChunk.nodes[neighbours[5]]->get_value())) +
+            (static_cast<int>(flip * glm::sign(glm::sign(_meshChunk.nodes[neighbours[7]]->get_value(terrain)) -
+                                               glm::sign(_meshChunk.nodes[neighbours[5]]->get_value(terrain))) +
                               1))
                 << 2 |
-            (static_cast<int>(flip * glm::sign(glm::sign(_meshChunk.nodes[neighbours[3]]->get_value()) -
-                                               glm::sign(_meshChunk.nodes[neighbours[7]]->get_value())) +
+            (static_cast<int>(flip * glm::sign(glm::sign(_meshChunk.nodes[neighbours[3]]->get_value(terrain)) -
+                                               glm::sign(_meshChunk.nodes[neighbours[7]]->get_value(terrain))) +
                               1))
                 << 4;
 
@@ -108,7 +108,7 @@ ChunkMeshData *AdaptiveSurfaceNets::generate_mesh_data(const JarVoxelTerrain &te
             normal = glm::vec3(0,0,0);
         }
 
-        vertexPosition -= _chunk->_center;
+        vertexPosition -= _meshChunk.chunkCenter;
         _meshChunk.vertexIndices[node_id] = (_verts.size());
         _verts.push_back({vertexPosition.x, vertexPosition.y, vertexPosition.z});
         _normals.push_back({normal.x, normal.y, normal.z});
@@ -188,8 +188,10 @@ ChunkMeshData *AdaptiveSurfaceNets::generate_mesh_data(const JarVoxelTerrain &te
     meshData[Mesh::ARRAY_COLOR] = _colors;
     meshData[Mesh::ARRAY_INDEX] = _indices;
 
-    return new ChunkMeshData(meshData, _meshChunk.get_real_lod(), _meshChunk.is_edge_chunk(),
-                             _chunk->get_bounds(terrain.get_octree_scale()));
+    ChunkMeshData *output = new ChunkMeshData(meshData, _meshChunk.get_real_lod(), _meshChunk.is_edge_chunk(),
+                                              _chunk->get_bounds(terrain.get_octree_scale()));
+    output->compressed = terrain.is_compress_vertices();
+    return output;
 }
 
 inline void AdaptiveSurfaceNets::add_tri(int n0, int n1, int n2, bool flip)
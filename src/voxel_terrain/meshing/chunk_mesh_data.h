@@ -5,11 +5,8 @@
 #include <godot_cpp/variant/array.hpp>
 #include <godot_cpp/variant/vector3.hpp>
 #include <vector>
-#include <unordered_map>
 #include "bounds.h"
 #include <glm/glm.hpp>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
 
 using namespace godot;
 
@@ -23,8 +20,17 @@ class ChunkMeshData
     int lod;
     uint16_t boundaries;
     bool edge_chunk;
+    // uploaded with ARRAY_FLAG_COMPRESS_ATTRIBUTES, see JarVoxelTerrain::set_compress_vertices
+    bool compressed = false;
     Bounds bounds;
-    std::unordered_map<glm::ivec3, int> edgeVertices;
+    // vertices along the lod boundary, ring vertices in ring coordinates
+    struct EdgeVertex
+    {
+        glm::ivec3 position;
+        int vertex;
+        bool ring;
+    };
+    std::vector<EdgeVertex> edgeVertices;
     // ChunkDetailData chunk_detail_data;
 
     bool has_collision_mesh() const
@@ -57,6 +63,26 @@ class ChunkMeshData
         return collision_mesh;
     }
 
+    // bytes of the surface arrays, about what the mesh keeps once it is uploaded
+    int64_t get_memory_usage() const
+    {
+        if (mesh_array.size() < Mesh::ARRAY_MAX)
+            return 0;
+        const PackedVector3Array verts = mesh_array[Mesh::ARRAY_VERTEX];
+        const PackedVector3Array normals = mesh_array[Mesh::ARRAY_NORMAL];
+        const PackedColorArray colors = mesh_array[Mesh::ARRAY_COLOR];
+        const PackedInt32Array indices = mesh_array[Mesh::ARRAY_INDEX];
+        // rgba8 colors and 16 bit indices below 65536 vertices either way, godot converts them when uploading
+        const int64_t indexSize = verts.size() < (1 << 16) ? sizeof(uint16_t) : sizeof(uint32_t);
+        const int64_t shared = colors.size() * 4 + indices.size() * indexSize;
+        if (compressed)
+        {
+            // 16 bit positions within the aabb, octahedral normals
+            return verts.size() * (4 * sizeof(uint16_t)) + normals.size() * (2 * sizeof(uint16_t)) + shared;
+        }
+        return (verts.size() + normals.size()) * sizeof(Vector3) + shared;
+    }
+
     // bool should_have_grass_texture() const {
     //     return chunk_detail_data.should_have_grass_texture();
     // }
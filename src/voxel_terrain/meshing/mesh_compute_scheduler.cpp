@@ -4,28 +4,161 @@
 // #include "adaptive_surface_nets/adaptive_surface_nets.h"
 #include "stitched_surface_nets/stitched_surface_nets.h"
 #include "voxel_octree_node.h"
+#include <algorithm>
+#include <chrono>
 
-MeshComputeScheduler::MeshComputeScheduler(int maxConcurrentTasks)
-    : _maxConcurrentTasks(maxConcurrentTasks), _activeTasks(0), _totalTris(0),
-      _prevTris(0), threadPool(maxConcurrentTasks) {}
+namespace {
+// above any distance in a terrain, still fine enough to order the prefetched
+// chunks by theirs
+constexpr float PrefetchScore = 1e7f;
 
-void MeshComputeScheduler::enqueue(VoxelOctreeNode &node) {
-  ChunksToAdd.push(&node);
+int64_t now_usec() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
 }
+} // namespace
 
-void MeshComputeScheduler::process(JarVoxelTerrain &terrain) {
+bool MeshJobQueue::push(const MeshJob &job, float score) {
+  auto it = _index.find(job.node);
+  if (it != _index.end()) {
+    const size_t i = it->second;
+    _heap[i].job.generation = job.generation;
+    _heap[i].job.urgent |= job.urgent;
+    if (score < _heap[i].score) {
+      _heap[i].score = score;
+      sift_up(i);
+    }
+    return false;
+  }
+  _index.emplace(job.node, _heap.size());
+  _heap.push_back({job, score});
+  sift_up(_heap.size() - 1);
+  return true;
+}
+
+bool MeshJobQueue::try_pop(MeshJob &out) {
+  if (_heap.empty())
+    return false;
+  out = _heap.front().job;
+  swap_entries(0, _heap.size() - 1);
+  _index.erase(out.node);
+  _heap.pop_back();
+  if (!_heap.empty())
+    sift_down(0);
+  return true;
+}
+
+void MeshJobQueue::swap_entries(size_t a, size_t b) {
+  std::swap(_heap[a], _heap[b]);
+  _index[_heap[a].job.node] = a;
+  _index[_heap[b].job.node] = b;
+}
+
+void MeshJobQueue::sift_up(size_t i) {
+  while (i > 0) {
+    const size_t parent = (i - 1) / 2;
+    if (_heap[parent].score <= _heap[i].score)
+      return;
+    swap_entries(i, parent);
+    i = parent;
+  }
+}
+
+void MeshJobQueue::sift_down(size_t i) {
+  const size_t count = _heap.size();
+  while (true) {
+    size_t smallest = i;
+    const size_t left = 2 * i + 1;
+    const size_t right = left + 1;
+    if (left < count && _heap[left].score < _heap[smallest].score)
+      smallest = left;
+    if (right < count && _heap[right].score < _heap[smallest].score)
+      smallest = right;
+    if (smallest == i)
+      return;
+    swap_entries(i, smallest);
+    i = smallest;
+  }
+}
+
+MeshComputeScheduler::MeshComputeScheduler(JobSystem &jobs,
+                                           int maxConcurrentTasks)
+    : _jobs(jobs), _maxConcurrentTasks(std::max(1, maxConcurrentTasks)),
+      _taskLimit(_maxConcurrentTasks), _totalTris(0), _prevTris(0) {}
+
+MeshComputeScheduler::~MeshComputeScheduler() { _jobs.wait(_activeTasks); }
+
+void MeshComputeScheduler::enqueue(VoxelOctreeNode &node,
+                                   const glm::vec3 &center, uint8_t generation,
+                                   bool urgent) {
+  ChunksToAdd.push({&node, center, generation, urgent});
+}
+
+void MeshComputeScheduler::set_max_concurrent_tasks(int value) {
+  _maxConcurrentTasks = std::max(1, value);
+  _taskLimit = std::min(_taskLimit, _maxConcurrentTasks);
+}
+
+void MeshComputeScheduler::process(JarVoxelTerrain &terrain, double delta) {
   _prevTris = _totalTris;
+  adapt_task_limit(delta);
   if (!terrain.is_building()) {
     process_queue(terrain);
   }
-  while (!ChunksToProcess.empty()) {
-    std::pair<VoxelOctreeNode *, ChunkMeshData *> tuple;
-    if (ChunksToProcess.try_pop(tuple)) {
-      auto [node, chunkMeshData] = tuple;
-      // if(!node->is_chunk(terrain)) return;
-      node->update_chunk(terrain, chunkMeshData);
+  std::pair<MeshJob, ChunkMeshData *> tuple;
+  while (ChunksToProcess.try_pop(tuple)) {
+    auto [job, chunkMeshData] = tuple;
+    // superseded after the worker handed it over, a newer job is pending
+    if (!job.is_current()) {
+      delete chunkMeshData;
+      _resultsDiscarded++;
+      continue;
     }
+    _finishedMeshes.push_back({job, chunkMeshData, 0.0f});
   }
+  apply_finished_meshes(terrain);
+}
+
+// Applying a mesh instantiates the chunk scene, uploads the surface and
+// generates details, a burst of them would stall the frame. The chunks
+// closest to the camera or another observer go first, until the budget is
+// used up.
+void MeshComputeScheduler::apply_finished_meshes(JarVoxelTerrain &terrain) {
+  _lastApplyTimeUsec = 0;
+  if (_finishedMeshes.empty())
+    return;
+
+  const glm::vec3 camera = terrain.get_camera_position();
+  for (FinishedMesh &mesh : _finishedMeshes) {
+    mesh.distance =
+        std::min(glm::distance(mesh.job.center, camera),
+                 terrain.get_other_observer_distance(mesh.job.center));
+  }
+  // farthest first, so the closest pop off the back
+  std::sort(_finishedMeshes.begin(), _finishedMeshes.end(),
+            [](const FinishedMesh &a, const FinishedMesh &b) {
+              return a.distance > b.distance;
+            });
+
+  const int64_t start = now_usec();
+  while (!_finishedMeshes.empty()) {
+    const FinishedMesh mesh = _finishedMeshes.back();
+    _finishedMeshes.pop_back();
+    // went stale while it waited for its turn
+    if (!mesh.job.is_current()) {
+      delete mesh.data;
+      _resultsDiscarded++;
+      continue;
+    }
+    mesh.job.node->update_chunk(terrain, mesh.data);
+    _meshesApplied++;
+    // checked after applying, so every frame makes progress
+    if (_applyBudgetUsec > 0 && now_usec() - start >= _applyBudgetUsec)
+      break;
+  }
+  _lastApplyTimeUsec = now_usec() - start;
+  _applyTimeUsec += _lastApplyTimeUsec;
 }
 
 void MeshComputeScheduler::process_queue(JarVoxelTerrain &terrain) {
@@ -33,23 +166,178 @@ void MeshComputeScheduler::process_queue(JarVoxelTerrain &terrain) {
   // build() thread, pop() from here on the main thread. try_pop() is the
   // correct pattern — it atomically checks-and-pops under the mutex, avoiding a
   // race between a separate empty() check and top()+pop().
-  VoxelOctreeNode *chunk;
-  while (ChunksToAdd.try_pop(chunk)) {
-    run_task(terrain, *chunk);
+  MeshJob job;
+  while (ChunksToAdd.try_pop(job)) {
+    if (!_queuedJobs.push(job, score(terrain, job)))
+      _jobsCancelled++; // replaced the queued job of the same chunk
+  }
+  update_priorities(terrain);
+
+  // The job system only gets a few jobs at a time, the rest waits here where a
+  // camera move can still reorder it.
+  while (_activeTasks < _taskLimit && _queuedJobs.try_pop(job)) {
+    run_task(terrain, job);
   }
 }
 
+// The workers compete with the main thread for cores, and every finished mesh
+// adds to the apply backlog. Long frames cut the limit by a quarter, frames
+// on time raise it by one while it is what holds the queue back. The limit
+// moves at most four times a second so the smoothed frame time can follow.
+void MeshComputeScheduler::adapt_task_limit(double delta) {
+  if (_targetFrameUsec <= 0) {
+    _taskLimit = _maxConcurrentTasks;
+    return;
+  }
+  const double frameUsec = delta * 1000000.0;
+  _frameTimeUsec = _frameTimeUsec > 0.0
+                       ? _frameTimeUsec + 0.1 * (frameUsec - _frameTimeUsec)
+                       : frameUsec;
+  _sinceAdaptUsec += static_cast<int64_t>(frameUsec);
+  if (_sinceAdaptUsec < 250000)
+    return;
+  _sinceAdaptUsec = 0;
+
+  if (_frameTimeUsec > 1.25 * _targetFrameUsec)
+    _taskLimit = std::max(1, _taskLimit * 3 / 4);
+  else if (_frameTimeUsec < 1.05 * _targetFrameUsec &&
+           _activeTasks >= _taskLimit && !_queuedJobs.empty())
+    _taskLimit = std::min(_maxConcurrentTasks, _taskLimit + 1);
+}
+
+// Lower is sooner. The distance to the camera, stretched up to four times
+// for chunks behind it, plus one chunk length per level of detail so coarse
+// chunks at the same distance wait for the fine ones. Chunks closer to
+// another observer use that distance, there is no view direction for those.
+// Urgent jobs score below zero, nearest first. Prefetched chunks only matter
+// once the camera gets there, they go after everything else until then.
+float MeshComputeScheduler::score(const JarVoxelTerrain &terrain,
+                                  const MeshJob &job) const {
+  const VoxelOctreeNode &chunk = *job.node;
+  const float scale = terrain.get_octree_scale();
+  const glm::vec3 toChunk = job.center - terrain.get_camera_position();
+  float distance = glm::length(toChunk);
+  const float otherDistance = terrain.get_other_observer_distance(job.center);
+  const bool nearOther = otherDistance < distance;
+  if (nearOther)
+    distance = otherDistance;
+  if (job.urgent)
+    return -1.0f / (1.0f + distance);
+  const glm::vec3 forward = terrain.get_camera_forward();
+  // 0 straight ahead, 1 straight behind
+  const float behind =
+      distance > 0.0f && !nearOther
+          ? 0.5f * (1.0f - glm::dot(toChunk / distance, forward))
+          : 0.0f;
+  const float chunkLength = terrain.get_chunk_size() * scale;
+  const float score =
+      distance * (1.0f + 3.0f * behind) + chunk.get_lod() * chunkLength;
+  return terrain.is_lod_prefetch(job.center) ? PrefetchScore + score : score;
+}
+
+// rescoring is linear in the queue length, so it only happens once the
+// camera moved or turned noticeably
+void MeshComputeScheduler::update_priorities(const JarVoxelTerrain &terrain) {
+  const glm::vec3 position = terrain.get_camera_position();
+  const glm::vec3 forward = terrain.get_camera_forward();
+  if (position == _scoredCameraPosition &&
+      (forward == _scoredCameraForward ||
+       glm::dot(forward, _scoredCameraForward) > 0.985f)) // about 10 degrees
+    return;
+  _scoredCameraPosition = position;
+  _scoredCameraForward = forward;
+  _queuedJobs.reprioritize(
+      [this, &terrain](const MeshJob &job) { return score(terrain, job); });
+}
+
+// the lane in the job system, chunks behind the camera are background work
+// unless another observer is closer to them
+JobSystem::Priority
+MeshComputeScheduler::priority(const JarVoxelTerrain &terrain,
+                               const MeshJob &job) const {
+  if (job.urgent)
+    return JobSystem::PRIORITY_URGENT;
+  if (terrain.is_lod_prefetch(job.center))
+    return JobSystem::PRIORITY_BACKGROUND;
+  const glm::vec3 toChunk = job.center - terrain.get_camera_position();
+  // someone else is right there
+  if (terrain.get_other_observer_distance(job.center) < glm::length(toChunk))
+    return JobSystem::PRIORITY_VISIBLE;
+  return glm::dot(toChunk, terrain.get_camera_forward()) < 0.0f
+             ? JobSystem::PRIORITY_BACKGROUND
+             : JobSystem::PRIORITY_VISIBLE;
+}
+
 void MeshComputeScheduler::run_task(const JarVoxelTerrain &terrain,
-                                    VoxelOctreeNode &chunk) {
-  if (!chunk.is_chunk(terrain))
+                                    const MeshJob &job) {
+  if (!job.is_current() || !job.node->is_chunk(terrain)) {
+    _jobsCancelled++;
     return;
-  threadPool.enqueue([this, &terrain, &chunk]() {
-    // auto meshCompute = AdaptiveSurfaceNets(terrain, chunk);
-    auto meshCompute = StitchedSurfaceNets(terrain, chunk);
-    ChunkMeshData *chunkMeshData = meshCompute.generate_mesh_data(terrain);
-    ChunksToProcess.push(std::make_pair(&(chunk), chunkMeshData));
-    _activeTasks--;
-  });
+  }
+  // the observers of now, the main thread publishes new ones while the job
+  // runs instead of changing these
+  _jobs.submit([this, &terrain, job,
+                observers = terrain.get_observer_state()]() {
+    const int64_t start = now_usec();
+    // the stamp is checked again before the expensive steps, so a job that
+    // went stale while waiting in its lane or while meshing stops early
+    ChunkMeshData *chunkMeshData = nullptr;
+    if (job.is_current() && terrain.is_collision_only() &&
+        job.node->get_lod() > terrain.get_collider_lod_threshold()) {
+      // nobody renders it and it gets no collider, the chunk only needs to
+      // know its place in the tree
+      chunkMeshData = new ChunkMeshData(
+          Array(), job.node->get_lod(), false,
+          job.node->get_bounds(terrain.get_octree_scale(), job.center));
+      chunkMeshData->boundaries =
+          job.node->compute_boundaries(terrain, job.center, *observers);
+    } else if (job.is_current()) {
+      // auto meshCompute = AdaptiveSurfaceNets(terrain, *job.node);
+      auto meshCompute =
+          StitchedSurfaceNets(terrain, *job.node, job.center, *observers);
+      chunkMeshData = meshCompute.generate_mesh_data(
+          terrain, [&job]() { return !job.is_current(); });
+    }
+    const int64_t elapsed = now_usec() - start;
+
+    if (job.is_current()) {
+      _jobsCompleted++;
+      _meshTimeUsec += elapsed;
+      // by the boundaries like benchmark_meshing, an empty mesh comes back
+      // as nullptr but was still meshed with its seams
+      const uint16_t boundaries =
+          chunkMeshData != nullptr
+              ? chunkMeshData->boundaries
+              : job.node->compute_boundaries(terrain, job.center, *observers);
+      if (boundaries != 0) {
+        _edgeJobsCompleted++;
+        _edgeMeshTimeUsec += elapsed;
+      }
+      ChunksToProcess.push(std::make_pair(job, chunkMeshData));
+    } else {
+      // dropped here, the main thread never sees it
+      delete chunkMeshData;
+      _jobsCancelled++;
+      _wastedTimeUsec += elapsed;
+    }
+  }, _activeTasks, priority(terrain, job));
+}
+
+double MeshComputeScheduler::get_mesh_time_saved_ms() const {
+  const uint64_t completed = _jobsCompleted.load();
+  if (completed == 0)
+    return 0.0;
+  const double averageUsec =
+      static_cast<double>(_meshTimeUsec.load()) / completed;
+  return std::max(0.0, averageUsec * _jobsCancelled.load() -
+                           _wastedTimeUsec.load()) /
+         1000.0;
+}
+
+// the counter first, a job hands over its result before it counts as done
+bool MeshComputeScheduler::is_idle() const {
+  return _activeTasks.load() == 0 && ChunksToProcess.empty() &&
+         ChunksToAdd.empty() && _queuedJobs.empty() && _finishedMeshes.empty();
 }
 
 void MeshComputeScheduler::clear_queue() {
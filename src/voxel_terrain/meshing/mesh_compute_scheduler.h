@@ -2,15 +2,16 @@
 #define MESH_COMPUTE_SCHEDULER_H
 
 #include "concurrentqueue.h" // moodycamel lock-free queue
-#include "utility/thread_pool.h"
+#include "utility/job_system.h"
 #include "voxel_octree_node.h"
 #include <atomic>
 #include <functional>
 #include <godot_cpp/classes/node3d.hpp>
 #include <godot_cpp/variant/vector3.hpp>
 #include <mutex>
-#include <queue> // std::priority_queue (ConcurrentPriorityQueue) + moodycamel internals
+#include <queue>
 #include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -37,76 +38,165 @@ private:
   moodycamel::ConcurrentQueue<T> _q;
 };
 
+// A chunk to mesh, stamped with the mesh generation of its node when it was
+// enqueued. The node moves on to a new generation when a newer build or edit
+// makes the job obsolete, the job then gets dropped wherever it is.
+// Urgent jobs come from edits, they go ahead of everything else. The center
+// comes from the traversal that enqueued the job, it is rescored often and
+// nodes would have to decode their key for it.
+struct MeshJob {
+  VoxelOctreeNode *node = nullptr;
+  glm::vec3 center{0.0f};
+  uint8_t generation = 0;
+  bool urgent = false;
+
+  bool is_current() const { return node->is_mesh_generation_current(generation); }
+};
+
 // ---------------------------------------------------------------------------
-// ConcurrentPriorityQueue — mutex-wrapped std::priority_queue.
-// moodycamel has no lock-free priority-queue variant, so a mutex is used.
-// push() is called from the background build() thread;
-// try_pop() / empty() are called from the main thread in process_queue().
-// The mutex is therefore genuinely required here.
+// MeshJobQueue — indexed binary min-heap of mesh jobs ordered by score.
+// Main thread only, jobs from the build threads arrive through a lock-free
+// inbox first. The index by node lets a re-queued chunk update its entry in
+// place, and reprioritize() rescores everything and re-heaps in O(n) when the
+// camera moved.
 // ---------------------------------------------------------------------------
-template <typename T, typename Comparator = std::less<T>>
-class ConcurrentPriorityQueue {
+class MeshJobQueue {
 public:
-  void push(const T &value) {
-    std::lock_guard<std::mutex> lock(_mutex);
-    _pq.push(value);
+  // Returns false if the node was queued already, the entry then carries the
+  // generation of the new job and the old one is gone. An urgent job makes
+  // the entry urgent too and moves it up.
+  bool push(const MeshJob &job, float score);
+  bool try_pop(MeshJob &out);
+
+  template <typename ScoreFn> void reprioritize(ScoreFn score) {
+    for (Entry &entry : _heap)
+      entry.score = score(entry.job);
+    for (size_t i = _heap.size() / 2; i-- > 0;)
+      sift_down(i);
   }
 
-  // Returns true and sets 'out' if the queue was non-empty; false otherwise.
-  bool try_pop(T &out) {
-    std::lock_guard<std::mutex> lock(_mutex);
-    if (_pq.empty())
-      return false;
-    out = _pq.top();
-    _pq.pop();
-    return true;
-  }
-
-  bool empty() const {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _pq.empty();
-  }
+  bool empty() const { return _heap.empty(); }
+  size_t size() const { return _heap.size(); }
 
 private:
-  std::priority_queue<T, std::vector<T>, Comparator> _pq;
-  mutable std::mutex _mutex;
+  struct Entry {
+    MeshJob job;
+    float score;
+  };
+  std::vector<Entry> _heap;
+  std::unordered_map<const VoxelOctreeNode *, size_t> _index;
+
+  void swap_entries(size_t a, size_t b);
+  void sift_up(size_t i);
+  void sift_down(size_t i);
 };
 
 // ---------------------------------------------------------------------------
 
-struct ChunkComparator {
-  bool operator()(const VoxelOctreeNode *a, const VoxelOctreeNode *b) const {
-    return a->get_lod() > b->get_lod();
-  }
-};
-
 class MeshComputeScheduler {
 private:
-  // push() called from background build() thread; pop() from main thread.
-  // Mutex is genuinely required — see ConcurrentPriorityQueue above.
-  ConcurrentPriorityQueue<VoxelOctreeNode *, ChunkComparator> ChunksToAdd;
-  ConcurrentQueue<std::pair<VoxelOctreeNode *, ChunkMeshData *>>
-      ChunksToProcess;
-
-  std::atomic<int> _activeTasks;
+  // push() called from the build threads, moved into _queuedJobs on the
+  // main thread, which scores and hands them to the job system.
+  ConcurrentQueue<MeshJob> ChunksToAdd;
+  MeshJobQueue _queuedJobs;
+  ConcurrentQueue<std::pair<MeshJob, ChunkMeshData *>> ChunksToProcess;
+
+  // Finished meshes waiting to be applied, main thread only. Whatever does
+  // not fit into the budget of a frame is carried over to the next one.
+  struct FinishedMesh {
+    MeshJob job;
+    ChunkMeshData *data;
+    float distance; // to the camera, refreshed every frame
+  };
+  std::vector<FinishedMesh> _finishedMeshes;
+  int64_t _applyBudgetUsec = 0; // 0 applies everything at once
+  int64_t _lastApplyTimeUsec = 0;
+  int64_t _applyTimeUsec = 0; // all frames
+  uint64_t _meshesApplied = 0;
+
+  // Shared with the octree build. _activeTasks counts the mesh jobs handed
+  // to it that did not finish yet.
+  JobSystem &_jobs;
+  JobSystem::Counter _activeTasks{0};
   int _maxConcurrentTasks;
 
-  ThreadPool threadPool;
+  // The jobs in flight are capped at _taskLimit, which moves between 1 and
+  // _maxConcurrentTasks with the smoothed frame time.
+  int _taskLimit;
+  int64_t _targetFrameUsec = 0; // 0 keeps the limit at _maxConcurrentTasks
+  double _frameTimeUsec = 0.0;
+  int64_t _sinceAdaptUsec = 0;
+
+  // the view the queued jobs were scored for
+  glm::vec3 _scoredCameraPosition{0.0f};
+  glm::vec3 _scoredCameraForward{0.0f};
 
   // Debug variables
   int _totalTris;
   int _prevTris;
 
+  // Statistics. Cancelled jobs were dropped before or while meshing, the time
+  // they spent until then is wasted. Discarded results went stale between the
+  // worker and the main thread, their time counts as mesh time.
+  std::atomic<uint64_t> _jobsCompleted{0};
+  std::atomic<uint64_t> _jobsCancelled{0};
+  std::atomic<uint64_t> _resultsDiscarded{0};
+  std::atomic<int64_t> _meshTimeUsec{0};
+  std::atomic<int64_t> _wastedTimeUsec{0};
+  // the completed jobs that meshed a chunk on a lod boundary, included above
+  std::atomic<uint64_t> _edgeJobsCompleted{0};
+  std::atomic<int64_t> _edgeMeshTimeUsec{0};
+
   void process_queue(JarVoxelTerrain &terrain);
-  void run_task(const JarVoxelTerrain &terrain, VoxelOctreeNode &chunk);
+  void adapt_task_limit(double delta);
+  float score(const JarVoxelTerrain &terrain, const MeshJob &job) const;
+  JobSystem::Priority priority(const JarVoxelTerrain &terrain,
+                               const MeshJob &job) const;
+  void update_priorities(const JarVoxelTerrain &terrain);
+  void apply_finished_meshes(JarVoxelTerrain &terrain);
+  void run_task(const JarVoxelTerrain &terrain, const MeshJob &job);
 
 public:
-  MeshComputeScheduler(int maxConcurrentTasks);
-  void enqueue(VoxelOctreeNode &node);
-  void process(JarVoxelTerrain &terrain);
+  MeshComputeScheduler(JobSystem &jobs, int maxConcurrentTasks);
+  // waits for the jobs in flight, they point back at the scheduler
+  ~MeshComputeScheduler();
+  void enqueue(VoxelOctreeNode &node, const glm::vec3 &center,
+               uint8_t generation, bool urgent);
+  void process(JarVoxelTerrain &terrain, double delta);
   void clear_queue();
 
+  void set_max_concurrent_tasks(int value);
+  void set_target_frame_usec(int64_t target) { _targetFrameUsec = target; }
+  int get_task_limit() const { return _taskLimit; }
+  int get_jobs_in_flight() const { return _activeTasks.load(); }
+  double get_frame_time_ms() const { return _frameTimeUsec / 1000.0; }
+
+  void set_apply_budget_usec(int64_t budget) { _applyBudgetUsec = budget; }
+  size_t get_apply_backlog() const { return _finishedMeshes.size(); }
+  double get_last_apply_time_ms() const { return _lastApplyTimeUsec / 1000.0; }
+  double get_apply_time_ms() const { return _applyTimeUsec / 1000.0; }
+  uint64_t get_meshes_applied() const { return _meshesApplied; }
+
+  uint64_t get_jobs_completed() const { return _jobsCompleted.load(); }
+  uint64_t get_jobs_cancelled() const { return _jobsCancelled.load(); }
+  uint64_t get_results_discarded() const { return _resultsDiscarded.load(); }
+  double get_mesh_time_ms() const { return _meshTimeUsec.load() / 1000.0; }
+  uint64_t get_edge_jobs_completed() const { return _edgeJobsCompleted.load(); }
+  double get_edge_mesh_time_ms() const {
+    return _edgeMeshTimeUsec.load() / 1000.0;
+  }
+  // what the cancelled jobs would have cost at the average cost of a
+  // finished one, minus what they already spent
+  double get_mesh_time_saved_ms() const;
+
+  // True while jobs of the last build have not reached the queue yet. Queued
+  // jobs don't hold up the next build, the ones it makes obsolete are
+  // dropped by their stamp.
   bool is_meshing() { return !ChunksToAdd.empty(); }
+  size_t get_queue_length() const { return _queuedJobs.size(); }
+  // True once no job is left anywhere between the inbox and the apply
+  // backlog, nothing points at a node of the tree then.
+  bool is_idle() const;
 };
 
 #endif // MESH_COMPUTE_SCHEDULER_H
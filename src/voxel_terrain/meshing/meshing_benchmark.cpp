@@ -0,0 +1,195 @@
+#include "meshing_benchmark.h"
+#include "stitched_surface_nets/stitched_surface_nets.h"
+#include "voxel_terrain.h"
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ms(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// The gathers of the mesher before they moved to fixed-size arrays, with a vector per cell and per quad face.
+bool legacy_get_neighbours(const StitchedMeshChunk &chunk, const glm::ivec3 &pos, std::vector<int> &result)
+{
+    for (const auto &o : StitchedMeshChunk::Offsets)
+    {
+        auto n = chunk.get_node_index_at(pos + o);
+        if (n < 0)
+            return false;
+        result.push_back(n);
+    }
+    return true;
+}
+
+bool legacy_get_unique_neighbouring_vertices(const StitchedMeshChunk &chunk, const glm::ivec3 &pos,
+                                             const std::vector<glm::ivec3> &offsets, std::vector<int> &result)
+{
+    for (const auto &o : offsets)
+    {
+        auto n = chunk.get_node_index_at(pos + o);
+        if (n < 0 || chunk.vertexIndices[n] < 0)
+            return false;
+        if (std::find(result.begin(), result.end(), n) == result.end())
+            result.push_back(n);
+    }
+    return true;
+}
+
+// folds the gathered nodes into a hash, the two versions agree if their hashes do
+inline void mix(uint64_t &hash, int value)
+{
+    hash = (hash ^ static_cast<uint32_t>(value)) * 0x100000001B3ULL;
+}
+
+// Every node whose 8 corners exist gets a vertex. That is more than the mesher creates, so the face gathers below
+// run over every face instead of stopping at the first corner without one.
+void assign_vertices(StitchedMeshChunk &chunk)
+{
+    StitchedMeshChunk::Neighbours neighbours;
+    for (int node = 0; node < chunk.innerNodeCount; node++)
+        if (chunk.vertexIndices[node] > -2 && chunk.get_neighbours(chunk.positions[node], neighbours))
+            chunk.vertexIndices[node] = node;
+}
+
+// the corner pass and the face pass of StitchedSurfaceNets::generate_mesh_data, without the vertices and quads
+uint64_t gather_neighbours(const StitchedMeshChunk &chunk)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    StitchedMeshChunk::Neighbours neighbours;
+    for (int node = 0; node < chunk.innerNodeCount; node++)
+    {
+        if (chunk.vertexIndices[node] <= -2)
+            continue;
+        const bool found = chunk.get_neighbours(chunk.positions[node], neighbours);
+        mix(hash, found);
+        for (int i = 0; found && i < 8; i++)
+            mix(hash, neighbours[i]);
+    }
+
+    StitchedMeshChunk::FaceNeighbours faceNeighbours;
+    int count = 0;
+    for (int node = 0; node < chunk.innerNodeCount; node++)
+    {
+        if (chunk.vertexIndices[node] <= -1)
+            continue;
+        for (int face = 0; face < 3; face++)
+        {
+            const bool found =
+                chunk.get_unique_neighbouring_vertices(chunk.positions[node], face, faceNeighbours, count);
+            mix(hash, found);
+            for (int i = 0; found && i < count; i++)
+                mix(hash, faceNeighbours[i]);
+        }
+    }
+    return hash;
+}
+
+uint64_t legacy_gather_neighbours(const StitchedMeshChunk &chunk)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (int node = 0; node < chunk.innerNodeCount; node++)
+    {
+        if (chunk.vertexIndices[node] <= -2)
+            continue;
+        auto neighbours = std::vector<int>();
+        const bool found = legacy_get_neighbours(chunk, chunk.positions[node], neighbours);
+        mix(hash, found);
+        for (size_t i = 0; found && i < neighbours.size(); i++)
+            mix(hash, neighbours[i]);
+    }
+
+    for (int node = 0; node < chunk.innerNodeCount; node++)
+    {
+        if (chunk.vertexIndices[node] <= -1)
+            continue;
+        for (int face = 0; face < 3; face++)
+        {
+            auto neighbours = std::vector<int>();
+            const glm::ivec3 &pos = chunk.positions[node];
+            const bool found =
+                legacy_get_unique_neighbouring_vertices(chunk, pos, StitchedMeshChunk::FaceOffsets[face], neighbours);
+            mix(hash, found);
+            for (size_t i = 0; found && i < neighbours.size(); i++)
+                mix(hash, neighbours[i]);
+        }
+    }
+    return hash;
+}
+
+void compare_neighbours(const JarVoxelTerrain &terrain, const std::vector<const VoxelOctreeNode *> &chunks,
+                        const std::vector<glm::vec3> &centers, const LodObserverState &observers, int iterations,
+                        MeshingBenchmarkResult &result)
+{
+    for (size_t c = 0; c < chunks.size(); ++c)
+    {
+        StitchedMeshChunk chunk(terrain, *chunks[c], centers[c], observers);
+        assign_vertices(chunk);
+        bool agree = true;
+        for (int i = 0; i < iterations; ++i)
+        {
+            const Clock::time_point start = Clock::now();
+            const uint64_t hash = gather_neighbours(chunk);
+            const Clock::time_point gathered = Clock::now();
+            const uint64_t legacyHash = legacy_gather_neighbours(chunk);
+            const Clock::time_point legacyGathered = Clock::now();
+
+            result.neighbourMs += elapsed_ms(start, gathered);
+            result.legacyNeighbourMs += elapsed_ms(gathered, legacyGathered);
+            agree &= hash == legacyHash;
+        }
+        result.neighbourMismatches += agree ? 0 : 1;
+    }
+}
+} // namespace
+
+MeshingBenchmarkResult run_meshing_benchmark(const JarVoxelTerrain &terrain,
+                                             const std::vector<const VoxelOctreeNode *> &chunks, int iterations,
+                                             bool compareNeighbours)
+{
+    MeshingBenchmarkResult result;
+    result.chunkCount = static_cast<int>(chunks.size());
+    // main thread, nothing publishes a new state while it runs
+    const std::shared_ptr<const LodObserverState> observers = terrain.get_observer_state();
+    // a mesh job gets the center with the job, it is not part of the measured time
+    std::vector<glm::vec3> centers(chunks.size());
+    std::vector<bool> edgeChunks(chunks.size());
+    for (size_t c = 0; c < chunks.size(); ++c)
+    {
+        centers[c] = chunks[c]->get_center(terrain.get_octree_scale());
+        edgeChunks[c] = chunks[c]->compute_boundaries(terrain, centers[c]) != 0;
+        result.edgeChunkCount += edgeChunks[c] ? 1 : 0;
+    }
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        for (size_t c = 0; c < chunks.size(); ++c)
+        {
+            const VoxelOctreeNode *chunk = chunks[c];
+            const Clock::time_point start = Clock::now();
+            StitchedSurfaceNets meshCompute(terrain, *chunk, centers[c], *observers);
+            const Clock::time_point sampled = Clock::now();
+            ChunkMeshData *chunkMeshData = meshCompute.generate_mesh_data(terrain);
+            const Clock::time_point meshed = Clock::now();
+
+            result.sampleMs += elapsed_ms(start, sampled);
+            result.surfaceMs += elapsed_ms(sampled, meshed);
+            if (edgeChunks[c])
+                result.edgeMs += elapsed_ms(start, meshed);
+            if (chunkMeshData != nullptr && i == 0)
+            {
+                const PackedInt32Array indices = chunkMeshData->mesh_array[Mesh::ARRAY_INDEX];
+                result.triangleCount += indices.size() / 3;
+            }
+            delete chunkMeshData;
+        }
+    }
+
+    if (compareNeighbours)
+        compare_neighbours(terrain, chunks, centers, *observers, iterations, result);
+    return result;
+}
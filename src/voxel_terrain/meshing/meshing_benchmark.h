@@ -0,0 +1,31 @@
+#ifndef MESHING_BENCHMARK_H
+#define MESHING_BENCHMARK_H
+
+#include <cstdint>
+#include <vector>
+
+class JarVoxelTerrain;
+class VoxelOctreeNode;
+
+struct MeshingBenchmarkResult
+{
+    int chunkCount = 0;
+    int edgeChunkCount = 0; // on a lod boundary, with ring nodes and stitching
+    double sampleMs = 0.0;  // gathering the leaves of the chunks, StitchedMeshChunk
+    double surfaceMs = 0.0; // the surface nets passes, StitchedSurfaceNets::generate_mesh_data
+    double edgeMs = 0.0;    // both phases of the edge chunks, included above
+    int64_t triangleCount = 0;
+
+    // compareNeighbours only, the corner and face gathers of the mesher against the vector based ones they replaced
+    double neighbourMs = 0.0;
+    double legacyNeighbourMs = 0.0;
+    int neighbourMismatches = 0; // chunks where the two disagree
+};
+
+// Meshes each chunk iterations times on the calling thread, the way a mesh job does, and sums the time of both
+// phases. The meshes are dropped. The terrain must not be building while it runs.
+MeshingBenchmarkResult run_meshing_benchmark(const JarVoxelTerrain &terrain,
+                                             const std::vector<const VoxelOctreeNode *> &chunks, int iterations,
+                                             bool compareNeighbours = false);
+
+#endif // MESHING_BENCHMARK_H
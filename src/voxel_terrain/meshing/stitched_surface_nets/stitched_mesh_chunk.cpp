@@ -1,9 +1,21 @@
 #include "stitched_mesh_chunk.h"
 #include "voxel_terrain.h"
 #include "utils.h"
+#include <array>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JAR_MESH_SSE2 1
+#include <emmintrin.h>
+#endif
 
 #define LEAF_COUNT 16.0f
 
+static inline int flat_index(const glm::ivec3 &pos, const int res)
+{
+    return pos.x + res * (pos.y + res * pos.z);
+}
+
 const std::vector<glm::ivec3> StitchedMeshChunk::Offsets = {
     glm::ivec3(0, 0, 0), glm::ivec3(1, 0, 0), glm::ivec3(0, 1, 0), glm::ivec3(1, 1, 0),
     glm::ivec3(0, 0, 1), glm::ivec3(1, 0, 1), glm::ivec3(0, 1, 1), glm::ivec3(1, 1, 1)};
@@ -45,28 +57,38 @@ const std::vector<glm::ivec3> StitchedMeshChunk::XyOffsets = {glm::ivec3(0, 0, 0
 
 const std::vector<std::vector<glm::ivec3>> StitchedMeshChunk::FaceOffsets = {YzOffsets, XzOffsets, XyOffsets};
 
-StitchedMeshChunk::StitchedMeshChunk(const JarVoxelTerrain &terrain, const VoxelOctreeNode &chunk)
+StitchedMeshChunk::StitchedMeshChunk(const JarVoxelTerrain &terrain, const VoxelOctreeNode &chunk,
+                                     const glm::vec3 &center, const LodObserverState &observers)
 {
-    glm::vec3 chunkCenter = chunk._center;
-    auto cameraPosition = terrain.get_camera_position();
+    chunkCenter = center;
+    const glm::vec3 cameraPosition = observers.cameraPosition;
     // if(chunk.LoD > 0 ) return;
     Octant = glm::ivec3(chunkCenter.x > cameraPosition.x ? 1 : -1, chunkCenter.y > cameraPosition.y ? 1 : -1,
                         chunkCenter.z > cameraPosition.z ? 1 : -1);
 
     float leafSize = ((1 << chunk.get_lod()) * terrain.get_octree_scale());
-    Bounds bounds = chunk.get_bounds(terrain.get_octree_scale()).expanded(leafSize - 0.001f);
+    Bounds bounds = chunk.get_bounds(terrain.get_octree_scale(), chunkCenter).expanded(leafSize - 0.001f);
     nodes.clear();
-    terrain.get_voxel_leaves_in_bounds(bounds, chunk.get_lod(), nodes);
-    // terrain.get_voxel_leaves_in_bounds(chunk.get_bounds(terrain.get_octree_scale()).expanded( - 0.001f), chunk.get_lod(), nodes);
-    innerNodeCount = nodes.size();
+    centers.clear();
+    // in brick mode there are no nodes below the chunk, the brick already holds the whole grid
+    std::shared_ptr<const VoxelBrick> brick = terrain.get_octree().get_brick(&chunk);
+    if (brick != nullptr)
+        sample_brick(*brick);
+    else
+    {
+        terrain.get_voxel_leaves_in_bounds(bounds, chunk.get_lod(), nodes, centers);
+        // terrain.get_voxel_leaves_in_bounds(chunk.get_bounds(terrain.get_octree_scale()).expanded( - 0.001f), chunk.get_lod(), nodes);
+        sample_nodes(terrain, 0);
+    }
+    innerNodeCount = centers.size();
     bounds = bounds.expanded(0.001f);
 
-    if (nodes.empty())
+    if (innerNodeCount == 0)
         return;
 
     // find if there are any lod boundaries
     const float edge_length = chunk.edge_length(terrain.get_octree_scale());
-    uint16_t boundaries = chunk.compute_boundaries(terrain);
+    uint16_t boundaries = chunk.compute_boundaries(terrain, chunkCenter, observers);
     _lodH2LBoundaries = boundaries & 0xFF;
     _lodL2HBoundaries = (boundaries >> 8) & 0xFF;
 
@@ -74,9 +96,9 @@ StitchedMeshChunk::StitchedMeshChunk(const JarVoxelTerrain &terrain, const Voxel
     vertexIndices.clear();
     faceDirs.clear();
     _leavesLut.clear();
-    positions.resize(nodes.size(), glm::ivec3(0));
-    vertexIndices.resize(nodes.size(), -2);
-    faceDirs.resize(nodes.size(), 0);
+    positions.resize(innerNodeCount, glm::ivec3(0));
+    vertexIndices.resize(innerNodeCount, -2);
+    faceDirs.resize(innerNodeCount, 0);
     _leavesLut.resize(ChunkRes * ChunkRes * ChunkRes, 0);
     {
         float normalizingFactor = 1.0f / leafSize;
@@ -84,10 +106,9 @@ StitchedMeshChunk::StitchedMeshChunk(const JarVoxelTerrain &terrain, const Voxel
         glm::vec3 minPos = bounds.min;
         glm::ivec3 clampMax = glm::ivec3(LargestPos);
 
-        for (size_t i = 0; i < nodes.size(); i++)
+        for (size_t i = 0; i < innerNodeCount; i++)
         {
-            VoxelOctreeNode *node = nodes[i];
-            glm::ivec3 pos = (glm::ivec3)glm::ceil((node->_center - minPos) * normalizingFactor) - glm::ivec3(1.0f);
+            glm::ivec3 pos = (glm::ivec3)glm::ceil((centers[i] - minPos) * normalizingFactor) - glm::ivec3(1.0f);
             pos = glm::clamp(pos, glm::ivec3(0.0f), clampMax);
 
             // if (is_on_boundary(_lodH2LBoundaries, pos))
@@ -95,9 +116,10 @@ StitchedMeshChunk::StitchedMeshChunk(const JarVoxelTerrain &terrain, const Voxel
 
             positions[i] = pos;
             vertexIndices[i] = -1;
-            _leavesLut[pos.x + ChunkRes * (pos.y + ChunkRes * pos.z)] = i + 1;
+            _leavesLut[flat_index(pos, ChunkRes)] = i + 1;
         }
     }
+    find_active_cells();
 
     if (_lodH2LBoundaries != 0)
     {
@@ -106,7 +128,7 @@ StitchedMeshChunk::StitchedMeshChunk(const JarVoxelTerrain &terrain, const Voxel
         // rejection_bounds = inner radius
         // acception_bounds = union of the 6 rings, should capture 8x8x2 nodes per side
         Bounds acceptance_bounds;
-        Bounds rejection_bounds = chunk.get_bounds(terrain.get_octree_scale());
+        Bounds rejection_bounds = chunk.get_bounds(terrain.get_octree_scale(), chunkCenter);
         for (size_t i = 0; i < CheckLodOffsets.size(); i++)
         {
             if (((_lodH2LBoundaries >> i) & 0b1) != 1)
@@ -131,22 +153,27 @@ StitchedMeshChunk::StitchedMeshChunk(const JarVoxelTerrain &terrain, const Voxel
 
         acceptance_bounds = acceptance_bounds.expanded(-0.001f);
         rejection_bounds = rejection_bounds.expanded(-0.001f);
-        terrain.get_voxel_leaves_in_bounds_excluding_bounds(acceptance_bounds, rejection_bounds, chunk.get_lod() + 1,
-                                                            nodes);
-        ringNodeCount = nodes.size() - innerNodeCount;
+        if (brick != nullptr)
+            sample_ring(terrain, acceptance_bounds, rejection_bounds, leafSize * 2.0f);
+        else
+        {
+            terrain.get_voxel_leaves_in_bounds_excluding_bounds(acceptance_bounds, rejection_bounds,
+                                                                chunk.get_lod() + 1, nodes, centers);
+            sample_nodes(terrain, innerNodeCount);
+        }
+        ringNodeCount = centers.size() - innerNodeCount;
         // UtilityFunctions::print(ringNodeCount);
         if (ringNodeCount <= 0)
             return;
         // should be based on full ring mode, i.e. -5 to 5 nodes
         glm::vec3 minPos = chunkCenter - 10 / LEAF_COUNT * edge_length;
-        glm::ivec3 clampMax = glm::ivec3(9);
+        glm::ivec3 clampMax = glm::ivec3(RingRes - 1);
         glm::vec3 minRecPos = glm::vec3(3875439875983);
         glm::vec3 maxRecPos = glm::vec3(-3875439875983);
 
-        for (size_t i = innerNodeCount; i < nodes.size(); i++)
+        for (size_t i = innerNodeCount; i < centers.size(); i++)
         {
-            VoxelOctreeNode *node = nodes[i];
-            glm::ivec3 pos = (glm::ivec3)glm::ceil((node->_center - minPos) * normalizingFactor) - glm::ivec3(1.0f);
+            glm::ivec3 pos = (glm::ivec3)glm::ceil((centers[i] - minPos) * normalizingFactor) - glm::ivec3(1.0f);
 
             minRecPos = glm::min(minRecPos, glm::vec3(pos));
             maxRecPos = glm::max(maxRecPos, glm::vec3(pos));
@@ -156,13 +183,140 @@ StitchedMeshChunk::StitchedMeshChunk(const JarVoxelTerrain &terrain, const Voxel
             positions.push_back(pos);
             vertexIndices.push_back(-1);
             faceDirs.push_back(0);
-            _ringLut[pos] = i;
+            _ringLut.set(pos, i);
         }
 
         // UtilityFunctions::print("min: " + Utils::to_string(minRecPos) + "max: " + Utils::to_string(maxRecPos));
     }
 }
 
+void StitchedMeshChunk::sample_nodes(const JarVoxelTerrain &terrain, size_t first)
+{
+    values.resize(nodes.size());
+    colors.resize(nodes.size());
+    for (size_t i = first; i < nodes.size(); i++)
+    {
+        values[i] = nodes[i]->get_value(terrain);
+        colors[i] = nodes[i]->get_color();
+    }
+}
+
+void StitchedMeshChunk::sample_brick(const VoxelBrick &brick)
+{
+    const int resolution = brick.get_resolution();
+    centers.resize(brick.get_sample_count());
+    values.resize(brick.get_sample_count());
+    colors.resize(brick.get_sample_count());
+    int i = 0;
+    for (int z = 0; z < resolution; z++)
+        for (int y = 0; y < resolution; y++)
+            for (int x = 0; x < resolution; x++, i++)
+            {
+                centers[i] = brick.get_position(x, y, z);
+                values[i] = brick.get_value(i);
+                colors[i] = VoxelOctreeNode::ColorPalette[brick.get_color_index(i)];
+            }
+}
+
+// samples the cells of the next lod that the neighbouring chunks would contribute as ring nodes
+void StitchedMeshChunk::sample_ring(const JarVoxelTerrain &terrain, const Bounds &acceptance_bounds,
+                                    const Bounds &rejection_bounds, const float cellSize)
+{
+    const float scale = terrain.get_octree_scale();
+    std::vector<ModifySettings> edits;
+    terrain.get_brick_edits_in_bounds(acceptance_bounds, edits);
+    const JarSignedDistanceField &sdf = *terrain.get_sdf().ptr();
+    const size_t first = centers.size();
+
+    // cells of the octree are aligned to multiples of their size, as the root is centered on the origin
+    const glm::ivec3 firstCell = glm::ivec3(glm::floor(acceptance_bounds.min / cellSize));
+    const glm::ivec3 lastCell = glm::ivec3(glm::ceil(acceptance_bounds.max / cellSize)) - glm::ivec3(1);
+    for (int z = firstCell.z; z <= lastCell.z; z++)
+        for (int y = firstCell.y; y <= lastCell.y; y++)
+            for (int x = firstCell.x; x <= lastCell.x; x++)
+            {
+                const glm::vec3 cellMin = glm::vec3(x, y, z) * cellSize;
+                const Bounds cell(cellMin, cellMin + glm::vec3(cellSize));
+                if (!acceptance_bounds.intersects(cell) || rejection_bounds.intersects(cell))
+                    continue;
+                centers.push_back(cell.get_center());
+            }
+
+    // the whole ring in one batch, the edits are replayed per sample afterwards
+    values.resize(centers.size());
+    colors.resize(centers.size());
+    sdf.distance_batch(centers.data() + first, values.data() + first, centers.size() - first);
+    for (size_t i = first; i < centers.size(); i++)
+        colors[i] = VoxelOctreeNode::ColorPalette[VoxelBrick::apply_edits(edits, centers[i], values[i], scale)];
+}
+
+// Reduces the sign rows of four cell rows (y to y + 3) to the cells whose 8 corners all exist and are not all of the
+// same strict sign. Bit x of a row stands for the sample at x, the cell at x spans the bits x and x + 1.
+static inline void reduce_cell_rows(const uint32_t *present, const uint32_t *positive, const uint32_t *negative,
+                                    const int stride, uint32_t *out)
+{
+#ifdef JAR_MESH_SSE2
+    auto corners = [stride](const uint32_t *rows) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows + 1));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows + stride));
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows + stride + 1));
+        const __m128i all = _mm_and_si128(_mm_and_si128(a, b), _mm_and_si128(c, d));
+        return _mm_and_si128(all, _mm_srli_epi32(all, 1));
+    };
+    const __m128i uniform = _mm_or_si128(corners(positive), corners(negative));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_andnot_si128(uniform, corners(present)));
+#else
+    auto corners = [stride](const uint32_t *rows) {
+        const uint32_t all = rows[0] & rows[1] & rows[stride] & rows[stride + 1];
+        return all & (all >> 1);
+    };
+    for (int r = 0; r < 4; r++)
+        out[r] = corners(present + r) & ~(corners(positive + r) | corners(negative + r));
+#endif
+}
+
+// Pre-pass over the sign bits of the inner grid. Cells whose corners are all strictly positive or all strictly
+// negative have no edge crossing, usually the vast majority, so only the rest is listed for the mesher.
+void StitchedMeshChunk::find_active_cells()
+{
+    // rows of x bits by z and y, the padding keeps the four wide loads of the last rows in bounds
+    constexpr int RowStride = ChunkRes + 4;
+    std::array<uint32_t, ChunkRes * RowStride> present{}, positive{}, negative{};
+    int i = 0;
+    for (int z = 0; z < ChunkRes; z++)
+        for (int y = 0; y < ChunkRes; y++)
+            for (int x = 0; x < ChunkRes; x++, i++)
+            {
+                const int n = _leavesLut[i] - 1;
+                if (n < 0)
+                    continue;
+                const uint32_t bit = 1u << x;
+                const int row = z * RowStride + y;
+                present[row] |= bit;
+                if (values[n] > 0.0f)
+                    positive[row] |= bit;
+                else if (values[n] < 0.0f)
+                    negative[row] |= bit;
+            }
+
+    activeCells.clear();
+    uint32_t cells[4];
+    for (int z = 0; z < LargestPos; z++)
+        for (int y = 0; y < LargestPos; y += 4)
+        {
+            const int row = z * RowStride + y;
+            reduce_cell_rows(present.data() + row, positive.data() + row, negative.data() + row, RowStride, cells);
+            for (int r = 0; r < 4 && y + r < LargestPos; r++)
+            {
+                int x = 0;
+                for (uint32_t bits = cells[r]; bits != 0; bits >>= 1, x++)
+                    if (bits & 1)
+                        activeCells.push_back(_leavesLut[flat_index(glm::ivec3(x, y + r, z), ChunkRes)] - 1);
+            }
+        }
+}
+
 bool StitchedMeshChunk::should_have_quad(const glm::ivec3 &position, const int face) const
 {
     // we might also need some cases for l2h chunks i think
@@ -191,60 +345,66 @@ bool StitchedMeshChunk::on_positive_edge(const glm::ivec3 &position) const
            2;
 }
 
-inline int StitchedMeshChunk::get_node_index_at(const glm::ivec3 &pos) const
+int StitchedMeshChunk::get_node_index_at(const glm::ivec3 &pos) const
 {
     if (pos.x < 0 || pos.x >= ChunkRes || pos.y < 0 || pos.y >= ChunkRes || pos.z < 0 || pos.z >= ChunkRes)
         return -1;
     else
-        return (_leavesLut[pos.x + ChunkRes * (pos.y + ChunkRes * pos.z)] - 1);
+        return (_leavesLut[flat_index(pos, ChunkRes)] - 1);
 }
 
-bool StitchedMeshChunk::get_unique_neighbouring_vertices(const glm::ivec3 &pos, const std::vector<glm::ivec3> &offsets,
-                                                         std::vector<int> &result) const
+bool StitchedMeshChunk::get_unique_neighbouring_vertices(const glm::ivec3 &pos, const int face,
+                                                         FaceNeighbours &result, int &count) const
 {
-    for (const auto &o : offsets)
+    // the face spans the two other axes, the positions are clamped to the grid so only the upper end can overflow
+    const int a = (face + 1) % 3, b = (face + 2) % 3;
+    count = 0;
+    if (pos[a] >= LargestPos || pos[b] >= LargestPos)
+        return false;
+    const int base = flat_index(pos, ChunkRes);
+    for (const int offset : FlatFaceOffsets[face])
     {
-        auto n = get_node_index_at(pos + o);
+        const int n = _leavesLut[base + offset] - 1;
         if (n < 0 || vertexIndices[n] < 0)
-        {
             return false;
-        }
-        if (std::find(result.begin(), result.end(), n) == result.end())
-            result.push_back(n);
+        bool unique = true;
+        for (int i = 0; i < count; i++)
+            unique &= result[i] != n;
+        if (unique)
+            result[count++] = n;
     }
     return true;
 }
 
-bool StitchedMeshChunk::get_neighbours(const glm::ivec3 &pos, std::vector<int> &result) const
+bool StitchedMeshChunk::get_neighbours(const glm::ivec3 &pos, Neighbours &result) const
 {
-    for (const auto &o : StitchedMeshChunk::Offsets)
+    if (pos.x >= LargestPos || pos.y >= LargestPos || pos.z >= LargestPos)
+        return false;
+    const int base = flat_index(pos, ChunkRes);
+    for (int i = 0; i < 8; i++)
     {
-        auto n = get_node_index_at(pos + o);
+        const int n = _leavesLut[base + FlatOffsets[i]] - 1;
         if (n < 0)
-        {
             return false;
-        }
-        result.push_back(n);
+        result[i] = n;
     }
     return true;
 }
 
-bool StitchedMeshChunk::get_ring_neighbours(const glm::ivec3 &pos, std::vector<int> &result) const
+bool StitchedMeshChunk::get_ring_neighbours(const glm::ivec3 &pos, Neighbours &result) const
 {
-    for (const auto &o : StitchedMeshChunk::Offsets)
+    for (int i = 0; i < 8; i++)
     {
-        auto it = _ringLut.find(pos + o); // Use find method
-        if (it == _ringLut.end() || it->second < 0)
-        {
-            return false; // Value does not exist or is invalid
-        }
-        result.push_back(it->second);
+        const int n = _ringLut.get(pos + Offsets[i]);
+        if (n < 0)
+            return false;
+        result[i] = n;
     }
     return true;
 }
 
 // make sure that the sign of the 4 vertices closest the boundary is not the same
-bool StitchedMeshChunk::should_have_boundary_quad(const std::vector<int> &neighbours, const bool on_ring) const
+bool StitchedMeshChunk::should_have_boundary_quad(const Neighbours &neighbours, const bool on_ring) const
 {
     // if on ring, we check the other side. if not on ring, we check outward of the chunk
     for (size_t i = 0; i < CheckLodOffsets.size(); i++)
@@ -261,10 +421,8 @@ bool StitchedMeshChunk::should_have_boundary_quad(const std::vector<int> &neighb
         }
 
         glm::ivec4 nx = RingQuadChecks[j]; // get the right set of neighbours to consider
-        int sign0 = glm::sign(nodes[neighbours[nx.x]]->get_value()),
-            sign1 = glm::sign(nodes[neighbours[nx.y]]->get_value()),
-            sign2 = glm::sign(nodes[neighbours[nx.z]]->get_value()),
-            sign3 = glm::sign(nodes[neighbours[nx.w]]->get_value());
+        int sign0 = glm::sign(values[neighbours[nx.x]]), sign1 = glm::sign(values[neighbours[nx.y]]),
+            sign2 = glm::sign(values[neighbours[nx.z]]), sign3 = glm::sign(values[neighbours[nx.w]]);
         if (sign0 != sign1 || sign1 != sign2 || sign2 != sign3)
             return true;
     }
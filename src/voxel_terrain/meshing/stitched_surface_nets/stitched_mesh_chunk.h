@@ -1,19 +1,78 @@
 #ifndef STITCHED_MESH_CHUNK_H
 #define STITCHED_MESH_CHUNK_H
 
+#include "voxel_brick.h"
 #include "voxel_octree_node.h"
+#include <array>
 #include <glm/glm.hpp>
-#include <unordered_map>
-#include <unordered_set>
 #include <vector>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
 
 class JarVoxelTerrain;
 
+// Node ids by position on one of the small grids of a chunk, [0, Res) on every axis. Replaces a hash map with a flat
+// array, allocated on the first set so chunks without a lod boundary never pay for it. Positions are also listed in
+// the order they were first set.
+template <int Res> class GridLut
+{
+  public:
+    static bool contains(const glm::ivec3 &pos)
+    {
+        return pos.x >= 0 && pos.x < Res && pos.y >= 0 && pos.y < Res && pos.z >= 0 && pos.z < Res;
+    }
+
+    // -1 if nothing is stored at pos or pos is off the grid
+    int get(const glm::ivec3 &pos) const
+    {
+        if (_ids.empty() || !contains(pos))
+            return -1;
+        return _ids[index(pos)] - 1;
+    }
+
+    void set(const glm::ivec3 &pos, int id)
+    {
+        if (_ids.empty())
+            _ids.resize(Res * Res * Res, 0);
+        int &slot = _ids[index(pos)];
+        if (slot == 0)
+            _positions.push_back(pos);
+        slot = id + 1;
+    }
+
+    const std::vector<glm::ivec3> &get_positions() const
+    {
+        return _positions;
+    }
+
+  private:
+    std::vector<int> _ids; // id + 1, 0 is empty
+    std::vector<glm::ivec3> _positions;
+
+    static int index(const glm::ivec3 &pos)
+    {
+        return pos.x + Res * (pos.y + Res * pos.z);
+    }
+};
+
 class StitchedMeshChunk
 {
   public:
+    const static int ChunkRes = 16 + 2;
+    const static int LargestPos = ChunkRes - 1;
+
+    // the 8 corners of a cell in the order of Offsets, and the 4 vertices around a quad face
+    using Neighbours = std::array<int, 8>;
+    using FaceNeighbours = std::array<int, 4>;
+
+    // Offsets and FaceOffsets as steps in _leavesLut
+    static constexpr Neighbours FlatOffsets = {
+        0, 1, ChunkRes, ChunkRes + 1, ChunkRes * ChunkRes, ChunkRes * ChunkRes + 1, ChunkRes * ChunkRes + ChunkRes,
+        ChunkRes * ChunkRes + ChunkRes + 1};
+    static constexpr std::array<FaceNeighbours, 3> FlatFaceOffsets = {{
+        {0, ChunkRes, ChunkRes * ChunkRes, ChunkRes * ChunkRes + ChunkRes}, // yz
+        {0, 1, ChunkRes * ChunkRes, ChunkRes * ChunkRes + 1},                // xz
+        {0, 1, ChunkRes, ChunkRes + 1},                                      // xy
+    }};
+
     static const std::vector<Bounds> RingBounds;
     static const std::vector<glm::vec3> CheckLodOffsets;
     static const std::vector<glm::ivec4> RingQuadChecks;
@@ -26,15 +85,17 @@ class StitchedMeshChunk
 
     bool should_have_quad(const glm::ivec3 &position, const int face) const;
     bool on_positive_edge(const glm::ivec3 &position) const;
-    inline int get_node_index_at(const glm::ivec3 &pos) const;
-    bool get_unique_neighbouring_vertices(const glm::ivec3 &pos, const std::vector<glm::ivec3> &offsets,
-                                          std::vector<int> &result) const;
+    int get_node_index_at(const glm::ivec3 &pos) const;
+    // count is the number of distinct nodes written to the front of result
+    bool get_unique_neighbouring_vertices(const glm::ivec3 &pos, const int face, FaceNeighbours &result,
+                                          int &count) const;
 
-    bool get_neighbours(const glm::ivec3 &pos, std::vector<int> &result) const;
-    bool get_ring_neighbours(const glm::ivec3 &pos, std::vector<int> &result) const;
-    bool should_have_boundary_quad(const std::vector<int> &neighbours, const bool on_ring) const;
+    bool get_neighbours(const glm::ivec3 &pos, Neighbours &result) const;
+    bool get_ring_neighbours(const glm::ivec3 &pos, Neighbours &result) const;
+    bool should_have_boundary_quad(const Neighbours &neighbours, const bool on_ring) const;
 
-    StitchedMeshChunk(const JarVoxelTerrain &terrain, const VoxelOctreeNode &chunk);
+    StitchedMeshChunk(const JarVoxelTerrain &terrain, const VoxelOctreeNode &chunk, const glm::vec3 &center,
+                      const LodObserverState &observers);
 
     bool is_edge_chunk() const
     {
@@ -82,22 +143,35 @@ class StitchedMeshChunk
     }
 
     glm::ivec3 Octant{1, 1, 1};
+    glm::vec3 chunkCenter{0.0f};
     std::vector<VoxelOctreeNode *> nodes;
+    // samples of the nodes above, nodes don't store their center and keep a quantized value. The centers come with
+    // the nodes from the leaf queries.
+    std::vector<glm::vec3> centers;
+    std::vector<float> values;
+    std::vector<glm::vec4> colors;
     std::vector<glm::ivec3> positions;
     std::vector<int> vertexIndices;
     std::vector<int> faceDirs;
     int innerNodeCount = 0;
     int ringNodeCount = 0;
-    std::unordered_map<glm::ivec3, int> _ringLut; //maps position to index in ringNodes
+    // inner nodes whose cell may cross the surface, see find_active_cells
+    std::vector<int> activeCells;
+    static const int RingRes = 10; // ring positions are in [0, 9]
+    GridLut<RingRes> _ringLut; //maps position to index in ringNodes
 
     uint8_t _lodL2HBoundaries; // boundaries from low lod to high lod, i.e. large to small chunks
     uint8_t _lodH2LBoundaries; // boundaries from high lod to low lod, i.e. small to large chunks
 
 
   private:
+    void sample_nodes(const JarVoxelTerrain &terrain, size_t first);
+    void find_active_cells();
+    void sample_brick(const VoxelBrick &brick);
+    void sample_ring(const JarVoxelTerrain &terrain, const Bounds &acceptance_bounds, const Bounds &rejection_bounds,
+                     const float cellSize);
+
     glm::vec3 half_leaf_size;
-    const static int ChunkRes = 16 + 2;
-    const static int LargestPos = ChunkRes - 1;
     std::vector<int> _leavesLut; //maps position to index in nodes
     // chunk boundaries, 6 bits each: 0,0,-z,z,-y,y,-x,x
 
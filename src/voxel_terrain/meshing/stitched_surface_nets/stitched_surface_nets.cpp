@@ -5,13 +5,83 @@
 
 #include "voxel_terrain.h"
 #include "utility/utils.h"
+#include <cstring>
+#include <type_traits>
 
-StitchedSurfaceNets::StitchedSurfaceNets(const JarVoxelTerrain &terrain, const VoxelOctreeNode &chunk)
-    : _chunk(&chunk), _cubicVoxels(terrain.get_cubic_voxels()), _meshChunk(StitchedMeshChunk(terrain, chunk))
+static inline float distance_squared(const glm::vec3 &a, const glm::vec3 &b)
 {
+    const glm::vec3 d = a - b;
+    return glm::dot(d, d);
 }
 
-void StitchedSurfaceNets::create_vertex(const int node_id, const std::vector<int> &neighbours, const bool on_ring)
+StitchedSurfaceNets::MeshBuffers &StitchedSurfaceNets::thread_buffers()
+{
+    thread_local MeshBuffers buffers;
+    buffers.verts.clear();
+    buffers.normals.clear();
+    buffers.colors.clear();
+    buffers.indices.clear();
+    return buffers;
+}
+
+StitchedSurfaceNets::StitchedSurfaceNets(const JarVoxelTerrain &terrain, const VoxelOctreeNode &chunk,
+                                         const glm::vec3 &center, const LodObserverState &observers)
+    : _buffers(thread_buffers()), _verts(_buffers.verts), _normals(_buffers.normals), _colors(_buffers.colors),
+      _indices(_buffers.indices), _chunk(&chunk), _cubicVoxels(terrain.get_cubic_voxels()),
+      _meshChunk(StitchedMeshChunk(terrain, chunk, center, observers))
+{
+}
+
+// a vertex per active cell and ring node at most, a surface vertex has about two quads
+void StitchedSurfaceNets::reserve_buffers()
+{
+    const size_t vertexCount = _meshChunk.activeCells.size() + _meshChunk.ringNodeCount;
+    _verts.reserve(vertexCount);
+    _normals.reserve(vertexCount);
+    _colors.reserve(vertexCount);
+    _indices.reserve(vertexCount * 6);
+}
+
+// copies a vector into a Packed array in one step, element by element if the engine uses double precision
+template <typename TPacked, typename TValue, typename TSource>
+static TPacked to_packed_array(const std::vector<TSource> &source)
+{
+    TPacked result;
+    result.resize(source.size());
+    if constexpr (sizeof(TValue) == sizeof(TSource))
+    {
+        // the engine types are not trivial but share the layout of the glm ones
+        static_assert(std::is_trivially_copyable_v<TSource> && sizeof(TValue) == sizeof(TSource),
+                      "the source is copied bytewise");
+        if (!source.empty())
+            std::memcpy(reinterpret_cast<void *>(result.ptrw()), source.data(), source.size() * sizeof(TSource));
+    }
+    else
+    {
+        TValue *dst = result.ptrw();
+        for (size_t i = 0; i < source.size(); i++)
+            for (int c = 0; c < TSource::length(); c++)
+                dst[i][c] = source[i][c];
+    }
+    return result;
+}
+
+Array StitchedSurfaceNets::create_mesh_arrays() const
+{
+    Array meshData;
+    meshData.resize(Mesh::ARRAY_MAX);
+    meshData[Mesh::ARRAY_VERTEX] = to_packed_array<PackedVector3Array, Vector3>(_verts);
+    meshData[Mesh::ARRAY_NORMAL] = to_packed_array<PackedVector3Array, Vector3>(_normals);
+    meshData[Mesh::ARRAY_COLOR] = to_packed_array<PackedColorArray, Color>(_colors);
+    PackedInt32Array indices;
+    indices.resize(_indices.size());
+    std::memcpy(indices.ptrw(), _indices.data(), _indices.size() * sizeof(int32_t));
+    meshData[Mesh::ARRAY_INDEX] = indices;
+    return meshData;
+}
+
+void StitchedSurfaceNets::create_vertex(const int node_id, const StitchedMeshChunk::Neighbours &neighbours,
+                                        const bool on_ring)
 {
     glm::vec3 vertexPosition(0.0f);
     glm::vec4 color(0, 0, 0, 0);
@@ -21,12 +91,10 @@ void StitchedSurfaceNets::create_vertex(const int node_id, const std::vector<int
     {
         auto ai = neighbours[edge.x];
         auto bi = neighbours[edge.y];
-        auto na = _meshChunk.nodes[ai];
-        auto nb = _meshChunk.nodes[bi];
-        float valueA = na->get_value();
-        float valueB = nb->get_value();
-        glm::vec3 posA = na->_center;
-        glm::vec3 posB = nb->_center;
+        float valueA = _meshChunk.values[ai];
+        float valueB = _meshChunk.values[bi];
+        glm::vec3 posA = _meshChunk.centers[ai];
+        glm::vec3 posB = _meshChunk.centers[bi];
 
         normal += (valueB - valueA) * (posB - posA);
 
@@ -36,7 +104,7 @@ void StitchedSurfaceNets::create_vertex(const int node_id, const std::vector<int
         float t = glm::abs(valueA) / (glm::abs(valueA) + glm::abs(valueB));
         vertexPosition += glm::mix(posA, posB, t);
         edge_crossings++;
-        color += glm::mix(na->get_color(), nb->get_color(), t);
+        color += glm::mix(_meshChunk.colors[ai], _meshChunk.colors[bi], t);
     }
 
     if (edge_crossings <= 0)
@@ -44,16 +112,16 @@ void StitchedSurfaceNets::create_vertex(const int node_id, const std::vector<int
 
     //computes and stores the directions in which to generate quads, also determines winding order
     _meshChunk.faceDirs[node_id] =
-        (static_cast<int>(glm::sign(glm::sign(_meshChunk.nodes[neighbours[6]]->get_value()) -
-                                    glm::sign(_meshChunk.nodes[neighbours[7]]->get_value())) +
+        (static_cast<int>(glm::sign(glm::sign(_meshChunk.values[neighbours[6]]) -
+                                    glm::sign(_meshChunk.values[neighbours[7]])) +
                           1))
             << 0 |
-        (static_cast<int>(glm::sign(glm::sign(_meshChunk.nodes[neighbours[7]]->get_value()) -
-                                    glm::sign(_meshChunk.nodes[neighbours[5]]->get_value())) +
+        (static_cast<int>(glm::sign(glm::sign(_meshChunk.values[neighbours[7]]) -
+                                    glm::sign(_meshChunk.values[neighbours[5]])) +
                           1))
             << 2 |
-        (static_cast<int>(glm::sign(glm::sign(_meshChunk.nodes[neighbours[3]]->get_value()) -
-                                    glm::sign(_meshChunk.nodes[neighbours[7]]->get_value())) +
+        (static_cast<int>(glm::sign(glm::sign(_meshChunk.values[neighbours[3]]) -
+                                    glm::sign(_meshChunk.values[neighbours[7]])) +
                           1))
             << 4;
 
@@ -61,33 +129,33 @@ void StitchedSurfaceNets::create_vertex(const int node_id, const std::vector<int
     color /= static_cast<float>(edge_crossings);
     normal = glm::normalize(normal);
     if (_cubicVoxels)
-        vertexPosition = _meshChunk.nodes[node_id]->_center;
+        vertexPosition = _meshChunk.centers[node_id];
 
-    vertexPosition -= _chunk->_center;
+    vertexPosition -= _meshChunk.chunkCenter;
     int vertexIndex = _verts.size();
     glm::ivec3 grid_position = _meshChunk.positions[node_id];
     if ((on_ring || _meshChunk.is_on_any_boundary(grid_position)) &&
         _meshChunk.should_have_boundary_quad(neighbours, on_ring))
     {
         if (on_ring)
-            _ringEdgeNodes[grid_position] = node_id;
+            _ringEdgeNodes.set(grid_position, node_id);
         else
-            _innerEdgeNodes[grid_position] = node_id;
+            _innerEdgeNodes.set(grid_position, node_id);
     }
 
     _meshChunk.vertexIndices[node_id] = vertexIndex;
-    _verts.push_back({vertexPosition.x, vertexPosition.y, vertexPosition.z});
-    _normals.push_back({normal.x, normal.y, normal.z});
-    _colors.push_back({color.r, color.g, color.b, color.a});
+    _verts.push_back(vertexPosition);
+    _normals.push_back(normal);
+    _colors.push_back(color);
 }
 
-ChunkMeshData *StitchedSurfaceNets::generate_mesh_data(const JarVoxelTerrain &terrain)
+ChunkMeshData *StitchedSurfaceNets::generate_mesh_data(const JarVoxelTerrain &terrain,
+                                                       const std::function<bool()> &cancelled)
 {
-    for (size_t node_id = 0; node_id < _meshChunk.innerNodeCount; node_id++)
+    reserve_buffers();
+    StitchedMeshChunk::Neighbours neighbours;
+    for (const int node_id : _meshChunk.activeCells)
     {
-        if (_meshChunk.vertexIndices[node_id] <= -2)
-            continue;
-        auto neighbours = std::vector<int>();
         glm::ivec3 grid_position = _meshChunk.positions[node_id];
 
         if (!_meshChunk.get_neighbours(grid_position, neighbours))
@@ -95,8 +163,8 @@ ChunkMeshData *StitchedSurfaceNets::generate_mesh_data(const JarVoxelTerrain &te
         create_vertex(node_id, neighbours, false);
     }
 
-    if (_verts.size() == 0)    
-        return nullptr;    
+    if (_verts.size() == 0 || (cancelled && cancelled()))
+        return nullptr;
 
     // if on lod boundary, add an additional pass
     for (size_t node_id = _meshChunk.innerNodeCount; node_id < _meshChunk.innerNodeCount + _meshChunk.ringNodeCount;
@@ -104,7 +172,6 @@ ChunkMeshData *StitchedSurfaceNets::generate_mesh_data(const JarVoxelTerrain &te
     {
         if (_meshChunk.vertexIndices[node_id] <= -2)
             continue;
-        auto neighbours = std::vector<int>();
         glm::ivec3 grid_position = _meshChunk.positions[node_id];
 
         if (!_meshChunk.get_ring_neighbours(grid_position, neighbours))
@@ -122,6 +189,9 @@ ChunkMeshData *StitchedSurfaceNets::generate_mesh_data(const JarVoxelTerrain &te
         //     _edgeIndices[grid_position] = (vertexIndex);
         // }
     }
+    if (cancelled && cancelled())
+        return nullptr;
+
     // godot::String ringNodes = "";
     // for (auto& [position, vertexId]: _ringEdgeNodes)
     // {
@@ -135,7 +205,10 @@ ChunkMeshData *StitchedSurfaceNets::generate_mesh_data(const JarVoxelTerrain &te
     // UtilityFunctions::print("Ring Nodes: " + ringNodes);
     // UtilityFunctions::print("Inner Nodes: " + innerNodes);
 
-    for (size_t node_id = 0; node_id < _meshChunk.innerNodeCount; node_id++)
+    StitchedMeshChunk::FaceNeighbours faceNeighbours;
+    int faceNeighbourCount = 0;
+    // only the active cells got a vertex
+    for (const int node_id : _meshChunk.activeCells)
     {
         if (_meshChunk.vertexIndices[node_id] <= -1)
             continue;
@@ -149,15 +222,14 @@ ChunkMeshData *StitchedSurfaceNets::generate_mesh_data(const JarVoxelTerrain &te
             if (flipFace == 0 || !_meshChunk.should_have_quad(pos, i))
                 continue;
 
-            auto neighbours = std::vector<int>();
-            if (_meshChunk.get_unique_neighbouring_vertices(pos, StitchedMeshChunk::FaceOffsets[i], neighbours) &&
-                neighbours.size() == 4)
+            if (_meshChunk.get_unique_neighbouring_vertices(pos, i, faceNeighbours, faceNeighbourCount) &&
+                faceNeighbourCount == 4)
             {
-                int n0 = _meshChunk.vertexIndices[neighbours[0]];
-                int n1 = _meshChunk.vertexIndices[neighbours[1]];
-                int n2 = _meshChunk.vertexIndices[neighbours[2]];
-                int n3 = _meshChunk.vertexIndices[neighbours[3]];
-                if (_verts[n0].distance_squared_to(_verts[n3]) < _verts[n1].distance_squared_to(_verts[n2]))
+                int n0 = _meshChunk.vertexIndices[faceNeighbours[0]];
+                int n1 = _meshChunk.vertexIndices[faceNeighbours[1]];
+                int n2 = _meshChunk.vertexIndices[faceNeighbours[2]];
+                int n3 = _meshChunk.vertexIndices[faceNeighbours[3]];
+                if (distance_squared(_verts[n0], _verts[n3]) < distance_squared(_verts[n1], _verts[n2]))
                 {
                     add_tri(n0, n1, n3, flipFace == -1);
                     add_tri(n0, n3, n2, flipFace == -1);
@@ -171,16 +243,18 @@ ChunkMeshData *StitchedSurfaceNets::generate_mesh_data(const JarVoxelTerrain &te
         }
     }
 
-    if (_indices.size() == 0)    
+    if (_indices.size() == 0 || (cancelled && cancelled()))
         return nullptr;
     
 
     if (_meshChunk.is_edge_chunk())
     {
+        std::array<glm::ivec2, 24> ringNodes;
         // go through inner node edges, then if some inner node edge in +x/y/z exists, attempt to find a ring vertices
         // around this. make triangle/quad depending on what you find
-        for (auto &[pos, node_id] : _innerEdgeNodes)
+        for (const glm::ivec3 &pos : _innerEdgeNodes.get_positions())
         {
+            const int node_id = _innerEdgeNodes.get(pos);
             static const int faces = 3;
             static const glm::ivec3 offsets[3] = {glm::ivec3(1, 0, 0), glm::ivec3(0, 1, 0), glm::ivec3(0, 0, 1)};
             auto faceDirs = _meshChunk.faceDirs[node_id];
@@ -188,22 +262,22 @@ ChunkMeshData *StitchedSurfaceNets::generate_mesh_data(const JarVoxelTerrain &te
             {
                 int innerNeighbour = node_id;
                 if(!(_meshChunk.on_positive_edge(pos))) {
-                    auto it = _innerEdgeNodes.find(pos + offsets[i]);
-                    if (it == _innerEdgeNodes.end() || it->second < 0)
+                    innerNeighbour = _innerEdgeNodes.get(pos + offsets[i]);
+                    if (innerNeighbour < 0)
                         continue;
-                    innerNeighbour = it->second;
                 }
 
-                std::vector<std::vector<int>> neighboursLists = find_ring_nodes(pos, i);
+                const int ringNodeCount = find_ring_nodes(pos, i, ringNodes);
                 int n0 = _meshChunk.vertexIndices[node_id];
                 int n1 = _meshChunk.vertexIndices[innerNeighbour];
-                for (auto &neighbours : neighboursLists)
+                for (int r = 0; r < ringNodeCount; r++)
                 {
-                    if (neighbours.size() == 2)
+                    const glm::ivec2 &ring = ringNodes[r];
+                    if (ring.y >= 0)
                     {
-                        int n2 = _meshChunk.vertexIndices[neighbours[0]];
-                        int n3 = _meshChunk.vertexIndices[neighbours[1]];
-                        if (_verts[n0].distance_squared_to(_verts[n3]) < _verts[n1].distance_squared_to(_verts[n2]))
+                        int n2 = _meshChunk.vertexIndices[ring.x];
+                        int n3 = _meshChunk.vertexIndices[ring.y];
+                        if (distance_squared(_verts[n0], _verts[n3]) < distance_squared(_verts[n1], _verts[n2]))
                         {
                             add_tri_fix_normal(n0, n1, n3);
                             add_tri_fix_normal(n0, n3, n2);
@@ -214,9 +288,9 @@ ChunkMeshData *StitchedSurfaceNets::generate_mesh_data(const JarVoxelTerrain &te
                             add_tri_fix_normal(n1, n2, n0);
                         }
                     }
-                    else if (neighbours.size() == 1)
+                    else
                     {
-                        int n2 = _meshChunk.vertexIndices[neighbours[0]];
+                        int n2 = _meshChunk.vertexIndices[ring.x];
                         add_tri_fix_normal(n0, n1, n2);
                     }
                 }
@@ -224,22 +298,16 @@ ChunkMeshData *StitchedSurfaceNets::generate_mesh_data(const JarVoxelTerrain &te
         }
     }
 
-    Array meshData;
-    meshData.resize(Mesh::ARRAY_MAX);
-    meshData[Mesh::ARRAY_VERTEX] = _verts;
-    meshData[Mesh::ARRAY_NORMAL] = _normals;
-    meshData[Mesh::ARRAY_COLOR] = _colors;
-    meshData[Mesh::ARRAY_INDEX] = _indices;
-
     ChunkMeshData *output =
-        new ChunkMeshData(meshData, _chunk->get_lod(), _meshChunk.is_edge_chunk(), _chunk->get_bounds(terrain.get_octree_scale()));
+        new ChunkMeshData(create_mesh_arrays(), _chunk->get_lod(), _meshChunk.is_edge_chunk(),
+                          _chunk->get_bounds(terrain.get_octree_scale(), _meshChunk.chunkCenter));
     output->boundaries = _meshChunk._lodH2LBoundaries | (_meshChunk._lodL2HBoundaries << 8);
-    output->edgeVertices = _ringEdgeNodes;
-    output->edgeVertices.insert(_innerEdgeNodes.begin(), _innerEdgeNodes.end());
-    for (auto &[pos, node_id] : output->edgeVertices)
-    {
-        output->edgeVertices[pos] = _meshChunk.vertexIndices[node_id];
-    }
+    output->compressed = terrain.is_compress_vertices();
+    output->edgeVertices.reserve(_ringEdgeNodes.get_positions().size() + _innerEdgeNodes.get_positions().size());
+    for (const glm::ivec3 &pos : _ringEdgeNodes.get_positions())
+        output->edgeVertices.push_back({pos, _meshChunk.vertexIndices[_ringEdgeNodes.get(pos)], true});
+    for (const glm::ivec3 &pos : _innerEdgeNodes.get_positions())
+        output->edgeVertices.push_back({pos, _meshChunk.vertexIndices[_innerEdgeNodes.get(pos)], false});
 
     return output;
 }
@@ -247,7 +315,8 @@ ChunkMeshData *StitchedSurfaceNets::generate_mesh_data(const JarVoxelTerrain &te
 //this function finds way too many possible nodes.
 //Possible improvement: check the octant, e.g. we dont need to find ringnodes towards neighbours of the same LOD
 //Possible improvement: use the same system of a crossed edge as before to verify if we need a quad or not
-std::vector<std::vector<int>> StitchedSurfaceNets::find_ring_nodes(const glm::ivec3 &pos, const int face) const
+int StitchedSurfaceNets::find_ring_nodes(const glm::ivec3 &pos, const int face,
+                                         std::array<glm::ivec2, 24> &result) const
 {
     static const glm::ivec3 face_offsets[3] = {glm::ivec3(1, 0, 0), glm::ivec3(0, 1, 0), glm::ivec3(0, 0, 1)};
     static const glm::ivec3 ring_offsets[3][8] = {
@@ -263,14 +332,14 @@ std::vector<std::vector<int>> StitchedSurfaceNets::find_ring_nodes(const glm::iv
     auto get_ring_node = [this](const glm::ivec3 pos) {
         glm::ivec3 ring_pos = glm::floor((glm::vec3(pos)) / 2.0f);
 
-        auto it = _ringEdgeNodes.find(ring_pos);
-        if (it == _ringEdgeNodes.end() || it->second < 0 || _meshChunk.vertexIndices[it->second] < 0)
+        const int node_id = _ringEdgeNodes.get(ring_pos);
+        if (node_id < 0 || _meshChunk.vertexIndices[node_id] < 0)
             return -1;
 
-        return it->second;
+        return node_id;
     };
 
-    std::vector<std::vector<int>> result;
+    int count = 0;
     for (size_t i = 0; i < 3; i++)//check all directions?
     {
         for (auto dir : ring_offsets[i])
@@ -278,24 +347,21 @@ std::vector<std::vector<int>> StitchedSurfaceNets::find_ring_nodes(const glm::iv
             int n0 = get_ring_node(pos + dir);
             int n1 = get_ring_node(pos + dir + face_offsets[i]);
     
-            if (n0 >= 0 && n1 >= 0)
-                result.push_back({n0, n1});
-            else if (n0 >= 0)
-                result.push_back({n0});
+            if (n0 >= 0)
+                result[count++] = glm::ivec2(n0, n1);
             else if (n1 >= 0)
-                result.push_back({n1});
+                result[count++] = glm::ivec2(n1, -1);
         }
     }
-    
 
-    return result;
+    return count;
 }
 
 //I'd rather not base the winding order on the normal, but it works for now. Only required for the edge chunk.
 inline void StitchedSurfaceNets::add_tri_fix_normal(int n0, int n1, int n2)
 {
-    godot::Vector3 normal = (_verts[n1] - _verts[n0]).cross(_verts[n2] - _verts[n0]);
-    add_tri(n0, n1, n2, normal.dot(_normals[n0]) > 0);
+    glm::vec3 normal = glm::cross(_verts[n1] - _verts[n0], _verts[n2] - _verts[n0]);
+    add_tri(n0, n1, n2, glm::dot(normal, _normals[n0]) > 0);
 }
 
 inline void StitchedSurfaceNets::add_tri(int n0, int n1, int n2, bool flip)
@@ -6,9 +6,9 @@
 #include "mesh_compute_scheduler.h"
 #include "voxel_lod.h"
 #include "voxel_octree_node.h"
+#include <array>
+#include <functional>
 #include <glm/glm.hpp>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
 #include <godot_cpp/variant/color.hpp>
 #include <godot_cpp/variant/packed_color_array.hpp>
 #include <godot_cpp/variant/packed_int32_array.hpp>
@@ -22,13 +22,24 @@ class JarVoxelTerrain;
 class StitchedSurfaceNets
 {
   private:
-    PackedVector3Array _verts;
-    PackedVector3Array _normals;
-    PackedColorArray _colors;
-    PackedInt32Array _indices;
-    std::vector<bool> _badNormals;
-    std::unordered_map<glm::ivec3, int> _innerEdgeNodes;
-    std::unordered_map<glm::ivec3, int> _ringEdgeNodes;
+    // The passes write plain vectors, the Packed arrays of the mesh are allocated and filled once at the end. The
+    // vectors belong to the thread and are reused by every chunk it meshes, so they stop growing after a few chunks.
+    struct MeshBuffers
+    {
+        std::vector<glm::vec3> verts;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec4> colors;
+        std::vector<int32_t> indices;
+    };
+    static MeshBuffers &thread_buffers();
+
+    MeshBuffers &_buffers;
+    std::vector<glm::vec3> &_verts;
+    std::vector<glm::vec3> &_normals;
+    std::vector<glm::vec4> &_colors;
+    std::vector<int32_t> &_indices;
+    GridLut<StitchedMeshChunk::ChunkRes> _innerEdgeNodes;
+    GridLut<StitchedMeshChunk::RingRes> _ringEdgeNodes;
 
     const VoxelOctreeNode *_chunk;
     const bool _cubicVoxels;
@@ -36,12 +47,19 @@ class StitchedSurfaceNets
 
     inline void add_tri(int n0, int n1, int n2, bool flip);
     inline void add_tri_fix_normal(int n0, int n1, int n2);
-    void create_vertex(const int node_id, const std::vector<int> &neighbours, const bool on_ring);
-    std::vector<std::vector<int>> find_ring_nodes(const glm::ivec3 &pos, const int face) const;    
+    void reserve_buffers();
+    Array create_mesh_arrays() const;
+    void create_vertex(const int node_id, const StitchedMeshChunk::Neighbours &neighbours, const bool on_ring);
+    // pairs of ring nodes next to pos, the second one is -1 if only one was found
+    int find_ring_nodes(const glm::ivec3 &pos, const int face, std::array<glm::ivec2, 24> &result) const;
 
   public:
-    StitchedSurfaceNets(const JarVoxelTerrain &terrain, const VoxelOctreeNode &chunk);
-    ChunkMeshData *generate_mesh_data(const JarVoxelTerrain &terrain);
+    // at most one per thread at a time, they share the buffers of the thread
+    // the stitching follows observers, which stay the same while the chunk is meshed
+    StitchedSurfaceNets(const JarVoxelTerrain &terrain, const VoxelOctreeNode &chunk, const glm::vec3 &center,
+                        const LodObserverState &observers);
+    // cancelled is polled between the passes, the mesh is abandoned and null returned once it is true
+    ChunkMeshData *generate_mesh_data(const JarVoxelTerrain &terrain, const std::function<bool()> &cancelled = {});
 };
 
 #endif // SURFACE_NETS_H
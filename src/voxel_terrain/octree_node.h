@@ -1,76 +1,75 @@
 #ifndef OCTREE_NODE_H
 #define OCTREE_NODE_H
 
+#include "block_allocator.h"
 #include "bounds.h"
+#include "morton.h"
 #include <array>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <memory>
+#include <new>
 
+// A node of a linear octree. Nodes don't link to each other, a node is known by its morton locational key (see
+// morton.h) and the tree finds its parent, children and neighbours by key arithmetic.
 template <typename TNode>
 class OctreeNode {
 public:
-    std::unique_ptr<std::array<std::unique_ptr<TNode>, 8>> _children;
-    TNode* _parent = nullptr;
-    const glm::vec3 _center = {0, 0, 0};
-    const int _size = 0;
+    // all eight siblings live in one block, handed out by the allocator owned by the tree.
+    using Allocator = BlockAllocator<TNode, 8>;
 
-    OctreeNode(TNode* parent, const glm::vec3& center, int size)
-        : _parent(parent), _center(center), _size(size) {}
+    // child i sits in this direction from the center of its parent, bit 0 = x, bit 1 = y, bit 2 = z. The same
+    // order as the digits of the keys.
+    static constexpr int ChildDirections[8][3] = {
+        {-1, -1, -1}, {1, -1, -1}, {-1, 1, -1}, {1, 1, -1},
+        {-1, -1, 1},  {1, -1, 1},  {-1, 1, 1},  {1, 1, 1}
+    };
 
-    ~OctreeNode() {
-        prune_children();
-    }
+    const uint64_t _key = Morton::RootKey;
+    const int8_t _size = 0;
 
-    inline bool is_leaf() const {
-        return !_children; // Check if _children is null
-    }
+    OctreeNode(uint64_t key, int size)
+        : _key(key), _size(static_cast<int8_t>(size)) {}
 
     inline float edge_length(float scale) const {
         return (1 << _size) * scale;
     }
 
-    inline void prune_children() {
-        _children.reset(); // Automatically deletes children
+    // the center of child i, given the center of this node
+    inline glm::vec3 child_center(const glm::vec3& center, int i, float scale) const {
+        const int* direction = ChildDirections[i];
+        return center + glm::vec3(direction[0], direction[1], direction[2]) * (edge_length(scale) * 0.25f);
     }
 
-    inline Bounds get_bounds(float scale) const {
-        auto halfEdge = glm::vec3(edge_length(scale) * 0.5f);
-        return Bounds(_center - halfEdge, _center + halfEdge);
+    // the center is not stored, it follows from the key: the coordinates of the node at its depth, in a root of
+    // 2^depth nodes that is centered on the origin. Traversals pass the center down with child_center instead of
+    // decoding the key of every node.
+    glm::vec3 get_center(float scale) const {
+        const float edge = edge_length(scale);
+        const float rootHalfEdge = edge * static_cast<float>(1 << Morton::key_depth(_key)) * 0.5f;
+        return (glm::vec3(Morton::key_coords(_key)) + 0.5f) * edge - rootHalfEdge;
     }
 
-    void subdivide(float scale) {
-        if (_size <= min_size() || !is_leaf())
-            return;
-
-        float childOffset = edge_length(scale) * 0.25f;
-        int childSize = _size - 1;
-        static const glm::vec3 ChildPositions[] = {
-            {-1, -1, -1}, {1, -1, -1}, {-1, 1, -1}, {1, 1, -1},
-            {-1, -1, 1},  {1, -1, 1},  {-1, 1, 1},  {1, 1, 1}
-        };
+    // ends the lifetime of a block of siblings and hands it back to the allocator. Their children must have been
+    // released before.
+    static void destroy_block(TNode* siblings, Allocator& allocator) {
+        for (int i = 0; i < 8; ++i)
+            siblings[i].~TNode();
+        allocator.deallocate(siblings);
+    }
 
-        // Allocate array and create children
-        _children = std::make_unique<std::array<std::unique_ptr<TNode>, 8>>();
-        for (int i = 0; i < 8; ++i) {
-            (*_children)[i] = create_child_node(
-                _center + ChildPositions[i] * childOffset, childSize
-            );
-        }
+    inline Bounds get_bounds(float scale) const {
+        return get_bounds(scale, get_center(scale));
     }
 
-    int get_count() const {
-        int count = 1;
-        if (!is_leaf()) {
-            for (const auto& child : *_children) {
-                count += child->get_count();
-            }
-        }
-        return count;
+    inline Bounds get_bounds(float scale, const glm::vec3& center) const {
+        auto halfEdge = glm::vec3(edge_length(scale) * 0.5f);
+        return Bounds(center - halfEdge, center + halfEdge);
     }
 
 protected:
-    virtual int min_size() const { return 0; }
-    virtual std::unique_ptr<TNode> create_child_node(const glm::vec3& center, int size) = 0;
+    // not virtual on purpose, a vtable pointer would add 8 bytes to every node.
+    static constexpr int min_size() { return 0; }
 };
 
-#endif // OCTREE_NODE_H
\ No newline at end of file
+#endif // OCTREE_NODE_H
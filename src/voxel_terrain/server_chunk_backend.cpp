@@ -0,0 +1,341 @@
+#include "server_chunk_backend.h"
+#include "chunk_detail_generator.h"
+#include "voxel_chunk.h"
+#include "voxel_terrain.h"
+#include <godot_cpp/classes/world3d.hpp>
+
+ServerChunk::ServerChunk(ServerChunkBackend &backend) : _backend(backend)
+{
+    RenderingServer *rendering = RenderingServer::get_singleton();
+    PhysicsServer3D *physics = PhysicsServer3D::get_singleton();
+    if (backend.is_rendering())
+    {
+        _mesh = rendering->mesh_create();
+        _instance = rendering->instance_create();
+        rendering->instance_set_base(_instance, _mesh);
+        if (backend.get_material().is_valid())
+            rendering->instance_geometry_set_material_override(_instance, backend.get_material()->get_rid());
+        rendering->instance_geometry_set_cast_shadows_setting(_instance, backend.get_cast_shadows());
+    }
+
+    _shape = physics->concave_polygon_shape_create();
+    _body = physics->body_create();
+    physics->body_set_mode(_body, PhysicsServer3D::BODY_MODE_STATIC);
+    physics->body_add_shape(_body, _shape, Transform3D(), true);
+    physics->body_set_collision_layer(_body, backend.get_collision_layer());
+    physics->body_set_collision_mask(_body, backend.get_collision_mask());
+    // ray casts report the terrain as the collider
+    physics->body_attach_object_instance_id(_body, backend.get_terrain().get_instance_id());
+}
+
+ServerChunk::~ServerChunk()
+{
+    release_chunk_mesh_data();
+    clear_details(0);
+    RenderingServer *rendering = RenderingServer::get_singleton();
+    PhysicsServer3D *physics = PhysicsServer3D::get_singleton();
+    if (_instance.is_valid())
+        rendering->free_rid(_instance);
+    if (_mesh.is_valid())
+        rendering->free_rid(_mesh);
+    physics->free_rid(_body);
+    physics->free_rid(_shape);
+}
+
+int ServerChunk::get_lod() const
+{
+    return _lod;
+}
+
+uint16_t ServerChunk::get_boundaries() const
+{
+    return _boundaries;
+}
+
+int64_t ServerChunk::get_memory_usage() const
+{
+    return _renderMemory + _collisionMemory;
+}
+
+void ServerChunk::release()
+{
+    _backend.release_chunk(this);
+}
+
+void ServerChunk::release_chunk_mesh_data()
+{
+    delete _chunkMeshData;
+    _chunkMeshData = nullptr;
+}
+
+void ServerChunk::attach(const RID &scenario, const RID &space)
+{
+    if (_instance.is_valid())
+    {
+        RenderingServer::get_singleton()->instance_set_scenario(_instance, scenario);
+        for (const Detail &detail : _details)
+            RenderingServer::get_singleton()->instance_set_scenario(detail.instance, scenario);
+    }
+    PhysicsServer3D::get_singleton()->body_set_space(_body, space);
+}
+
+void ServerChunk::reset()
+{
+    release_chunk_mesh_data();
+    clear_details(0);
+    if (_mesh.is_valid())
+        RenderingServer::get_singleton()->mesh_clear(_mesh);
+    PhysicsServer3D::get_singleton()->body_set_shape_disabled(_body, 0, true);
+    _lod = 0;
+    _boundaries = 0;
+    _renderMemory = 0;
+    _collisionMemory = 0;
+}
+
+// same steps as JarVoxelChunk::update_chunk
+void ServerChunk::update_chunk(JarVoxelTerrain &terrain, VoxelOctreeNode *node, ChunkMeshData *chunkMeshData)
+{
+    if (_chunkMeshData != chunkMeshData)
+        release_chunk_mesh_data();
+    _chunkMeshData = chunkMeshData;
+    _lod = chunkMeshData->lod;
+    _boundaries = chunkMeshData->boundaries;
+    const glm::vec3 center = chunkMeshData->bounds.get_center();
+    _transform = terrain.get_global_transform().translated_local(Vector3(center.x, center.y, center.z));
+
+    if (_instance.is_valid())
+    {
+        RenderingServer *rendering = RenderingServer::get_singleton();
+        rendering->mesh_clear(_mesh);
+        rendering->mesh_add_surface_from_arrays(
+            _mesh, RenderingServer::PRIMITIVE_TRIANGLES, chunkMeshData->mesh_array, {}, {},
+            chunkMeshData->compressed ? int64_t(RenderingServer::ARRAY_FLAG_COMPRESS_ATTRIBUTES) : int64_t(0));
+        rendering->instance_set_transform(_instance, _transform);
+        _renderMemory = chunkMeshData->get_memory_usage();
+    }
+    PhysicsServer3D::get_singleton()->body_set_state(_body, PhysicsServer3D::BODY_STATE_TRANSFORM, _transform);
+
+    const bool generateCollider = _lod <= _backend.get_collider_lod_threshold();
+    if (generateCollider)
+    {
+        terrain.enqueue_chunk_collider(node);
+    }
+    else
+    {
+        PhysicsServer3D::get_singleton()->body_set_shape_disabled(_body, 0, true);
+        _collisionMemory = 0;
+    }
+
+    if (_instance.is_valid() && _lod <= 0)
+        update_details(terrain);
+    else
+        clear_details(0);
+
+    if (!generateCollider)
+        release_chunk_mesh_data();
+}
+
+void ServerChunk::update_collision_mesh()
+{
+    // queued twice, the first one already built it
+    if (_chunkMeshData == nullptr)
+        return;
+    PackedVector3Array faces = _chunkMeshData->create_collision_mesh();
+    _collisionMemory = faces.size() * sizeof(Vector3);
+    Dictionary data;
+    data["faces"] = faces;
+    data["backface_collision"] = false;
+    PhysicsServer3D *physics = PhysicsServer3D::get_singleton();
+    physics->shape_set_data(_shape, data);
+    physics->body_set_shape_disabled(_body, 0, false);
+    release_chunk_mesh_data();
+}
+
+void ServerChunk::update_details(JarVoxelTerrain &terrain)
+{
+    ChunkDetailGenerator generator = ChunkDetailGenerator(terrain.get_world_node());
+    TypedArray<JarTerrainDetail> terrainDetails = terrain.get_terrain_details();
+    TypedArray<MultiMesh> multiMeshes = generator.generate_details(terrainDetails, *_chunkMeshData);
+
+    RenderingServer *rendering = RenderingServer::get_singleton();
+    const size_t count = static_cast<size_t>(multiMeshes.size());
+    clear_details(count);
+    while (_details.size() < count)
+    {
+        Detail detail;
+        detail.instance = rendering->instance_create();
+        rendering->instance_set_scenario(detail.instance, terrain.get_world_3d()->get_scenario());
+        _details.push_back(detail);
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        Detail &detail = _details[i];
+        Ref<JarTerrainDetail> terrainDetail = terrainDetails[i];
+        detail.multiMesh = multiMeshes[i];
+        rendering->instance_set_base(detail.instance, detail.multiMesh->get_rid());
+        rendering->instance_set_transform(detail.instance, _transform);
+        if (terrainDetail->get_material().is_valid())
+            rendering->instance_geometry_set_material_override(detail.instance,
+                                                               terrainDetail->get_material()->get_rid());
+        rendering->instance_geometry_set_cast_shadows_setting(
+            detail.instance, terrainDetail->get_shadows_enabled() ? RenderingServer::SHADOW_CASTING_SETTING_ON
+                                                                  : RenderingServer::SHADOW_CASTING_SETTING_OFF);
+    }
+}
+
+// frees the detail instances past count
+void ServerChunk::clear_details(size_t count)
+{
+    while (_details.size() > count)
+    {
+        RenderingServer::get_singleton()->free_rid(_details.back().instance);
+        _details.pop_back();
+    }
+}
+
+ServerChunkBackend::ServerChunkBackend(JarVoxelTerrain &terrain) : _terrain(terrain)
+{
+    _rendering = !terrain.is_collision_only();
+    _colliderLodThreshold = terrain.get_collider_lod_threshold();
+    if (_rendering)
+        read_chunk_scene();
+}
+
+ServerChunkBackend::~ServerChunkBackend()
+{
+    for (ServerChunk *chunk : _chunks)
+        delete chunk;
+    for (ServerChunk *chunk : _pool)
+        delete chunk;
+}
+
+// the settings a scene chunk would have
+void ServerChunkBackend::read_chunk_scene()
+{
+    if (_terrain.get_chunk_scene().is_null())
+        return;
+    Node *instance = _terrain.get_chunk_scene()->instantiate();
+    if (JarVoxelChunk *chunk = Object::cast_to<JarVoxelChunk>(instance))
+    {
+        _colliderLodThreshold = chunk->get_collider_lod_threshold();
+        if (MeshInstance3D *meshInstance = chunk->get_mesh_instance())
+        {
+            _material = meshInstance->get_material_override();
+            _castShadows = static_cast<RenderingServer::ShadowCastingSetting>(meshInstance->get_cast_shadows_setting());
+        }
+        if (StaticBody3D *body = chunk->get_static_body())
+        {
+            _collisionLayer = body->get_collision_layer();
+            _collisionMask = body->get_collision_mask();
+        }
+    }
+    if (instance != nullptr)
+        memdelete(instance);
+}
+
+VoxelChunk *ServerChunkBackend::create_chunk()
+{
+    ServerChunk *chunk;
+    if (_pool.empty())
+    {
+        chunk = new ServerChunk(*this);
+        _chunksCreated++;
+    }
+    else
+    {
+        chunk = _pool.back();
+        _pool.pop_back();
+        _chunksReused++;
+    }
+    const Ref<World3D> world = _terrain.get_world_3d();
+    chunk->attach(world->get_scenario(), world->get_space());
+    _chunks.insert(chunk);
+    return chunk;
+}
+
+void ServerChunkBackend::release_chunk(ServerChunk *chunk)
+{
+    std::lock_guard<std::mutex> lock(_releasedMutex);
+    _released.push_back(chunk);
+}
+
+void ServerChunkBackend::process()
+{
+    std::vector<ServerChunk *> released;
+    {
+        std::lock_guard<std::mutex> lock(_releasedMutex);
+        released.swap(_released);
+    }
+    for (ServerChunk *chunk : released)
+    {
+        chunk->attach(RID(), RID());
+        chunk->reset();
+        _chunks.erase(chunk);
+        _pool.push_back(chunk);
+    }
+
+    for (size_t trim = pool_trim_count(_pool.size()); trim > 0; --trim)
+    {
+        delete _pool.back();
+        _pool.pop_back();
+    }
+}
+
+void ServerChunkBackend::exit_world()
+{
+    for (ServerChunk *chunk : _chunks)
+        chunk->attach(RID(), RID());
+}
+
+int64_t ServerChunkBackend::get_chunk_count() const
+{
+    return static_cast<int64_t>(_chunks.size());
+}
+
+int64_t ServerChunkBackend::get_memory_usage() const
+{
+    int64_t memory = 0;
+    for (const ServerChunk *chunk : _chunks)
+        memory += chunk->get_memory_usage();
+    return memory;
+}
+
+int64_t ServerChunkBackend::get_pool_size() const
+{
+    return static_cast<int64_t>(_pool.size());
+}
+
+JarVoxelTerrain &ServerChunkBackend::get_terrain() const
+{
+    return _terrain;
+}
+
+bool ServerChunkBackend::is_rendering() const
+{
+    return _rendering;
+}
+
+const Ref<Material> &ServerChunkBackend::get_material() const
+{
+    return _material;
+}
+
+RenderingServer::ShadowCastingSetting ServerChunkBackend::get_cast_shadows() const
+{
+    return _castShadows;
+}
+
+uint32_t ServerChunkBackend::get_collision_layer() const
+{
+    return _collisionLayer;
+}
+
+uint32_t ServerChunkBackend::get_collision_mask() const
+{
+    return _collisionMask;
+}
+
+int ServerChunkBackend::get_collider_lod_threshold() const
+{
+    return _colliderLodThreshold;
+}
@@ -0,0 +1,109 @@
+#ifndef SERVER_CHUNK_BACKEND_H
+#define SERVER_CHUNK_BACKEND_H
+
+#include "chunk_backend.h"
+#include <godot_cpp/classes/material.hpp>
+#include <godot_cpp/classes/multi_mesh.hpp>
+#include <godot_cpp/classes/physics_server3d.hpp>
+#include <godot_cpp/classes/rendering_server.hpp>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+using namespace godot;
+
+class ServerChunkBackend;
+
+// A chunk made of server objects only, a render instance of its own mesh and a static body with a concave shape.
+// Nothing of it is in the scene tree.
+class ServerChunk : public VoxelChunk
+{
+  public:
+    explicit ServerChunk(ServerChunkBackend &backend);
+    ~ServerChunk() override;
+
+    int get_lod() const override;
+    uint16_t get_boundaries() const override;
+    void update_chunk(JarVoxelTerrain &terrain, VoxelOctreeNode *node, ChunkMeshData *chunkMeshData) override;
+    void update_collision_mesh() override;
+    int64_t get_memory_usage() const override;
+    void release() override;
+
+    // into the scenario and the physics space of the terrain, or out of them with invalid RIDs
+    void attach(const RID &scenario, const RID &space);
+    // back to how it was created, for the pool
+    void reset();
+
+  private:
+    struct Detail
+    {
+        RID instance;
+        Ref<MultiMesh> multiMesh;
+    };
+
+    ServerChunkBackend &_backend;
+    RID _instance; // invalid without rendering
+    RID _mesh;
+    RID _body;
+    RID _shape;
+    std::vector<Detail> _details;
+    Transform3D _transform;
+
+    ChunkMeshData *_chunkMeshData = nullptr; // owned, kept until the collider is built from it
+    int _lod = 0;
+    uint16_t _boundaries = 0;
+    int64_t _renderMemory = 0;
+    int64_t _collisionMemory = 0;
+
+    void release_chunk_mesh_data();
+    void update_details(JarVoxelTerrain &terrain);
+    void clear_details(size_t count);
+};
+
+// Chunks straight through the RenderingServer and the PhysicsServer3D, without the node and scene tree overhead of
+// SceneChunkBackend. Material, shadows, collision layers and collider threshold come from the chunk scene of the
+// terrain, which is instantiated once for that. Released chunks keep their RIDs in a pool for the next chunk. The
+// chunks are placed with the transform the terrain had when they were last updated.
+class ServerChunkBackend : public ChunkBackend
+{
+  public:
+    explicit ServerChunkBackend(JarVoxelTerrain &terrain);
+    ~ServerChunkBackend() override;
+
+    VoxelChunk *create_chunk() override;
+    void process() override;
+    void exit_world() override;
+
+    int64_t get_chunk_count() const override;
+    int64_t get_memory_usage() const override;
+    int64_t get_pool_size() const override;
+
+    // any thread, the chunk leaves the world with the next process
+    void release_chunk(ServerChunk *chunk);
+
+    JarVoxelTerrain &get_terrain() const;
+    bool is_rendering() const;
+    const Ref<Material> &get_material() const;
+    RenderingServer::ShadowCastingSetting get_cast_shadows() const;
+    uint32_t get_collision_layer() const;
+    uint32_t get_collision_mask() const;
+    int get_collider_lod_threshold() const;
+
+  private:
+    JarVoxelTerrain &_terrain;
+    bool _rendering = true;
+    Ref<Material> _material;
+    RenderingServer::ShadowCastingSetting _castShadows = RenderingServer::SHADOW_CASTING_SETTING_ON;
+    uint32_t _collisionLayer = 1;
+    uint32_t _collisionMask = 1;
+    int _colliderLodThreshold = 1;
+
+    std::unordered_set<ServerChunk *> _chunks; // in the world, main thread
+    std::vector<ServerChunk *> _pool;
+    std::mutex _releasedMutex;
+    std::vector<ServerChunk *> _released;
+
+    void read_chunk_scene();
+};
+
+#endif // SERVER_CHUNK_BACKEND_H
@@ -0,0 +1,124 @@
+#include "voxel_brick.h"
+#include "voxel_octree_node.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+VoxelBrick::VoxelBrick(const Bounds &chunkBounds, int chunkResolution)
+    : _resolution(chunkResolution + 2), _leafSize(chunkBounds.get_size().x / chunkResolution),
+      _origin(chunkBounds.min - glm::vec3(_leafSize * 0.5f))
+{
+    const size_t count = static_cast<size_t>(_resolution) * _resolution * _resolution;
+    _values.resize(count, 0.0f);
+    _colors.resize(count, VoxelOctreeNode::COLOR_NONE);
+}
+
+void VoxelBrick::fill(const JarSignedDistanceField &sdf, const std::vector<ModifySettings> &edits, float scale)
+{
+    // one batch per slice, the values of a slice are contiguous
+    const int sliceSize = _resolution * _resolution;
+    std::vector<glm::vec3> positions(sliceSize);
+    for (int z = 0; z < _resolution; ++z)
+    {
+        int i = 0;
+        for (int y = 0; y < _resolution; ++y)
+            for (int x = 0; x < _resolution; ++x, ++i)
+                positions[i] = get_position(x, y, z);
+        sdf.distance_batch(positions.data(), &_values[index(0, 0, z)], sliceSize);
+    }
+    std::fill(_colors.begin(), _colors.end(), static_cast<uint8_t>(VoxelOctreeNode::COLOR_NONE));
+
+    for (const auto &settings : edits)
+        apply(settings, scale);
+}
+
+void VoxelBrick::apply(const ModifySettings &settings, float scale)
+{
+    if (settings.sdf.is_null())
+        return;
+
+    // only visit the samples whose center lies inside of the edit bounds
+    const glm::ivec3 first =
+        glm::max(glm::ivec3(glm::ceil((settings.bounds.min - _origin) / _leafSize)), glm::ivec3(0));
+    const glm::ivec3 last =
+        glm::min(glm::ivec3(glm::floor((settings.bounds.max - _origin) / _leafSize)), glm::ivec3(_resolution - 1));
+
+    for (int z = first.z; z <= last.z; ++z)
+        for (int y = first.y; y <= last.y; ++y)
+            for (int x = first.x; x <= last.x; ++x)
+            {
+                const int i = index(x, y, z);
+                const float oldValue = _values[i];
+                const float sdfValue = settings.sdf->distance(get_position(x, y, z) - settings.position);
+                _values[i] = SDF::apply_operation(settings.operation, oldValue, sdfValue, scale);
+                if (std::abs(_values[i] - oldValue) > 0.01f)
+                    _colors[i] = VoxelOctreeNode::COLOR_EDITED;
+            }
+}
+
+float VoxelBrick::sample(const JarSignedDistanceField &sdf, const BrickEditIndex &edits, const glm::vec3 &position,
+                         float scale, uint8_t &colorIndex)
+{
+    float value = sdf.distance(position);
+    colorIndex = apply_edits(edits, position, value, scale);
+    return value;
+}
+
+void VoxelBrick::apply_edit(const ModifySettings &settings, const glm::vec3 &position, float &value, float scale,
+                            uint8_t &colorIndex)
+{
+    if (settings.sdf.is_null() || !settings.bounds.contains_point(position))
+        return;
+    const float oldValue = value;
+    value = SDF::apply_operation(settings.operation, value, settings.sdf->distance(position - settings.position), scale);
+    if (std::abs(value - oldValue) > 0.01f)
+        colorIndex = VoxelOctreeNode::COLOR_EDITED;
+}
+
+uint8_t VoxelBrick::apply_edits(const BrickEditIndex &edits, const glm::vec3 &position, float &value, float scale)
+{
+    uint8_t colorIndex = VoxelOctreeNode::COLOR_NONE;
+    edits.for_each_at(position, [&](const ModifySettings &settings) {
+        apply_edit(settings, position, value, scale, colorIndex);
+    });
+    return colorIndex;
+}
+
+uint8_t VoxelBrick::apply_edits(const std::vector<ModifySettings> &edits, const glm::vec3 &position, float &value,
+                                float scale)
+{
+    uint8_t colorIndex = VoxelOctreeNode::COLOR_NONE;
+    for (const auto &settings : edits)
+        apply_edit(settings, position, value, scale, colorIndex);
+    return colorIndex;
+}
+
+JarSignedDistanceField::Range VoxelBrick::apply_range(const ModifySettings &settings, const Bounds &region,
+                                                      const JarSignedDistanceField::Range &range, float scale)
+{
+    constexpr float Infinity = std::numeric_limits<float>::infinity();
+    if (settings.sdf.is_null() || !settings.bounds.intersects(region))
+        return range;
+    const JarSignedDistanceField::Range edit =
+        settings.sdf->distance_range(Bounds(region.min - settings.position, region.max - settings.position));
+    // the smooth operations turn infinite inputs into nan
+    if (!std::isfinite(range.min) || !std::isfinite(range.max) || !std::isfinite(edit.min) ||
+        !std::isfinite(edit.max))
+        return {-Infinity, Infinity};
+
+    // the subtractions are the only operations that fall as the edit value rises
+    const bool falling = settings.operation == SDF::SDF_OPERATION_SUBTRACTION ||
+                         settings.operation == SDF::SDF_OPERATION_SMOOTH_SUBTRACTION;
+    const JarSignedDistanceField::Range edited = {
+        SDF::apply_operation(settings.operation, range.min, falling ? edit.max : edit.min, scale),
+        SDF::apply_operation(settings.operation, range.max, falling ? edit.min : edit.max, scale)};
+    if (settings.bounds.encloses(region))
+        return edited;
+    // the samples outside of the edit bounds keep their value
+    return {std::min(range.min, edited.min), std::max(range.max, edited.max)};
+}
+
+size_t VoxelBrick::get_memory_usage() const
+{
+    return sizeof(VoxelBrick) + _values.capacity() * sizeof(float) + _colors.capacity() * sizeof(uint8_t);
+}
@@ -0,0 +1,75 @@
+#ifndef VOXEL_BRICK_H
+#define VOXEL_BRICK_H
+
+#include "bounds.h"
+#include "brick_edit_index.h"
+#include "modify_settings.h"
+#include "signed_distance_field.h"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Dense block of SDF samples that replaces the subtree below a chunk level node in brick mode.
+// It holds one sample per leaf of the chunk at its lod, plus one apron layer on each side, which is exactly the grid
+// the stitched mesher works on. Sample (0, 0, 0) is the apron leaf below the minimum corner of the chunk.
+class VoxelBrick
+{
+  private:
+    int _resolution = 0;
+    float _leafSize = 0.0f;
+    glm::vec3 _origin{0.0f}; // center of sample 0
+    std::vector<float> _values;
+    std::vector<uint8_t> _colors;
+
+    static void apply_edit(const ModifySettings &settings, const glm::vec3 &position, float &value, float scale,
+                           uint8_t &colorIndex);
+
+  public:
+    VoxelBrick(const Bounds &chunkBounds, int chunkResolution);
+
+    // evaluates the terrain sdf at every sample and replays the given edits on top of it.
+    void fill(const JarSignedDistanceField &sdf, const std::vector<ModifySettings> &edits, float scale);
+    // applies an edit to the samples inside its bounds.
+    void apply(const ModifySettings &settings, float scale);
+
+    // the value at a single position, for samples outside of any brick. Uses the same rules as fill and apply.
+    static float sample(const JarSignedDistanceField &sdf, const BrickEditIndex &edits, const glm::vec3 &position,
+                        float scale, uint8_t &colorIndex);
+    // replays the edits containing position on an sdf value that was already evaluated, returns the color index.
+    static uint8_t apply_edits(const BrickEditIndex &edits, const glm::vec3 &position, float &value, float scale);
+    static uint8_t apply_edits(const std::vector<ModifySettings> &edits, const glm::vec3 &position, float &value,
+                               float scale);
+    // the range of the values over region after the edit, given their range before it. Conservative, every operation
+    // is monotonic in both of its inputs.
+    static JarSignedDistanceField::Range apply_range(const ModifySettings &settings, const Bounds &region,
+                                                     const JarSignedDistanceField::Range &range, float scale);
+
+    inline int get_resolution() const
+    {
+        return _resolution;
+    }
+    inline int get_sample_count() const
+    {
+        return static_cast<int>(_values.size());
+    }
+    inline int index(int x, int y, int z) const
+    {
+        return x + _resolution * (y + _resolution * z);
+    }
+    inline glm::vec3 get_position(int x, int y, int z) const
+    {
+        return _origin + glm::vec3(x, y, z) * _leafSize;
+    }
+    inline float get_value(int i) const
+    {
+        return _values[i];
+    }
+    inline uint8_t get_color_index(int i) const
+    {
+        return _colors[i];
+    }
+
+    size_t get_memory_usage() const;
+};
+
+#endif // VOXEL_BRICK_H
@@ -62,6 +62,64 @@ JarVoxelChunk::JarVoxelChunk() : lod(0), edge_chunk(false)
 
 JarVoxelChunk::~JarVoxelChunk()
 {
+    release_chunk_mesh_data();
+}
+
+JarVoxelChunk *JarVoxelChunk::create_collision_only(int p_collider_lod_threshold)
+{
+    JarVoxelChunk *chunk = memnew(JarVoxelChunk);
+    chunk->collision_only = true;
+    chunk->collider_lod_threshold = p_collider_lod_threshold;
+
+    chunk->static_body = memnew(StaticBody3D);
+    chunk->add_child(chunk->static_body);
+    chunk->collision_shape = memnew(CollisionShape3D);
+    chunk->collision_shape->set_disabled(true);
+    chunk->static_body->add_child(chunk->collision_shape);
+    chunk->concave_polygon_shape.instantiate();
+    chunk->collision_shape->set_shape(chunk->concave_polygon_shape);
+    return chunk;
+}
+
+bool JarVoxelChunk::is_collision_only() const
+{
+    return collision_only;
+}
+
+int64_t JarVoxelChunk::get_memory_usage() const
+{
+    return render_memory + collision_memory;
+}
+
+void JarVoxelChunk::set_backend(SceneChunkBackend *p_backend)
+{
+    backend = p_backend;
+}
+
+void JarVoxelChunk::reset_chunk()
+{
+    release_chunk_mesh_data();
+    hide();
+    if (array_mesh.is_valid())
+        array_mesh->clear_surfaces();
+    if (collision_shape != nullptr)
+        collision_shape->set_disabled(true);
+    if (concave_polygon_shape.is_valid())
+        concave_polygon_shape->set_faces(PackedVector3Array());
+    // the instances stay for the next details
+    for (MultiMeshInstance3D *multi_mesh_instance : multi_mesh_instances)
+        multi_mesh_instance->set_multimesh(Ref<MultiMesh>());
+    lod = 0;
+    boundaries = 0;
+    edge_chunk = false;
+    render_memory = 0;
+    collision_memory = 0;
+}
+
+void JarVoxelChunk::release_chunk_mesh_data()
+{
+    delete _chunk_mesh_data;
+    _chunk_mesh_data = nullptr;
 }
 
 int JarVoxelChunk::get_lod() const
@@ -84,12 +142,12 @@ void JarVoxelChunk::set_collider_lod_threshold(int p_collider_lod_threshold)
     collider_lod_threshold = p_collider_lod_threshold;
 }
 
-uint8_t JarVoxelChunk::get_boundaries() const
+uint16_t JarVoxelChunk::get_boundaries() const
 {
     return boundaries;
 }
 
-void JarVoxelChunk::set_boundaries(uint8_t p_h2lboundaries)
+void JarVoxelChunk::set_boundaries(uint16_t p_h2lboundaries)
 {
     boundaries = p_h2lboundaries;
 }
@@ -167,11 +225,11 @@ void JarVoxelChunk::set_material(Ref<ShaderMaterial> p_material)
 
 void JarVoxelChunk::update_chunk(JarVoxelTerrain &terrain, VoxelOctreeNode *node, ChunkMeshData *chunk_mesh_data)
 {
+    if (_chunk_mesh_data != chunk_mesh_data)
+        release_chunk_mesh_data();
     _chunk_mesh_data = chunk_mesh_data;
-    array_mesh = Ref<ArrayMesh>(Object::cast_to<ArrayMesh>(*mesh_instance->get_mesh()));
     concave_polygon_shape =
         Ref<ConcavePolygonShape3D>(Object::cast_to<ConcavePolygonShape3D>(*collision_shape->get_shape()));
-    material = Ref<ShaderMaterial>(Object::cast_to<ShaderMaterial>(*mesh_instance->get_material_override()));
     lod = chunk_mesh_data->lod;
     boundaries = chunk_mesh_data->boundaries;
     edge_chunk = chunk_mesh_data->edge_chunk;
@@ -181,8 +239,16 @@ void JarVoxelChunk::update_chunk(JarVoxelTerrain &terrain, VoxelOctreeNode *node
     // auto position = bounds.get_center() * 1.05f;
     set_position({position.x, position.y, position.z});
 
-    array_mesh->clear_surfaces();
-    array_mesh->add_surface_from_arrays(Mesh::PRIMITIVE_TRIANGLES, chunk_mesh_data->mesh_array);
+    if (!collision_only)
+    {
+        array_mesh = Ref<ArrayMesh>(Object::cast_to<ArrayMesh>(*mesh_instance->get_mesh()));
+        material = Ref<ShaderMaterial>(Object::cast_to<ShaderMaterial>(*mesh_instance->get_material_override()));
+        array_mesh->clear_surfaces();
+        array_mesh->add_surface_from_arrays(Mesh::PRIMITIVE_TRIANGLES, chunk_mesh_data->mesh_array, {}, {},
+                                            chunk_mesh_data->compressed ? int64_t(Mesh::ARRAY_FLAG_COMPRESS_ATTRIBUTES)
+                                                                        : int64_t(0));
+        render_memory = chunk_mesh_data->get_memory_usage();
+    }
 
     bool generate_collider = lod <= collider_lod_threshold;
 
@@ -195,10 +261,11 @@ void JarVoxelChunk::update_chunk(JarVoxelTerrain &terrain, VoxelOctreeNode *node
     else
     {
         collision_shape->set_disabled(true);
+        collision_memory = 0;
     }
 
     //generate details
-    if(lod <= 0) {
+    if(lod <= 0 && !collision_only) {
         ChunkDetailGenerator generator = ChunkDetailGenerator(terrain.get_world_node());
         TypedArray<JarTerrainDetail> terrain_details = terrain.get_terrain_details();
         TypedArray<MultiMesh> multi_meshes = generator.generate_details(terrain_details, *chunk_mesh_data);
@@ -214,6 +281,10 @@ void JarVoxelChunk::update_chunk(JarVoxelTerrain &terrain, VoxelOctreeNode *node
         }
     }
 
+    // the mesh is uploaded and the details are placed, only the collider still needs the data
+    if (!generate_collider)
+        release_chunk_mesh_data();
+
     // Ref<StandardMaterial3D> stitch_material;
     // stitch_material.instantiate();
     // stitch_material->set_albedo(Color(1, 0, 1));
@@ -237,8 +308,22 @@ void JarVoxelChunk::update_chunk(JarVoxelTerrain &terrain, VoxelOctreeNode *node
 void JarVoxelChunk::update_collision_mesh()
 {
     // if(is_queued_for_deletion()) return;
+    // queued twice, the first one already built it
+    if (_chunk_mesh_data == nullptr)
+        return;
+    PackedVector3Array faces = _chunk_mesh_data->create_collision_mesh();
+    collision_memory = faces.size() * sizeof(Vector3);
     collision_shape->set_disabled(false);
-    concave_polygon_shape->set_faces(_chunk_mesh_data->create_collision_mesh());
+    concave_polygon_shape->set_faces(faces);
+    release_chunk_mesh_data();
+}
+
+void JarVoxelChunk::release()
+{
+    if (backend != nullptr)
+        backend->release_chunk(this);
+    else
+        queue_free();
 }
 
 void JarVoxelChunk::delete_chunk()
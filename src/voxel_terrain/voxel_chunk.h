@@ -2,6 +2,7 @@
 #define JAR_VOXEL_CHUNK_H
 
 #include "bounds.h"
+#include "chunk_backend.h"
 #include "chunk_mesh_data.h"
 #include <godot_cpp/classes/array_mesh.hpp>
 #include <godot_cpp/classes/collision_shape3d.hpp>
@@ -18,7 +19,7 @@ using namespace godot;
 class JarVoxelTerrain;
 class VoxelOctreeNode;
 
-class JarVoxelChunk : public Node3D
+class JarVoxelChunk : public Node3D, public VoxelChunk
 {
     GDCLASS(JarVoxelChunk, Node3D);
 
@@ -27,10 +28,19 @@ class JarVoxelChunk : public Node3D
     int collider_lod_threshold = 1;
     uint16_t boundaries = 0;
     bool edge_chunk = false;
+    // no mesh instance and no details, see create_collision_only
+    bool collision_only = false;
     Bounds bounds;
+    // estimated size of the surface and collider data the chunk holds
+    int64_t render_memory = 0;
+    int64_t collision_memory = 0;
 
-    // node references
+    // owned, kept until the collider is built from it
     ChunkMeshData* _chunk_mesh_data = nullptr;
+    // takes the chunk back on release, freed right away without one
+    SceneChunkBackend* backend = nullptr;
+
+    // node references
     MeshInstance3D* mesh_instance = nullptr;
     CollisionShape3D* collision_shape = nullptr;
     StaticBody3D* static_body = nullptr;
@@ -51,18 +61,30 @@ class JarVoxelChunk : public Node3D
 
     void _update_multi_mesh_instances(int n);
 
+    void release_chunk_mesh_data();
+
   public:
     JarVoxelChunk();
     ~JarVoxelChunk();
 
-    int get_lod() const;
+    // A chunk made of a static body and its collision shape only, for servers that never render the terrain. It takes
+    // the place of the chunk scene.
+    static JarVoxelChunk *create_collision_only(int p_collider_lod_threshold);
+    bool is_collision_only() const;
+    int64_t get_memory_usage() const override;
+
+    void set_backend(SceneChunkBackend* p_backend);
+    // back to an empty, hidden chunk for the pool, the nodes and resources are kept
+    void reset_chunk();
+
+    int get_lod() const override;
     void set_lod(int p_lod);
 
     int get_collider_lod_threshold() const;
     void set_collider_lod_threshold(int p_collider_lod_threshold);
 
-    uint8_t get_boundaries() const;
-    void set_boundaries(uint8_t p_boundaries);
+    uint16_t get_boundaries() const override;
+    void set_boundaries(uint16_t p_boundaries);
 
     bool is_edge_chunk() const;
     void set_edge_chunk(bool p_edge_chunk);
@@ -85,8 +107,9 @@ class JarVoxelChunk : public Node3D
     Ref<ShaderMaterial> get_material() const;
     void set_material(Ref<ShaderMaterial> p_material);
 
-    void update_chunk(JarVoxelTerrain &terrain, VoxelOctreeNode *node, ChunkMeshData *chunk_mesh_data);
-    void update_collision_mesh();
+    void update_chunk(JarVoxelTerrain &terrain, VoxelOctreeNode *node, ChunkMeshData *chunk_mesh_data) override;
+    void update_collision_mesh() override;
+    void release() override;
     void delete_chunk();
 };
 
@@ -1,22 +1,60 @@
 #include "voxel_lod.h"
 #include "voxel_terrain.h"
 #include "mesh_compute_scheduler.h"
+#include <limits>
+
+namespace
+{
+// a minus b as up to six boxes, slabs are cut off along x first, then y and z
+void append_difference(Bounds a, const Bounds &b, std::vector<Bounds> &out)
+{
+    if (!a.intersects(b))
+    {
+        out.push_back(a);
+        return;
+    }
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (a.min[axis] < b.min[axis])
+        {
+            Bounds slab = a;
+            slab.max[axis] = b.min[axis];
+            out.push_back(slab);
+            a.min[axis] = b.min[axis];
+        }
+        if (a.max[axis] > b.max[axis])
+        {
+            Bounds slab = a;
+            slab.min[axis] = b.max[axis];
+            out.push_back(slab);
+            a.max[axis] = b.max[axis];
+        }
+    }
+}
+} // namespace
 
 JarVoxelLoD::JarVoxelLoD()
     : _automaticUpdate(true), _automaticUpdateDistance(32.0f), _lodLevelCount(20),
-       _autoMeshCoolDown(0.0f), _cameraPosition(0.0f, 0.0f, 0.0f)
+       _autoMeshCoolDown(0.0f), _state(std::make_shared<const LodObserverState>()),
+       _builtCameraPosition(0.0f, 0.0f, 0.0f), _builtPredictedPosition(0.0f), _observerPosition(0.0f), _velocity(0.0f)
 {
 }
 
 JarVoxelLoD::JarVoxelLoD(const bool automaticUpdate, const float automaticUpdateDistance, const int lodLevelCount, const int shellSize, const float octreeScale)
     : _automaticUpdate(automaticUpdate), _automaticUpdateDistance(automaticUpdateDistance), _lodLevelCount(lodLevelCount), _shellSize(shellSize), _octreeScale(octreeScale),
-       _autoMeshCoolDown(0.0f), _cameraPosition(0.0f, 0.0f, 0.0f)
+       _autoMeshCoolDown(0.0f), _state(std::make_shared<const LodObserverState>()),
+       _builtCameraPosition(0.0f, 0.0f, 0.0f), _builtPredictedPosition(0.0f), _observerPosition(0.0f), _velocity(0.0f)
 {
 }
 
 glm::vec3 JarVoxelLoD::get_camera_position() const
 {
-    return _cameraPosition;
+    return _state->cameraPosition;
+}
+
+std::shared_ptr<const LodObserverState> JarVoxelLoD::get_observer_state() const
+{
+    return _state;
 }
 
 bool JarVoxelLoD::process(const JarVoxelTerrain &terrain, double delta)
@@ -26,28 +64,203 @@ bool JarVoxelLoD::process(const JarVoxelTerrain &terrain, double delta)
     return update_camera_position(terrain, false);
 }
 
-bool JarVoxelLoD::update_camera_position(const JarVoxelTerrain &terrain, const bool force)
+bool JarVoxelLoD::observer_position(const JarVoxelTerrain &terrain, glm::vec3 &position) const
 {
-    if (terrain.is_building())
-        return false;
     auto player = terrain.get_player_node();
     if (player == nullptr)
         return false;
 
     auto p = player->get_global_transform().origin - terrain.get_global_position();
-    glm::vec3 glmp = {p.x, p.y, p.z};
+    position = {p.x, p.y, p.z};
+    return true;
+}
 
-    if (force || (glm::distance(_cameraPosition, glmp) > _automaticUpdateDistance))
+bool JarVoxelLoD::update_camera_position(const JarVoxelTerrain &terrain, const bool force)
+{
+    if (terrain.is_building())
+        return false;
+    std::vector<Observer> observers;
+    terrain.get_observer_positions(observers);
+    glm::vec3 glmp;
+    if (!observer_position(terrain, glmp))
     {
-        _cameraPosition = glmp;
+        // a dedicated server has no player, the first observer stands in for the camera
+        if (observers.empty())
+            return false;
+        glmp = observers.front().position;
+        observers.erase(observers.begin());
+    }
+
+    // turning at speed swings the predicted position around, that needs an update as much as moving does
+    const glm::vec3 predicted = predict(glmp);
+    if (force || (glm::distance(_state->cameraPosition, glmp) > _automaticUpdateDistance) ||
+        (glm::distance(_state->predictedPosition, predicted) > _automaticUpdateDistance) ||
+        _state->predicting != (_predictionTime > 0.0f) || observers_moved(observers))
+    {
+        // built aside and swapped in, the state of the jobs still running stays as it was
+        auto state = std::make_shared<LodObserverState>();
+        state->cameraPosition = glmp;
+        state->predictedPosition = predicted;
+        state->predicting = _predictionTime > 0.0f;
+        state->observers = std::move(observers);
+        if (state->observers.size() > ObserverIndexThreshold)
+        {
+            std::vector<glm::vec3> positions{glmp};
+            for (const Observer &observer : state->observers)
+                positions.push_back(observer.position);
+            state->index.build(positions, _octreeScale, _shellSize);
+        }
+        _state = std::move(state);
         return true;
     }
     return false;
 }
 
-int JarVoxelLoD::desired_lod(const VoxelOctreeNode &node)
+bool JarVoxelLoD::same_observers(const std::vector<Observer> &a, const std::vector<Observer> &b)
+{
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                      [](const Observer &x, const Observer &y) { return x.id == y.id; });
+}
+
+bool JarVoxelLoD::observers_moved(const std::vector<Observer> &observers) const
+{
+    const std::vector<Observer> &current = _state->observers;
+    if (!same_observers(observers, current))
+        return true;
+    for (size_t i = 0; i < observers.size(); ++i)
+        if (glm::distance(observers[i].position, current[i].position) > _automaticUpdateDistance)
+            return true;
+    return false;
+}
+
+// smoothed over about a quarter of a second, a single long frame doesn't throw the prediction off
+void JarVoxelLoD::track_observer(const JarVoxelTerrain &terrain, double delta)
 {
-    auto l = node._size > _maxChunkSize ? 0 : lod_at(node._center);
+    glm::vec3 position;
+    if (delta <= 0.0 || !observer_position(terrain, position))
+        return;
+    if (_hasObserver)
+    {
+        const glm::vec3 velocity = (position - _observerPosition) / static_cast<float>(delta);
+        const float blend = static_cast<float>(std::min(1.0, delta * 4.0));
+        _velocity += (velocity - _velocity) * blend;
+    }
+    _observerPosition = position;
+    _hasObserver = true;
+}
+
+glm::vec3 JarVoxelLoD::predict(const glm::vec3 &position) const
+{
+    return _predictionTime > 0.0f ? position + _velocity * _predictionTime : position;
+}
+
+void JarVoxelLoD::set_prediction_time(float seconds)
+{
+    // a build may be reading the state, the next update publishes the prediction
+    _predictionTime = std::max(0.0f, seconds);
+}
+
+glm::vec3 JarVoxelLoD::get_observer_velocity() const
+{
+    return _velocity;
+}
+
+glm::vec3 JarVoxelLoD::get_predicted_position() const
+{
+    return _state->predictedPosition;
+}
+
+bool JarVoxelLoD::is_prefetch(const glm::vec3 &position) const
+{
+    const LodObserverState &state = *_state;
+    return state.predicting && lod_for_camera(position, state.predictedPosition) < observed_lod(state, position);
+}
+
+size_t JarVoxelLoD::get_observer_count() const
+{
+    return _state->observers.size();
+}
+
+float JarVoxelLoD::distance_to_other_observer(const glm::vec3 &position) const
+{
+    float distance = std::numeric_limits<float>::infinity();
+    for (const Observer &observer : _state->observers)
+        distance = std::min(distance, glm::distance(position, observer.position));
+    return distance;
+}
+
+void JarVoxelLoD::mark_built()
+{
+    _builtCameraPosition = _state->cameraPosition;
+    _builtPredictedPosition = _state->predictedPosition;
+    _builtWithPrediction = _state->predicting;
+    _builtObservers = _state->observers;
+    _hasBuiltCamera = true;
+}
+
+// the lod is the minimum over all cameras, it can only change where one of them changed
+bool JarVoxelLoD::changed_regions(const Bounds &tree, std::vector<Bounds> &regions) const
+{
+    const LodObserverState &state = *_state;
+    if (!_hasBuiltCamera || _builtWithPrediction != state.predicting ||
+        !same_observers(_builtObservers, state.observers))
+        return false;
+    const size_t first = regions.size();
+    append_changed_shells(_builtCameraPosition, state.cameraPosition, tree, regions);
+    if (_builtWithPrediction)
+        append_changed_shells(_builtPredictedPosition, state.predictedPosition, tree, regions);
+    for (size_t i = 0; i < state.observers.size(); ++i)
+        append_changed_shells(_builtObservers[i].position, state.observers[i].position, tree, regions);
+
+    // largest first, then every box that one before it holds goes
+    std::sort(regions.begin() + first, regions.end(),
+              [](const Bounds &a, const Bounds &b) {
+                  const glm::vec3 sizeA = a.get_size(), sizeB = b.get_size();
+                  return sizeA.x * sizeA.y * sizeA.z > sizeB.x * sizeB.y * sizeB.z;
+              });
+    size_t kept = first;
+    for (size_t i = first; i < regions.size(); ++i)
+    {
+        bool enclosed = false;
+        for (size_t j = first; j < kept && !enclosed; ++j)
+            enclosed = regions[j].encloses(regions[i]);
+        if (!enclosed)
+            regions[kept++] = regions[i];
+    }
+    regions.resize(kept);
+    return true;
+}
+
+void JarVoxelLoD::append_changed_shells(const glm::vec3 &fromCamera, const glm::vec3 &toCamera, const Bounds &tree,
+                                        std::vector<Bounds> &regions) const
+{
+    // same units as lod_for_camera
+    constexpr float ChunkSize = 16.0f;
+    const glm::vec3 from = fromCamera / ChunkSize;
+    const glm::vec3 to = toCamera / ChunkSize;
+    // lod_to_grid_size shifts by lod + 1
+    for (int lod = 0; lod < 30; ++lod)
+    {
+        const float gridSize = lod_to_grid_size(lod) * 2.0f;
+        const glm::vec3 oldCenter = snap_to_grid(from, gridSize) * ChunkSize;
+        const glm::vec3 newCenter = snap_to_grid(to, gridSize) * ChunkSize;
+        const glm::vec3 extent(gridSize * _shellSize * ChunkSize);
+        const Bounds oldShell(oldCenter - extent, oldCenter + extent);
+        const Bounds newShell(newCenter - extent, newCenter + extent);
+        if (oldCenter != newCenter)
+        {
+            append_difference(oldShell, newShell, regions);
+            append_difference(newShell, oldShell, regions);
+        }
+        // every node already is in this shell or a finer one, whatever the coarser shells do
+        if (oldShell.encloses(tree) && newShell.encloses(tree))
+            break;
+    }
+}
+
+int JarVoxelLoD::desired_lod(const VoxelOctreeNode &node, const glm::vec3 &center)
+{
+    auto l = node._size > _maxChunkSize ? 0 : lod_at(center);
     return l;
 }
 
@@ -69,10 +282,29 @@ inline bool JarVoxelLoD::is_in_lod_shell(int lod, glm::vec3 pos, glm::vec3 cam_p
     return dist < (grid_size * _shellSize);
 }
 
-inline int JarVoxelLoD::lod_at(const glm::vec3 &position) const {
+// the build reads the current state, update_camera_position waits for it to finish
+int JarVoxelLoD::lod_at(const glm::vec3 &position) const {
+    return lod_at(*_state, position);
+}
+
+int JarVoxelLoD::lod_at(const LodObserverState &observers, const glm::vec3 &position) const {
+    const int lod = observed_lod(observers, position);
+    return observers.predicting ? std::min(lod, lod_for_camera(position, observers.predictedPosition)) : lod;
+}
+
+int JarVoxelLoD::observed_lod(const LodObserverState &observers, const glm::vec3 &position) const {
+    if (!observers.index.empty())
+        return observers.index.lod_at(position);
+    int lod = lod_for_camera(position, observers.cameraPosition);
+    for (const Observer &observer : observers.observers)
+        lod = std::min(lod, lod_for_camera(position, observer.position));
+    return lod;
+}
+
+inline int JarVoxelLoD::lod_for_camera(const glm::vec3 &position, const glm::vec3 &camera) const {
     constexpr float rChunksize = 1.0f / 16.0f;
     glm::vec3 pos = position * rChunksize;
-    glm::vec3 cam_pos = _cameraPosition * rChunksize;
+    glm::vec3 cam_pos = camera * rChunksize;
 
     //OLD: use for loop
     // for (int lod = 0; lod < _lodLevelCount; ++lod) {
@@ -83,11 +315,12 @@ inline int JarVoxelLoD::lod_at(const glm::vec3 &position) const {
     // return - 1; // Fallback to the largest LOD
 
     //NEW: use logarithm + adjustment.
-    glm::vec3 delta = glm::abs(pos - cam_pos) / (2.0f * _shellSize);
-    int lod = glm::max(0, int(floor(glm::log2(glm::max(1.0f, glm::max(delta.x, glm::max(delta.y, delta.z)))))));
-    //Approximation is at most 1 off, so check if it should be +1 or -1.
-    if(!is_in_lod_shell(lod, pos, cam_pos)) return lod + 1;
-    if(lod <= 0 || !is_in_lod_shell(lod - 1, pos, cam_pos)) return lod;
-    return lod - 1;
+    glm::vec3 delta = glm::abs(pos - cam_pos) / (2.0f * _shellSize * _octreeScale);
+    int lod = glm::min(29, glm::max(0, int(floor(glm::log2(glm::max(1.0f, glm::max(delta.x, glm::max(delta.y, delta.z))))))));
+    //Approximation is about 1 off, walk to the first shell holding pos. Shells nest, so that is the finest lod, the
+    //same the observer index and append_changed_shells work with.
+    while(lod < 30 && !is_in_lod_shell(lod, pos, cam_pos)) ++lod;
+    while(lod > 0 && is_in_lod_shell(lod - 1, pos, cam_pos)) --lod;
+    return lod;
 }
 
@@ -1,6 +1,8 @@
 #ifndef LEVEL_OF_DETAIL_H
 #define LEVEL_OF_DETAIL_H
 
+#include "bounds.h"
+#include "lod_observer_index.h"
 #include "voxel_octree_node.h"
 #include <algorithm>
 #include <functional>
@@ -9,6 +11,7 @@
 #include <godot_cpp/classes/resource.hpp>
 #include <godot_cpp/core/class_db.hpp>
 #include <godot_cpp/variant/vector3.hpp>
+#include <memory>
 #include <vector>
 
 using namespace godot;
@@ -17,6 +20,9 @@ class JarVoxelTerrain;
 
 class JarVoxelLoD
 {
+  public:
+    using Observer = LodObserver;
+
   private:
     float _automaticUpdateDistance = 64;
     float _octreeScale = 1.0f;
@@ -26,11 +32,39 @@ class JarVoxelLoD
 
     int _maxChunkSize;
     float _autoMeshCoolDown;
-    glm::vec3 _cameraPosition;
+    // Camera, prediction and other observers of the last update. Only replaced as a whole by update_camera_position,
+    // which waits for the build to finish. Mesh jobs hold on to the one they were submitted with.
+    std::shared_ptr<const LodObserverState> _state;
+    // the camera of the last build, unset until the first one
+    glm::vec3 _builtCameraPosition;
+    bool _hasBuiltCamera = false;
+
+    // Prediction. The lod is the finer one of the camera and of where the observer will be in _predictionTime
+    // seconds at its current velocity, so the chunks ahead are ready when it gets there.
+    float _predictionTime = 0.0f; // 0 turns it off
+    glm::vec3 _builtPredictedPosition;
+    bool _builtWithPrediction = false;
+    glm::vec3 _observerPosition;
+    glm::vec3 _velocity;
+    bool _hasObserver = false;
+
+    // Other observers, the lod is the finest any of them asks for. A few are looped over, past ObserverIndexThreshold
+    // lod_at goes through the index instead and stays independent of the player count.
+    static constexpr size_t ObserverIndexThreshold = 4;
+    std::vector<Observer> _builtObservers;
 
     inline float lod_to_grid_size(const int lod) const;
     inline glm::vec3 snap_to_grid(const glm::vec3 pos, const float grid_size) const;
     inline bool is_in_lod_shell(int lod, glm::vec3 pos, glm::vec3 cam_pos) const;
+    inline int lod_for_camera(const glm::vec3 &position, const glm::vec3 &camera) const;
+    void append_changed_shells(const glm::vec3 &from, const glm::vec3 &to, const Bounds &tree,
+                               std::vector<Bounds> &regions) const;
+    bool observer_position(const JarVoxelTerrain &terrain, glm::vec3 &position) const;
+    glm::vec3 predict(const glm::vec3 &position) const;
+    // lod of the camera and the other observers, without the prediction
+    int observed_lod(const LodObserverState &observers, const glm::vec3 &position) const;
+    bool observers_moved(const std::vector<Observer> &observers) const;
+    static bool same_observers(const std::vector<Observer> &a, const std::vector<Observer> &b);
 
   protected:
     
@@ -44,9 +78,31 @@ class JarVoxelLoD
 
     bool process(const JarVoxelTerrain &terrain, double delta);
     bool update_camera_position(const JarVoxelTerrain &terrain, const bool force);
+    // every frame, building or not, so the velocity stays current
+    void track_observer(const JarVoxelTerrain &terrain, double delta);
 
-    int desired_lod(const VoxelOctreeNode &node);
+    void set_prediction_time(float seconds);
+    glm::vec3 get_observer_velocity() const;
+    glm::vec3 get_predicted_position() const;
+    // true if position only gets its lod because of the prediction, the camera alone would be fine with a coarser one
+    bool is_prefetch(const glm::vec3 &position) const;
+
+    size_t get_observer_count() const;
+    // to the closest observer other than the camera, infinite without one
+    float distance_to_other_observer(const glm::vec3 &position) const;
+
+    int desired_lod(const VoxelOctreeNode &node, const glm::vec3 &center);
     int lod_at(const glm::vec3 &position) const;
+    int lod_at(const LodObserverState &observers, const glm::vec3 &position) const;
+    // main thread, the state lod_at currently works with
+    std::shared_ptr<const LodObserverState> get_observer_state() const;
+
+    // Boxes outside of which lod_at returns the same as for the cameras of the last build. Every shell whose snapped
+    // center moved adds the difference of its old and new box, shells stop at the first one holding all of tree.
+    // Boxes inside another one are dropped, observers close to each other mostly move the same shells.
+    // Returns false if there was no build yet or observers came or went since.
+    bool changed_regions(const Bounds &tree, std::vector<Bounds> &regions) const;
+    void mark_built();
 
 };
 
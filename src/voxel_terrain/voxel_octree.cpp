@@ -0,0 +1,254 @@
+#include "voxel_octree.h"
+#include "voxel_terrain.h"
+#include <algorithm>
+#include <cmath>
+
+void VoxelOctree::reset(int size, float scale)
+{
+    clear();
+    if (size > Morton::MaxDepth)
+    {
+        UtilityFunctions::printerr("The octree size is limited to " + String::num_int64(Morton::MaxDepth) + ".");
+        size = Morton::MaxDepth;
+    }
+    _size = size;
+    _scale = scale;
+    _root = std::make_unique<VoxelOctreeNode>(size);
+}
+
+void VoxelOctree::clear()
+{
+    {
+        std::lock_guard<std::mutex> lock(_bricksMutex);
+        _bricks.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(_chunksMutex);
+        _chunks.clear();
+    }
+    for (IndexShard &shard : _index)
+    {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.children.clear();
+    }
+    _retiredBlocks.clear();
+    _root.reset();
+    _allocator.clear();
+}
+
+void VoxelOctree::link_children(uint64_t key, VoxelOctreeNode *children)
+{
+    IndexShard &shard = _index[shard_index(key)];
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    shard.children[key] = children;
+}
+
+VoxelOctreeNode *VoxelOctree::get_children(uint64_t key) const
+{
+    const IndexShard &shard = _index[shard_index(key)];
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.children.find(key);
+    return it == shard.children.end() ? nullptr : it->second;
+}
+
+uint64_t VoxelOctree::key_at(const glm::vec3 &position, int size) const
+{
+    const int depth = _size - size;
+    if (depth < 0 || depth > Morton::MaxDepth)
+        return InvalidKey;
+
+    // the root is centered on the origin
+    const float rootHalfEdge = (1 << _size) * _scale * 0.5f;
+    const float edge = (1 << size) * _scale;
+    const glm::vec3 cell = glm::floor((position + rootHalfEdge) / edge);
+    const float resolution = static_cast<float>(1 << depth);
+    if (glm::any(glm::lessThan(cell, glm::vec3(0.0f))) || glm::any(glm::greaterThanEqual(cell, glm::vec3(resolution))))
+        return InvalidKey;
+    return Morton::make_key(glm::uvec3(cell), depth);
+}
+
+VoxelOctreeNode *VoxelOctree::find_node(uint64_t key, bool closestAncestor) const
+{
+    if (_root == nullptr || key == InvalidKey)
+        return nullptr;
+
+    // a node is a child of its parent key, move up a level at a time while there is none
+    for (; key != Morton::RootKey; key = Morton::parent_key(key))
+    {
+        if (VoxelOctreeNode *siblings = get_children(Morton::parent_key(key)))
+            return &siblings[Morton::child_index(key)];
+        if (!closestAncestor)
+            return nullptr;
+    }
+    return _root.get();
+}
+
+VoxelOctreeNode *VoxelOctree::find_parent(const VoxelOctreeNode &node) const
+{
+    if (node._key == Morton::RootKey)
+        return nullptr;
+    return find_node(Morton::parent_key(node._key));
+}
+
+VoxelOctreeNode *VoxelOctree::find_neighbour(const VoxelOctreeNode &node, const glm::ivec3 &offset) const
+{
+    uint64_t neighbourKey;
+    if (!Morton::neighbour_key(node._key, offset, neighbourKey))
+        return nullptr;
+    return find_node(neighbourKey, true);
+}
+
+VoxelOctreeNode *VoxelOctree::find_enclosing_node(const Bounds &bounds) const
+{
+    // the common prefix of the corner keys is the key of the enclosing node. The corners move out by half a cell of
+    // the finest level, so the nodes that only touch bounds are enclosed as well, as with the bounds tests.
+    const int size = std::max(0, _size - Morton::MaxDepth);
+    const glm::vec3 margin((1 << size) * _scale * 0.5f);
+    uint64_t minKey = key_at(bounds.min - margin, size);
+    uint64_t maxKey = key_at(bounds.max + margin, size);
+    if (minKey == InvalidKey || maxKey == InvalidKey)
+        return _root.get();
+    while (minKey != maxKey)
+    {
+        minKey = Morton::parent_key(minKey);
+        maxKey = Morton::parent_key(maxKey);
+    }
+    return find_node(minKey, true);
+}
+
+void VoxelOctree::retire_children(uint64_t key)
+{
+    IndexShard &shard = _index[shard_index(key)];
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.children.find(key);
+    if (it == shard.children.end())
+        return;
+    _retiredBlocks.push_back(it->second);
+    shard.children.erase(it);
+}
+
+void VoxelOctree::release_retired_blocks()
+{
+    for (VoxelOctreeNode *siblings : _retiredBlocks)
+        VoxelOctreeNode::destroy_block(siblings, _allocator);
+    _retiredBlocks.clear();
+}
+
+size_t VoxelOctree::get_retired_block_count() const
+{
+    return _retiredBlocks.size();
+}
+
+size_t VoxelOctree::get_node_count() const
+{
+    if (_root == nullptr)
+        return 0;
+    return 1 + _allocator.get_blocks_in_use() * 8;
+}
+
+size_t VoxelOctree::get_bytes_reserved() const
+{
+    return sizeof(VoxelOctreeNode) + _allocator.get_bytes_reserved();
+}
+
+size_t VoxelOctree::get_index_memory_usage() const
+{
+    // a heap allocated entry per subdivided node, holding the key, the block and the link to the next entry, and a
+    // pointer per bucket
+    constexpr size_t EntryBytes = sizeof(uint64_t) + 2 * sizeof(void *);
+    size_t bytes = 0;
+    for (const IndexShard &shard : _index)
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        bytes += shard.children.size() * EntryBytes + shard.children.bucket_count() * sizeof(void *);
+    }
+    return bytes;
+}
+
+std::shared_ptr<VoxelBrick> VoxelOctree::get_brick(const VoxelOctreeNode *node) const
+{
+    std::lock_guard<std::mutex> lock(_bricksMutex);
+    auto it = _bricks.find(node);
+    return it == _bricks.end() ? nullptr : it->second;
+}
+
+void VoxelOctree::set_brick(const VoxelOctreeNode *node, std::shared_ptr<VoxelBrick> brick)
+{
+    std::lock_guard<std::mutex> lock(_bricksMutex);
+    _bricks[node] = std::move(brick);
+}
+
+void VoxelOctree::release_brick(const VoxelOctreeNode *node)
+{
+    std::lock_guard<std::mutex> lock(_bricksMutex);
+    _bricks.erase(node);
+}
+
+size_t VoxelOctree::get_brick_count() const
+{
+    std::lock_guard<std::mutex> lock(_bricksMutex);
+    return _bricks.size();
+}
+
+size_t VoxelOctree::get_brick_memory_usage() const
+{
+    std::lock_guard<std::mutex> lock(_bricksMutex);
+    size_t bytes = 0;
+    for (const auto &[node, brick] : _bricks)
+        bytes += brick->get_memory_usage();
+    return bytes;
+}
+
+VoxelChunk *VoxelOctree::get_chunk(const VoxelOctreeNode *node) const
+{
+    std::lock_guard<std::mutex> lock(_chunksMutex);
+    auto it = _chunks.find(node);
+    return it == _chunks.end() ? nullptr : it->second;
+}
+
+void VoxelOctree::set_chunk(const VoxelOctreeNode *node, VoxelChunk *chunk)
+{
+    std::lock_guard<std::mutex> lock(_chunksMutex);
+    _chunks[node] = chunk;
+}
+
+VoxelChunk *VoxelOctree::take_chunk(const VoxelOctreeNode *node)
+{
+    std::lock_guard<std::mutex> lock(_chunksMutex);
+    auto it = _chunks.find(node);
+    if (it == _chunks.end())
+        return nullptr;
+    VoxelChunk *chunk = it->second;
+    _chunks.erase(it);
+    return chunk;
+}
+
+void VoxelOctree::get_voxel_leaves_in_bounds(const JarVoxelTerrain &terrain, const Bounds &bounds,
+                                             std::vector<VoxelOctreeNode *> &nodes,
+                                             std::vector<glm::vec3> &centers) const
+{
+    if (_root != nullptr)
+        _root->get_voxel_leaves_in_bounds(terrain, _root->get_center(_scale), bounds, nodes, centers);
+}
+
+void VoxelOctree::get_voxel_leaves_in_bounds(const JarVoxelTerrain &terrain, const Bounds &bounds, int lod,
+                                             std::vector<VoxelOctreeNode *> &nodes,
+                                             std::vector<glm::vec3> &centers) const
+{
+    if (_root == nullptr)
+        return;
+    VoxelOctreeNode *node = find_enclosing_node(bounds);
+    node->get_voxel_leaves_in_bounds(terrain, node->get_center(_scale), bounds, lod, nodes, centers);
+}
+
+void VoxelOctree::get_voxel_leaves_in_bounds_excluding_bounds(const JarVoxelTerrain &terrain, const Bounds &bounds,
+                                                              const Bounds &excludeBounds, int lod,
+                                                              std::vector<VoxelOctreeNode *> &nodes,
+                                                              std::vector<glm::vec3> &centers) const
+{
+    if (_root == nullptr)
+        return;
+    VoxelOctreeNode *node = find_enclosing_node(bounds);
+    node->get_voxel_leaves_in_bounds_excluding_bounds(terrain, node->get_center(_scale), bounds, excludeBounds, lod,
+                                                      nodes, centers);
+}
@@ -0,0 +1,159 @@
+#ifndef VOXEL_OCTREE_H
+#define VOXEL_OCTREE_H
+
+#include "bounds.h"
+#include "morton.h"
+#include "voxel_brick.h"
+#include "voxel_octree_node.h"
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+class JarVoxelTerrain;
+
+// Owns the voxel octree: the root node, the pool that holds every other node and the index that ties them together.
+// The tree is a hashed linear octree. Nodes carry their morton locational key (see morton.h) instead of pointers to
+// their parent and children, and the index maps the key of every subdivided node to the pooled block of its eight
+// children. A parent, child or neighbour is found by key arithmetic and a single lookup, and a node of any depth by
+// its key without descending from the root. Sparse edits and lod changes still only touch the blocks they need, and
+// since all siblings share one pooled block the whole tree can also be visited linearly.
+class VoxelOctree
+{
+  private:
+    // declared before the root: the allocator owns the memory of every node below it.
+    VoxelOctreeNode::Allocator _allocator;
+    std::unique_ptr<VoxelOctreeNode> _root;
+    int _size = 0;
+    float _scale = 1.0f;
+
+    // the index, split by key into shards with a lock each. Sibling subtrees are built in parallel and subdivide at
+    // the same time, while mesh jobs look up children.
+    struct IndexShard
+    {
+        std::unordered_map<uint64_t, VoxelOctreeNode *> children;
+        mutable std::shared_mutex mutex;
+    };
+    static constexpr int IndexShardBits = 6;
+    std::array<IndexShard, 1 << IndexShardBits> _index;
+
+    // the keys of siblings and neighbours only differ in their low bits, a multiplicative hash spreads them
+    static inline size_t shard_index(uint64_t key)
+    {
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> (64 - IndexShardBits));
+    }
+
+    // bricks of the chunk level nodes in brick mode. Kept out of the nodes so they stay small, and shared so a mesher
+    // can keep reading a brick that the build thread releases in the meantime. Never changed once set, an edit swaps
+    // in an edited copy.
+    std::unordered_map<const VoxelOctreeNode *, std::shared_ptr<VoxelBrick>> _bricks;
+    mutable std::mutex _bricksMutex;
+
+    // the chunks of the nodes that have a mesh in the world, kept out of the nodes for the same reason. Nodes flag
+    // whether they have one, so only those look here.
+    std::unordered_map<const VoxelOctreeNode *, VoxelChunk *> _chunks;
+    mutable std::mutex _chunksMutex;
+
+    // sibling blocks of pruned subtrees. Mesh jobs and the collider queue may still point at their nodes, so they
+    // stay alive, cancelled and without chunks, until nothing refers to them anymore. Main thread only.
+    std::vector<VoxelOctreeNode *> _retiredBlocks;
+
+  public:
+    static constexpr uint64_t InvalidKey = 0;
+
+    VoxelOctree() = default;
+    VoxelOctree(const VoxelOctree &) = delete;
+    VoxelOctree &operator=(const VoxelOctree &) = delete;
+
+    // drops the current tree and starts a new one with a single root node of 2^size voxels. The keys limit the tree
+    // to Morton::MaxDepth levels below the root.
+    void reset(int size, float scale);
+    void clear();
+
+    inline bool is_valid() const
+    {
+        return _root != nullptr;
+    }
+    inline VoxelOctreeNode *get_root() const
+    {
+        return _root.get();
+    }
+    inline VoxelOctreeNode::Allocator &get_allocator()
+    {
+        return _allocator;
+    }
+    inline const VoxelOctreeNode::Allocator &get_allocator() const
+    {
+        return _allocator;
+    }
+
+    // structure. A node that subdivides links the block of its children here, pruning retires it again.
+    void link_children(uint64_t key, VoxelOctreeNode *children);
+    // the block of the eight children of the node with the given key, nullptr for a leaf
+    VoxelOctreeNode *get_children(uint64_t key) const;
+
+    // keys
+    uint64_t key_at(const glm::vec3 &position, int size) const;
+    // returns the node with the given key, or its deepest existing ancestor if closestAncestor is set.
+    VoxelOctreeNode *find_node(uint64_t key, bool closestAncestor = false) const;
+    // nullptr for the root
+    VoxelOctreeNode *find_parent(const VoxelOctreeNode &node) const;
+    // the neighbour of the same size offset nodes away, or the leaf covering that space if the tree is coarser
+    // there. Returns nullptr outside of the tree.
+    VoxelOctreeNode *find_neighbour(const VoxelOctreeNode &node, const glm::ivec3 &offset) const;
+    // the smallest existing node that contains bounds, the root if bounds reach outside of the tree
+    VoxelOctreeNode *find_enclosing_node(const Bounds &bounds) const;
+
+    // visits every node exactly once in memory order, the root first. The tree must not change while iterating.
+    template <typename TFunc> void for_each_node(TFunc &&func) const
+    {
+        if (_root == nullptr)
+            return;
+        func(*_root);
+        _allocator.for_each_block([&func](VoxelOctreeNode *siblings) {
+            for (int i = 0; i < 8; ++i)
+                func(siblings[i]);
+        });
+    }
+
+    // pruning. Takes the children of the node with the given key out of the index, their block is kept alive until
+    // release_retired_blocks.
+    void retire_children(uint64_t key);
+    // destroys the retired blocks, only once no mesh job or queued collider can reach them
+    void release_retired_blocks();
+    size_t get_retired_block_count() const;
+
+    size_t get_node_count() const;
+    size_t get_bytes_reserved() const;
+    // an estimate, the hash tables don't report their allocations
+    size_t get_index_memory_usage() const;
+
+    // bricks
+    std::shared_ptr<VoxelBrick> get_brick(const VoxelOctreeNode *node) const;
+    void set_brick(const VoxelOctreeNode *node, std::shared_ptr<VoxelBrick> brick);
+    void release_brick(const VoxelOctreeNode *node);
+    size_t get_brick_count() const;
+    size_t get_brick_memory_usage() const;
+
+    // chunks
+    VoxelChunk *get_chunk(const VoxelOctreeNode *node) const;
+    void set_chunk(const VoxelOctreeNode *node, VoxelChunk *chunk);
+    // removes the chunk of node and returns it, nullptr if it had none
+    VoxelChunk *take_chunk(const VoxelOctreeNode *node);
+
+    // queries, centers gets the center of each node appended to nodes
+    void get_voxel_leaves_in_bounds(const JarVoxelTerrain &terrain, const Bounds &bounds,
+                                    std::vector<VoxelOctreeNode *> &nodes, std::vector<glm::vec3> &centers) const;
+    void get_voxel_leaves_in_bounds(const JarVoxelTerrain &terrain, const Bounds &bounds, int lod,
+                                    std::vector<VoxelOctreeNode *> &nodes, std::vector<glm::vec3> &centers) const;
+    void get_voxel_leaves_in_bounds_excluding_bounds(const JarVoxelTerrain &terrain, const Bounds &bounds,
+                                                     const Bounds &excludeBounds, int lod,
+                                                     std::vector<VoxelOctreeNode *> &nodes,
+                                                     std::vector<glm::vec3> &centers) const;
+};
+
+#endif // VOXEL_OCTREE_H
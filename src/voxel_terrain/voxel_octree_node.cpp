@@ -4,20 +4,48 @@
 #include <cmath>
 #include <execution>
 
-VoxelOctreeNode::VoxelOctreeNode(int size) : VoxelOctreeNode(nullptr, glm::vec3(0.0f), size)
+const glm::vec4 VoxelOctreeNode::ColorPalette[COLOR_COUNT] = {
+    glm::vec4(0, 0, 0, 0), // COLOR_NONE
+    glm::vec4(1, 0, 0, 1), // COLOR_EDITED
+};
+
+VoxelOctreeNode::VoxelOctreeNode(int size) : OctreeNode(Morton::RootKey, size), _isMaterialized(0b00000000)
 {
 }
 
-VoxelOctreeNode::VoxelOctreeNode(VoxelOctreeNode *parent, const glm::vec3 center, int size)
-    : OctreeNode(parent, center, size), _isMaterialized(0b00000000)
+VoxelOctreeNode::VoxelOctreeNode(uint64_t key, int size, const VoxelOctreeNode &parent)
+    : OctreeNode(key, size), _isMaterialized(0b00000000)
 {
-    if (_parent != nullptr)
-    {
-        LoD = _parent->LoD;
-        _value = _parent->get_value();
-        _isSet = _parent->_isSet;
-        NodeColor = _parent->NodeColor;
-    }
+    LoD = parent.LoD;
+    set_flag(FLAG_SET, parent.is_set());
+    _colorIndex = parent._colorIndex;
+    // requantized, the child covers a smaller range. A new parent was a leaf, so its value is up to date.
+    _value = encode_value(parent.decode_value());
+}
+
+VoxelOctreeNode *VoxelOctreeNode::get_children(const JarVoxelTerrain &terrain) const
+{
+    return is_leaf() ? nullptr : terrain.get_octree().get_children(_key);
+}
+
+VoxelOctreeNode *VoxelOctreeNode::get_parent(const JarVoxelTerrain &terrain) const
+{
+    return terrain.get_octree().find_parent(*this);
+}
+
+// the children are in the index before the flag tells anyone to look for them
+void VoxelOctreeNode::subdivide(JarVoxelTerrain &terrain)
+{
+    if (_size <= min_size() || !is_leaf())
+        return;
+
+    // construct the siblings in place in one contiguous block, the last digit of their key is their index
+    VoxelOctree &octree = terrain.get_octree();
+    VoxelOctreeNode *children = octree.get_allocator().allocate();
+    for (int i = 0; i < 8; ++i)
+        new (&children[i]) VoxelOctreeNode(Morton::child_key(_key, i), _size - 1, *this);
+    octree.link_children(_key, children);
+    set_flag(FLAG_SUBDIVIDED, true);
 }
 
 int VoxelOctreeNode::priority() const
@@ -27,38 +55,43 @@ int VoxelOctreeNode::priority() const
 
 bool VoxelOctreeNode::is_dirty() const
 {
-    return _isDirty;
+    return has_flag(FLAG_DIRTY);
 }
 
-void VoxelOctreeNode::set_dirty(bool value)
+void VoxelOctreeNode::set_dirty(const JarVoxelTerrain &terrain, bool value)
 {
-    if (!_isDirty && value && _parent != nullptr)
-    {
-        _parent->set_dirty(true);
-    }
-    _isDirty = value;
+    if (!is_dirty() && value)
+        if (VoxelOctreeNode *parent = get_parent(terrain))
+            parent->set_dirty(terrain, true);
+    set_flag(FLAG_DIRTY, value);
 }
 
 // todo, make threadsafe. It's currently maybe fine (due to the way the scheduler is set up), but better safe than
 // sorry.
-float VoxelOctreeNode::get_value()
+float VoxelOctreeNode::get_value(const JarVoxelTerrain &terrain)
 {
     if (!is_dirty())
-        return _value;
-    if (!is_leaf())
+        return decode_value();
+    if (VoxelOctreeNode *children = get_children(terrain))
     {
-        _value = 0;
-        NodeColor = glm::vec4(0, 0, 0, 0);
-        for (auto &child : (*_children))
+        float value = 0;
+        int colorCounts[COLOR_COUNT] = {};
+        for (int i = 0; i < 8; ++i)
         {
-            _value += child->get_value();
-            NodeColor += child->NodeColor;
+            value += children[i].get_value(terrain);
+            ++colorCounts[children[i]._colorIndex];
         }
-        _value *= 0.125f;
-        NodeColor *= 0.125f;
+        // stored without set_value, which would mark the clean ancestors dirty again
+        _value = encode_value(value * 0.125f);
+
+        // a palette index can't be averaged, take the most common one among the children
+        _colorIndex = COLOR_NONE;
+        for (int c = 1; c < COLOR_COUNT; ++c)
+            if (colorCounts[c] > 0 && colorCounts[c] >= colorCounts[_colorIndex])
+                _colorIndex = c;
     }
-    _isDirty = false;
-    return _value;
+    set_flag(FLAG_DIRTY, false);
+    return decode_value();
 }
 
 int VoxelOctreeNode::get_lod() const
@@ -68,39 +101,52 @@ int VoxelOctreeNode::get_lod() const
 
 glm::vec4 VoxelOctreeNode::get_color() const
 {
-    return NodeColor;
+    return ColorPalette[_colorIndex];
 }
 
-void VoxelOctreeNode::set_value(float value)
+uint8_t VoxelOctreeNode::get_color_index() const
 {
-    _value = value;
-    _isDirty = false;
-    if (_parent != nullptr)
-    {
-        _parent->set_dirty(true);
-    }
+    return _colorIndex;
 }
 
-void VoxelOctreeNode::mark_materialized()
+int16_t VoxelOctreeNode::encode_value(float value) const
+{
+    const float normalized = glm::clamp(value / ((1 << _size) * ValueRange), -1.0f, 1.0f);
+    long quantized = std::lround(normalized * ValueSteps);
+    // never round a tiny distance to zero, the meshers rely on the sign
+    if (quantized == 0 && value != 0.0f)
+        quantized = value > 0.0f ? 1 : -1;
+    return static_cast<int16_t>(quantized);
+}
+
+void VoxelOctreeNode::set_value(const JarVoxelTerrain &terrain, float value)
+{
+    _value = encode_value(value);
+    set_flag(FLAG_DIRTY, false);
+    if (VoxelOctreeNode *parent = get_parent(terrain))
+        parent->set_dirty(terrain, true);
+}
+
+void VoxelOctreeNode::mark_materialized(const JarVoxelTerrain &terrain)
 {
     if (is_materialized())
         return; // already marked
-    if (is_leaf())
-    {
-        _isMaterialized = 0b11111111;
-    }
-    else
+    if (VoxelOctreeNode *children = get_children(terrain))
     {
         for (size_t i = 0; i < 8; ++i)
         {
-            _isMaterialized |= _children->at(i)->is_materialized() ? 1 : 0 << i;
+            _isMaterialized |= children[i].is_materialized() ? 1 : 0 << i;
         }
     }
-
-    if (_parent != nullptr && is_materialized())
+    else
     {
-        _parent->mark_materialized();
+        _isMaterialized = 0b11111111;
     }
+
+    if (!is_materialized())
+        return;
+    if (VoxelOctreeNode *parent = get_parent(terrain))
+        parent->mark_materialized(terrain);
 }
 
 inline bool VoxelOctreeNode::is_materialized()
@@ -109,9 +155,9 @@ inline bool VoxelOctreeNode::is_materialized()
     return _isMaterialized == 0b11111111;
 }
 
-JarVoxelChunk *VoxelOctreeNode::get_chunk() const
+VoxelChunk *VoxelOctreeNode::get_chunk(const JarVoxelTerrain &terrain) const
 {
-    return _chunk;
+    return has_chunk() ? terrain.get_octree().get_chunk(this) : nullptr;
 }
 
 bool VoxelOctreeNode::is_chunk(const JarVoxelTerrain &terrain) const
@@ -134,52 +180,74 @@ inline bool VoxelOctreeNode::is_one_above_chunk(const JarVoxelTerrain &terrain)
     return _size == (LoD + terrain.get_min_chunk_size() + 1);
 }
 
-void VoxelOctreeNode::populateUniqueLoDValues(std::vector<int> &lodValues) const
+void VoxelOctreeNode::populateUniqueLoDValues(const JarVoxelTerrain &terrain, std::vector<int> &lodValues) const
 {
     if (std::find(lodValues.begin(), lodValues.end(), LoD) == lodValues.end())
     {
         lodValues.push_back(LoD);
     }
-    if (is_leaf())
+    const VoxelOctreeNode *children = get_children(terrain);
+    if (children == nullptr)
         return;
-    for (const auto &child : *_children)
+    for (int i = 0; i < 8; ++i)
     {
-        child->populateUniqueLoDValues(lodValues);
+        children[i].populateUniqueLoDValues(terrain, lodValues);
     }
 }
 
 bool VoxelOctreeNode::is_enqueued() const
 {
-    return _isEnqueued;
+    return has_flag(FLAG_ENQUEUED);
+}
+
+uint8_t VoxelOctreeNode::get_mesh_generation() const
+{
+    return _meshGeneration.load(std::memory_order_acquire);
+}
+
+bool VoxelOctreeNode::is_mesh_generation_current(uint8_t generation) const
+{
+    return get_mesh_generation() == generation;
 }
 
-void VoxelOctreeNode::finished_meshing_notify_parent_and_children() const
+// the pending mesh job gets dropped, by the worker if it did not finish yet
+void VoxelOctreeNode::cancel_meshing()
 {
-    if (_parent != nullptr)
+    if (!is_enqueued())
+        return;
+    _meshGeneration.fetch_add(1, std::memory_order_acq_rel);
+    set_flag(FLAG_ENQUEUED, false);
+}
+
+void VoxelOctreeNode::finished_meshing_notify_parent_and_children(JarVoxelTerrain &terrain) const
+{
+    if (VoxelOctreeNode *parent = get_parent(terrain))
     {
-        _parent->delete_chunk();
+        parent->delete_chunk(terrain);
     }
-    if (!is_leaf())
+    if (VoxelOctreeNode *children = get_children(terrain))
     {
-        for (auto &child : *_children)
+        for (int i = 0; i < 8; ++i)
         {
-            child->delete_chunk();
+            children[i].delete_chunk(terrain);
         }
     }
 }
 
-bool VoxelOctreeNode::is_parent_enqueued() const
+bool VoxelOctreeNode::is_parent_enqueued(const JarVoxelTerrain &terrain) const
 {
-    return _parent == nullptr ? false : _parent->is_enqueued();
+    const VoxelOctreeNode *parent = get_parent(terrain);
+    return parent == nullptr ? false : parent->is_enqueued();
 }
 
-bool VoxelOctreeNode::is_any_children_enqueued() const
+bool VoxelOctreeNode::is_any_children_enqueued(const JarVoxelTerrain &terrain) const
 {
-    if (is_leaf())
+    const VoxelOctreeNode *children = get_children(terrain);
+    if (children == nullptr)
         return false;
-    for (const auto &child : *_children)
+    for (int i = 0; i < 8; ++i)
     {
-        if (child->is_enqueued())
+        if (children[i].is_enqueued())
             return true;
     }
     return false;
@@ -190,7 +258,18 @@ inline bool VoxelOctreeNode::should_delete_chunk(const JarVoxelTerrain &terrain)
     return false;
 }
 
-inline uint16_t VoxelOctreeNode::compute_boundaries(const JarVoxelTerrain &terrain) const
+uint16_t VoxelOctreeNode::compute_boundaries(const JarVoxelTerrain &terrain) const
+{
+    return compute_boundaries(terrain, get_center(terrain.get_octree_scale()));
+}
+
+uint16_t VoxelOctreeNode::compute_boundaries(const JarVoxelTerrain &terrain, const glm::vec3 &center) const
+{
+    return compute_boundaries(terrain, center, *terrain.get_observer_state());
+}
+
+uint16_t VoxelOctreeNode::compute_boundaries(const JarVoxelTerrain &terrain, const glm::vec3 &center,
+                                             const LodObserverState &observers) const
 {
     static const std::vector<glm::vec3> offsets = {glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0),
         glm::vec3(0, 1, 0), glm::vec3(0, -1, 0),
@@ -200,58 +279,179 @@ inline uint16_t VoxelOctreeNode::compute_boundaries(const JarVoxelTerrain &terra
     const float el = edge_length(terrain.get_octree_scale());
     for (size_t i = 0; i < offsets.size(); ++i)
     {
-        int l = terrain.lod_at(_center + el * offsets[i]);
+        int l = terrain.lod_at(observers, center + el * offsets[i]);
         boundaries |= (LoD < l ? 1 : 0) << i;       // high to low
         boundaries |= (LoD > l ? 1 : 0) << (i + 8); // low to high
     }
     return boundaries;
 }
 
-void VoxelOctreeNode::build(JarVoxelTerrain &terrain)
+void VoxelOctreeNode::build(JarVoxelTerrain &terrain, const glm::vec3 &center, int forkDepth, bool incremental)
 {
-    LoD = terrain.desired_lod(*this);
+    // the lod and the stitching boundaries of a node are sampled at its center and the centers of its neighbours,
+    // half an edge past its faces. Nodes below it sample closer to it.
+    const float scale = terrain.get_octree_scale();
+    if (incremental && has_flag(FLAG_BUILT) &&
+        !terrain.is_lod_changed(get_bounds(scale, center).expanded(edge_length(scale))))
+        return;
+    // a subtree the last build did not reach is out of date, it is built in full
+    incremental = incremental && has_flag(FLAG_BUILT);
+    set_flag(FLAG_BUILT, true);
+    terrain.count_build_visit();
 
-    if (LoD < 0)
+    if (build_node(terrain, center, forkDepth, incremental))
         return;
+    if (VoxelOctreeNode *children = get_children(terrain))
+        for (int i = 0; i < 8; ++i)
+            children[i].set_flag(FLAG_BUILT, false);
+}
+
+bool VoxelOctreeNode::build_node(JarVoxelTerrain &terrain, const glm::vec3 &center, int forkDepth, bool incremental)
+{
+    LoD = terrain.desired_lod(*this, center);
+
+    // a mesh for a node that left the chunk level would be thrown away on arrival
+    if (!is_chunk(terrain))
+        cancel_meshing();
+
+    if (LoD < 0)
+        return false;
+
+    if (terrain.get_brick_mode())
+    {
+        if (is_chunk(terrain))
+        {
+            build_brick(terrain, center);
+            return false;
+        }
+        release_brick(terrain);
+        // a former chunk has no subtree yet, it is set if it got edited while it was one
+        if (is_set() && is_leaf() && _size > LoD && has_surface(terrain, get_value(terrain)))
+            subdivide(terrain);
+    }
 
-    if (!_isSet)
+    if (!is_set())
     {
-        float value = terrain.get_sdf()->distance(_center);
-        set_value(value);
+        float value = sample_value(terrain, center);
+        set_value(terrain, value);
         if (has_surface(terrain, value) && (_size > LoD))
         {
-            subdivide(terrain.get_octree_scale());
-            _isSet = true;
+            subdivide(terrain);
+            sample_children(terrain, center);
+            set_flag(FLAG_SET, true);
         }
         // if we don't subdivide further, we mark it as a fully realized subtree
         if (is_leaf() && (_size > LoD || _size == min_size()))
         { //
-            _isSet = true;
-            mark_materialized();
-            return;
+            set_flag(FLAG_SET, true);
+            mark_materialized(terrain);
+            return false;
         }
     }
  
     if (is_chunk(terrain) && !is_leaf() &&
-        (_chunk == nullptr || (_chunk->get_boundaries() != compute_boundaries(terrain))))
-        queue_update(terrain);
+        (!has_chunk() || (get_chunk(terrain)->get_boundaries() != compute_boundaries(terrain, center))))
+        queue_update(terrain, center);
 
-    if (!is_leaf() && !(is_chunk(terrain) && (_chunk != nullptr)) && // || is_enqueued()
-        (!is_materialized() || is_above_min_chunk(terrain)))
-        for (auto &child : *_children)
-            child->build(terrain);
+    const bool descend = !is_leaf() && !(is_chunk(terrain) && has_chunk()) && // || is_enqueued()
+                         (!is_materialized() || is_above_min_chunk(terrain));
+    if (descend)
+        build_children(terrain, center, forkDepth, incremental);
 
     if (!is_chunk(terrain))
-        delete_chunk();
+        delete_chunk(terrain);
+    return descend;
+}
+
+void VoxelOctreeNode::build_children(JarVoxelTerrain &terrain, const glm::vec3 &center, int forkDepth,
+                                     bool incremental)
+{
+    const float scale = terrain.get_octree_scale();
+    VoxelOctreeNode *children = get_children(terrain);
+    if (forkDepth <= 0)
+    {
+        for (int i = 0; i < 8; ++i)
+            children[i].build(terrain, child_center(center, i, scale), 0, incremental);
+        return;
+    }
+
+    // siblings only share their parent, this thread takes the first child and helps out with the rest while waiting
+    JobSystem &jobs = terrain.get_job_system();
+    JobSystem::Counter counter{0};
+    for (int i = 1; i < 8; ++i)
+    {
+        VoxelOctreeNode *child = &children[i];
+        const glm::vec3 childCenter = child_center(center, i, scale);
+        jobs.submit([child, childCenter, &terrain, forkDepth, incremental]() {
+            child->build(terrain, childCenter, forkDepth - 1, incremental);
+        }, counter, JobSystem::PRIORITY_URGENT);
+    }
+    children[0].build(terrain, child_center(center, 0, scale), forkDepth - 1, incremental);
+    jobs.wait(counter);
+}
+
+float VoxelOctreeNode::sample_value(const JarVoxelTerrain &terrain, const glm::vec3 &center) const
+{
+    if (has_flag(FLAG_SAMPLED))
+        return decode_value();
+    // a node whose neighbourhood provably has no surface would not be subdivided by its sample either
+    float value;
+    if (terrain.cull_sdf(get_bounds(terrain.get_octree_scale(), center), surface_distance(terrain), value))
+        return value;
+    return terrain.sample_sdf(center);
+}
+
+void VoxelOctreeNode::sample_children(const JarVoxelTerrain &terrain, const glm::vec3 &center)
+{
+    VoxelOctreeNode *children = get_children(terrain);
+    if (children == nullptr)
+        return;
+    const float scale = terrain.get_octree_scale();
+    const glm::vec3 halfEdge(edge_length(scale) * 0.25f);
+    const float margin = children[0].surface_distance(terrain);
+
+    // children that can't contain the surface get their estimate, the others are sampled in one batch
+    int sampled[8];
+    glm::vec3 positions[8];
+    float values[8];
+    int count = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        const glm::vec3 childCenter = child_center(center, i, scale);
+        float value;
+        if (terrain.cull_sdf(Bounds(childCenter - halfEdge, childCenter + halfEdge), margin, value))
+        {
+            children[i]._value = children[i].encode_value(value);
+            children[i].set_flag(FLAG_SAMPLED, true);
+            continue;
+        }
+        sampled[count] = i;
+        positions[count++] = childCenter;
+    }
+    if (count > 0)
+        terrain.sample_sdf_batch(positions, values, count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        VoxelOctreeNode &child = children[sampled[i]];
+        child._value = child.encode_value(values[i]);
+        child.set_flag(FLAG_SAMPLED, true);
+    }
 }
 
 bool VoxelOctreeNode::has_surface(const JarVoxelTerrain &terrain, const float value)
+{
+    return std::abs(value) < surface_distance(terrain);
+}
+
+float VoxelOctreeNode::surface_distance(const JarVoxelTerrain &terrain) const
 {
     //(3*(1/2)^3)^(1/3) = 1.44224957 for d instead of r
-    return std::abs(value) < (1 << _size) * terrain.get_octree_scale() * 1.44224957f * 1.75f; 
+    return (1 << _size) * terrain.get_octree_scale() * 1.44224957f * 1.75f;
 }
 
-void VoxelOctreeNode::modify_sdf_in_bounds(JarVoxelTerrain &terrain, const ModifySettings &settings)
+void VoxelOctreeNode::modify_sdf_in_bounds(JarVoxelTerrain &terrain, const glm::vec3 &center,
+                                           const ModifySettings &settings)
 {
     if (settings.sdf.is_null())
     {
@@ -259,86 +459,217 @@ void VoxelOctreeNode::modify_sdf_in_bounds(JarVoxelTerrain &terrain, const Modif
         return;
     }
 
-    auto bounds = get_bounds(terrain.get_octree_scale());
-    if (!settings.bounds.intersects(bounds))
+    const bool brickMode = terrain.get_brick_mode();
+    const float scale = terrain.get_octree_scale();
+    auto bounds = get_bounds(scale, center);
+    // the apron of a brick reaches one leaf past its chunk, leaves below this node are at most this large
+    const Bounds reach =
+        brickMode ? bounds.expanded(edge_length(terrain.get_octree_scale()) / terrain.get_chunk_size()) : bounds;
+    if (!settings.bounds.intersects(reach))
         return;
 
-    LoD = terrain.desired_lod(*this);
-    if (!_isSet)
-        set_value(terrain.get_sdf()->distance(_center));
+    LoD = terrain.desired_lod(*this, center);
+    if (brickMode && is_chunk(terrain))
+    {
+        modify_brick(terrain, center, settings);
+        return;
+    }
+
+    // in brick mode the edit is already recorded, sampling replays it
+    const bool replayed = !is_set() && brickMode;
+    if (!is_set())
+        set_value(terrain, terrain.sample_sdf(center));
 
-    float old_value = get_value();
-    float sdf_value = settings.sdf->distance(_center - settings.position);
-    float new_value = SDF::apply_operation(settings.operation, old_value, sdf_value, terrain.get_octree_scale());
+    float old_value = get_value(terrain);
+    float sdf_value = settings.sdf->distance(center - settings.position);
+    float new_value =
+        replayed ? old_value
+                 : SDF::apply_operation(settings.operation, old_value, sdf_value, terrain.get_octree_scale());
 
     // ensure the node has children if it contains a surface
     if (has_surface(terrain, new_value)) // || has_surface(terrain, sdf_value)
-        subdivide(terrain.get_octree_scale());
-    else
-        if(settings.bounds.encloses(bounds))
-            prune_children();
+        subdivide(terrain);
+    else if (settings.bounds.encloses(bounds))
+    {
+        prune_children(terrain);
+    }
 
-    set_value(new_value);
-    _isSet = true;
+    set_value(terrain, new_value);
+    set_flag(FLAG_SET, true);
     if (std::abs(new_value - old_value) > 0.01f)
-        NodeColor = glm::vec4(1, 0, 0, 1);
+        _colorIndex = COLOR_EDITED;
 
-    if (is_leaf())
-        mark_materialized();
-    else // recurse down the tree
-        for (auto &child : *_children)
-            child->modify_sdf_in_bounds(terrain, settings);
+    if (VoxelOctreeNode *children = get_children(terrain)) // recurse down the tree
+        for (int i = 0; i < 8; ++i)
+            children[i].modify_sdf_in_bounds(terrain, child_center(center, i, scale), settings);
+    else
+        mark_materialized(terrain);
 
     if (is_chunk(terrain))
-        queue_update(terrain);
-    else if (_chunk != nullptr)
-        delete_chunk();
+        queue_update(terrain, center, true);
+    else if (has_chunk())
+        delete_chunk(terrain);
+}
+
+void VoxelOctreeNode::build_brick(JarVoxelTerrain &terrain, const glm::vec3 &center)
+{
+    // chunk level nodes are not marked as set in brick mode, so they get subdivided once they are above chunk level
+    if (!is_set())
+        set_value(terrain, sample_value(terrain, center));
+
+    if (!has_surface(terrain, get_value(terrain)))
+    {
+        release_brick(terrain);
+        return;
+    }
+
+    if (!has_flag(FLAG_BRICK))
+        create_brick(terrain, center);
+
+    if (!has_chunk() || get_chunk(terrain)->get_boundaries() != compute_boundaries(terrain, center))
+        queue_update(terrain, center);
+}
+
+void VoxelOctreeNode::modify_brick(JarVoxelTerrain &terrain, const glm::vec3 &center, const ModifySettings &settings)
+{
+    const float scale = terrain.get_octree_scale();
+    // the recorded edits include this one
+    set_value(terrain, terrain.sample_sdf(center));
+
+    if (has_flag(FLAG_BRICK))
+    {
+        // copy on write, a mesher may still be reading the current brick
+        if (auto brick = terrain.get_octree().get_brick(this))
+        {
+            auto edited = std::make_shared<VoxelBrick>(*brick);
+            edited->apply(settings, scale);
+            terrain.get_octree().set_brick(this, std::move(edited));
+        }
+    }
+    else if (has_surface(terrain, get_value(terrain)))
+    {
+        create_brick(terrain, center);
+    }
+    else
+    {
+        return;
+    }
+    queue_update(terrain, center, true);
+}
+
+void VoxelOctreeNode::create_brick(JarVoxelTerrain &terrain, const glm::vec3 &center)
+{
+    const float scale = terrain.get_octree_scale();
+    const Bounds bounds = get_bounds(scale, center);
+    auto brick = std::make_shared<VoxelBrick>(bounds, terrain.get_chunk_size());
+
+    std::vector<ModifySettings> edits;
+    terrain.get_brick_edits_in_bounds(bounds.expanded(edge_length(scale) / terrain.get_chunk_size()), edits);
+    brick->fill(*terrain.get_sdf().ptr(), edits, scale);
+
+    // the brick replaces whatever was built below this node before
+    release_bricks_below(terrain);
+    terrain.get_octree().set_brick(this, std::move(brick));
+    set_flag(FLAG_BRICK, true);
+}
+
+void VoxelOctreeNode::release_brick(JarVoxelTerrain &terrain)
+{
+    if (!has_flag(FLAG_BRICK))
+        return;
+    terrain.get_octree().release_brick(this);
+    set_flag(FLAG_BRICK, false);
+}
+
+void VoxelOctreeNode::release_bricks_below(JarVoxelTerrain &terrain)
+{
+    VoxelOctreeNode *children = get_children(terrain);
+    if (children == nullptr)
+        return;
+    for (int i = 0; i < 8; ++i)
+    {
+        children[i].release_brick(terrain);
+        children[i].release_bricks_below(terrain);
+    }
 }
 
 void VoxelOctreeNode::update_chunk(JarVoxelTerrain &terrain, ChunkMeshData *chunkMeshData)
 {
-    _isEnqueued = false;
-    finished_meshing_notify_parent_and_children();
+    set_flag(FLAG_ENQUEUED, false);
+    finished_meshing_notify_parent_and_children(terrain);
     if (chunkMeshData == nullptr || !is_chunk(terrain))
     {
-        delete_chunk();
+        delete chunkMeshData;
+        delete_chunk(terrain);
         return;
     }
 
-    if (_chunk == nullptr)
+    VoxelChunk *chunk = get_chunk(terrain);
+    if (chunk == nullptr)
     {
-        _chunk = static_cast<JarVoxelChunk *>(terrain.get_chunk_scene()->instantiate());
-        terrain.add_child(_chunk);
+        chunk = terrain.get_chunk_backend().create_chunk();
+        terrain.get_octree().set_chunk(this, chunk);
+        set_flag(FLAG_CHUNK, true);
     }
 
-    _chunk->update_chunk(terrain, this, chunkMeshData);
+    chunk->update_chunk(terrain, this, chunkMeshData);
+}
+
+void VoxelOctreeNode::queue_update(JarVoxelTerrain &terrain, const glm::vec3 &center, bool invalidatePending)
+{
+    const bool wasEnqueued = (_flags.fetch_or(FLAG_ENQUEUED, std::memory_order_relaxed) & FLAG_ENQUEUED) != 0;
+    if (wasEnqueued && !invalidatePending)
+        return;
+    const uint8_t generation = static_cast<uint8_t>(_meshGeneration.fetch_add(1, std::memory_order_acq_rel) + 1);
+    // an edit invalidates the pending job, the player waits for its mesh
+    terrain.enqueue_chunk_update(*this, center, generation, invalidatePending);
 }
 
-void VoxelOctreeNode::queue_update(JarVoxelTerrain &terrain)
+void VoxelOctreeNode::delete_chunk(JarVoxelTerrain &terrain)
 {
-    if (_isEnqueued)
+    if (is_any_children_enqueued(terrain) || is_parent_enqueued(terrain))
         return;
-    _isEnqueued = true;
-    terrain.enqueue_chunk_update(*this);
+
+    release_chunk(terrain);
 }
 
-void VoxelOctreeNode::delete_chunk()
+void VoxelOctreeNode::release_chunk(JarVoxelTerrain &terrain)
 {
-    if (is_any_children_enqueued() || is_parent_enqueued())
+    if (!has_chunk())
         return;
+    set_flag(FLAG_CHUNK, false);
+    // JarVoxelTerrain::RemoveChunk(_chunk);
+    if (VoxelChunk *chunk = terrain.get_octree().take_chunk(this))
+        chunk->release();
+}
 
-    if (_chunk != nullptr)
+// The blocks are not reused right away: a job or collider queued for one of the nodes would find a new node there,
+// whose mesh generation starts over and may match the stale stamp. Retired nodes keep their bumped generation until
+// the terrain releases them.
+void VoxelOctreeNode::prune_children(JarVoxelTerrain &terrain)
+{
+    VoxelOctreeNode *children = get_children(terrain);
+    if (children == nullptr)
+        return;
+    for (int i = 0; i < 8; ++i)
     {
-        // JarVoxelTerrain::RemoveChunk(_chunk);
-        _chunk->queue_free();
+        VoxelOctreeNode &child = children[i];
+        child.cancel_meshing();
+        child.release_chunk(terrain);
+        child.release_brick(terrain);
+        child.prune_children(terrain);
     }
-    _chunk = nullptr;
+    // a leaf from here on, nobody looks for the children once they are out of the index
+    set_flag(FLAG_SUBDIVIDED, false);
+    terrain.get_octree().retire_children(_key);
 }
 
-void VoxelOctreeNode::get_voxel_leaves_in_bounds(const JarVoxelTerrain &terrain, const Bounds &bounds,
-                                                 std::vector<VoxelOctreeNode *> &result)
+void VoxelOctreeNode::get_voxel_leaves_in_bounds(const JarVoxelTerrain &terrain, const glm::vec3 &center,
+                                                 const Bounds &bounds, std::vector<VoxelOctreeNode *> &result,
+                                                 std::vector<glm::vec3> &centers)
 {
-    if (!get_bounds(terrain.get_octree_scale()).intersects(bounds))
+    const float scale = terrain.get_octree_scale();
+    if (!get_bounds(scale, center).intersects(bounds))
         return;
 
     // LoD = terrain.get_lod()->desired_lod(*this);
@@ -346,55 +677,72 @@ void VoxelOctreeNode::get_voxel_leaves_in_bounds(const JarVoxelTerrain &terrain,
     if (_size == LoD || (is_leaf() && _size >= LoD))
     {
         result.push_back(this);
+        centers.push_back(center);
         return;
     }
 
+    VoxelOctreeNode *children = get_children(terrain);
+    if (children == nullptr)
+        return;
     if (is_chunk(terrain))
-        for (auto &child : *_children) // use all the same LoD from here on out
-            child->get_voxel_leaves_in_bounds(terrain, bounds, LoD, result);
+        for (int i = 0; i < 8; ++i) // use all the same LoD from here on out
+            children[i].get_voxel_leaves_in_bounds(terrain, child_center(center, i, scale), bounds, LoD, result,
+                                                   centers);
     else
-        for (auto &child : *_children)
-            child->get_voxel_leaves_in_bounds(terrain, bounds, result);
+        for (int i = 0; i < 8; ++i)
+            children[i].get_voxel_leaves_in_bounds(terrain, child_center(center, i, scale), bounds, result, centers);
 }
 
-void VoxelOctreeNode::get_voxel_leaves_in_bounds(const JarVoxelTerrain &terrain, const Bounds &bounds, const int LOD,
-                                                 std::vector<VoxelOctreeNode *> &result)
+void VoxelOctreeNode::get_voxel_leaves_in_bounds(const JarVoxelTerrain &terrain, const glm::vec3 &center,
+                                                 const Bounds &bounds, const int LOD,
+                                                 std::vector<VoxelOctreeNode *> &result,
+                                                 std::vector<glm::vec3> &centers)
 {
-    if (!get_bounds(terrain.get_octree_scale()).intersects(bounds) || (is_leaf() && _size > LOD))
+    const float scale = terrain.get_octree_scale();
+    if (!get_bounds(scale, center).intersects(bounds) || (is_leaf() && _size > LOD))
         return;
 
     if (_size == LOD)
     {
         result.push_back(this);
+        centers.push_back(center);
         return;
     }
 
-    for (auto &child : *_children)
-        child->get_voxel_leaves_in_bounds(terrain, bounds, LOD, result);
+    VoxelOctreeNode *children = get_children(terrain);
+    if (children == nullptr)
+        return;
+    for (int i = 0; i < 8; ++i)
+        children[i].get_voxel_leaves_in_bounds(terrain, child_center(center, i, scale), bounds, LOD, result, centers);
 }
 
 void VoxelOctreeNode::get_voxel_leaves_in_bounds_excluding_bounds(const JarVoxelTerrain &terrain,
+                                                                  const glm::vec3 &center,
                                                                   const Bounds &acceptance_bounds,
                                                                   const Bounds &rejection_bounds, const int LOD,
-                                                                  std::vector<VoxelOctreeNode *> &result)
+                                                                  std::vector<VoxelOctreeNode *> &result,
+                                                                  std::vector<glm::vec3> &centers)
 {
-    auto bounds = get_bounds(terrain.get_octree_scale());
+    const float scale = terrain.get_octree_scale();
+    auto bounds = get_bounds(scale, center);
     if (!acceptance_bounds.intersects(bounds) || (is_leaf() && _size > LOD))
         return;
 
     if (_size == LOD)
     {
         if (!rejection_bounds.intersects(bounds))
+        {
             result.push_back(this);
+            centers.push_back(center);
+        }
         return;
     }
 
-    for (auto &child : *_children)
-        child->get_voxel_leaves_in_bounds_excluding_bounds(terrain, acceptance_bounds, rejection_bounds, LOD, result);
-}
-
-std::unique_ptr<VoxelOctreeNode> VoxelOctreeNode::create_child_node(const glm::vec3 &center, int size)
-{
-    return std::make_unique<VoxelOctreeNode>(this, center, size);
+    VoxelOctreeNode *children = get_children(terrain);
+    if (children == nullptr)
+        return;
+    for (int i = 0; i < 8; ++i)
+        children[i].get_voxel_leaves_in_bounds_excluding_bounds(terrain, child_center(center, i, scale),
+                                                                acceptance_bounds, rejection_bounds, LOD, result,
+                                                                centers);
 }
-
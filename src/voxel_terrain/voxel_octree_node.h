@@ -2,87 +2,189 @@
 #define VOXEL_OCTREE_NODE_H
 
 #include "bounds.h"
+#include "chunk_backend.h"
 #include "modify_settings.h"
 #include "octree_node.h"
-#include "voxel_chunk.h"
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <memory>
 #include <vector>
 
 class JarVoxelTerrain;
+struct LodObserverState;
 
 class VoxelOctreeNode : public OctreeNode<VoxelOctreeNode>
 {
-  private:
-    float _value = 0;
-    glm::vec4 NodeColor{0, 0, 0, 0};
-
-    bool _isSet = false;
-    bool _isDirty = false;
-    bool _isEnqueued = false;
-    uint8_t _isMaterialized;
-
-    JarVoxelChunk *_chunk = nullptr;
+  public:
+    // edited nodes are tinted, other entries can be used for materials later on.
+    enum ColorIndex : uint8_t
+    {
+        COLOR_NONE = 0,
+        COLOR_EDITED = 1,
+        COLOR_COUNT
+    };
+    static const glm::vec4 ColorPalette[COLOR_COUNT];
 
-    int LoD = 0;
+  private:
+    // Distances are stored as 16 bit fixed point relative to the edge length of the node in voxels and saturate at
+    // ValueRange edge lengths, far beyond the distance at which a node is considered to contain the surface.
+    static constexpr float ValueRange = 64.0f;
+    static constexpr float ValueSteps = 32767.0f;
+
+    enum Flags : uint8_t
+    {
+        FLAG_SET = 1 << 0,
+        FLAG_DIRTY = 1 << 1,
+        FLAG_BRICK = 1 << 2, // owns a brick in the octree, brick mode only
+        FLAG_SAMPLED = 1 << 3, // not set yet, but the value already is the sdf at the center
+        FLAG_ENQUEUED = 1 << 4, // waiting for a mesh
+        FLAG_BUILT = 1 << 5, // reached by the last build, its subtree is up to date for that camera
+        FLAG_SUBDIVIDED = 1 << 6, // has children in the index of the octree
+        FLAG_CHUNK = 1 << 7, // has a chunk in the octree
+    };
+
+    // the small members come first so they fill the tail padding of the base class.
+    uint8_t _colorIndex = COLOR_NONE;
+    int16_t _value = 0;
+    int8_t LoD = 0;
+    uint8_t _isMaterialized = 0;
+    // atomic, sibling subtrees are built in parallel and all mark their shared parent dirty
+    std::atomic<uint8_t> _flags{0};
+    // stamped on every mesh job, a job whose stamp is no longer current is dropped. Wraps around, which is fine for
+    // telling the latest job apart from the ones it replaced.
+    std::atomic<uint8_t> _meshGeneration{0};
+
+    inline bool has_flag(Flags flag) const
+    {
+        return (_flags.load(std::memory_order_relaxed) & flag) != 0;
+    }
+    inline void set_flag(Flags flag, bool value)
+    {
+        if (value)
+            _flags.fetch_or(flag, std::memory_order_relaxed);
+        else
+            _flags.fetch_and(static_cast<uint8_t>(~flag), std::memory_order_relaxed);
+    }
+    inline bool is_set() const
+    {
+        return has_flag(FLAG_SET);
+    }
+    inline float decode_value() const
+    {
+        return _value * ((1 << _size) * ValueRange / ValueSteps);
+    }
+    int16_t encode_value(float value) const;
+
+    // the block of the eight children from the index of the octree, nullptr for a leaf
+    VoxelOctreeNode *get_children(const JarVoxelTerrain &terrain) const;
+    VoxelOctreeNode *get_parent(const JarVoxelTerrain &terrain) const;
+    void subdivide(JarVoxelTerrain &terrain);
 
     bool is_dirty() const;
-    void set_dirty(bool value);
-    void set_value(float value);
+    void set_dirty(const JarVoxelTerrain &terrain, bool value);
+    void set_value(const JarVoxelTerrain &terrain, float value);
 
     // idea to not explore the whole tree, but only the children that are not materialized
-    void mark_materialized();
+    void mark_materialized(const JarVoxelTerrain &terrain);
     inline bool is_materialized();
 
     inline bool is_one_above_chunk(const JarVoxelTerrain &terrain) const;
-    void populateUniqueLoDValues(std::vector<int> &lodValues) const;
+    void populateUniqueLoDValues(const JarVoxelTerrain &terrain, std::vector<int> &lodValues) const;
+    void cancel_meshing();
+    // unlike delete_chunk, also when a parent or child is about to be meshed
+    void release_chunk(JarVoxelTerrain &terrain);
+    // cancels the mesh jobs and releases the chunks and bricks of the subtree, then retires its blocks
+    void prune_children(JarVoxelTerrain &terrain);
 
     inline bool should_delete_chunk(const JarVoxelTerrain &terrain) const;
 
+    // returns false if the children were left alone, they then no longer count as built
+    bool build_node(JarVoxelTerrain &terrain, const glm::vec3 &center, int forkDepth, bool incremental);
+    void build_children(JarVoxelTerrain &terrain, const glm::vec3 &center, int forkDepth, bool incremental);
+    // the sdf at the center, children of a subdivided node got it in one batch with their siblings
+    float sample_value(const JarVoxelTerrain &terrain, const glm::vec3 &center) const;
+    void sample_children(const JarVoxelTerrain &terrain, const glm::vec3 &center);
+
+    // brick mode
+    void build_brick(JarVoxelTerrain &terrain, const glm::vec3 &center);
+    void modify_brick(JarVoxelTerrain &terrain, const glm::vec3 &center, const ModifySettings &settings);
+    void create_brick(JarVoxelTerrain &terrain, const glm::vec3 &center);
+    void release_brick(JarVoxelTerrain &terrain);
+    void release_bricks_below(JarVoxelTerrain &terrain);
+
   public:
+    // the root
     VoxelOctreeNode(int size);
-    VoxelOctreeNode(VoxelOctreeNode *parent, const glm::vec3 center, int size);
+    // a child, it starts out with the values of its parent
+    VoxelOctreeNode(uint64_t key, int size, const VoxelOctreeNode &parent);
+
+    inline bool is_leaf() const
+    {
+        return !has_flag(FLAG_SUBDIVIDED);
+    }
 
     int priority() const;
 
     uint16_t compute_boundaries(const JarVoxelTerrain &terrain) const;
-
-    JarVoxelChunk *get_chunk() const;
+    uint16_t compute_boundaries(const JarVoxelTerrain &terrain, const glm::vec3 &center) const;
+    // against the observers a mesh job was submitted with, not the current ones
+    uint16_t compute_boundaries(const JarVoxelTerrain &terrain, const glm::vec3 &center,
+                                const LodObserverState &observers) const;
+
+    inline bool has_chunk() const
+    {
+        return has_flag(FLAG_CHUNK);
+    }
+    VoxelChunk *get_chunk(const JarVoxelTerrain &terrain) const;
     bool is_chunk(const JarVoxelTerrain &terrain) const;
     inline bool is_above_chunk(const JarVoxelTerrain &terrain) const;
     inline bool is_above_min_chunk(const JarVoxelTerrain &terrain) const;
     bool is_enqueued() const;
-    void finished_meshing_notify_parent_and_children() const;
-    bool is_parent_enqueued() const;
-    bool is_any_children_enqueued() const;
-
-    void build(JarVoxelTerrain &terrain);
-
+    uint8_t get_mesh_generation() const;
+    bool is_mesh_generation_current(uint8_t generation) const;
+    void finished_meshing_notify_parent_and_children(JarVoxelTerrain &terrain) const;
+    bool is_parent_enqueued(const JarVoxelTerrain &terrain) const;
+    bool is_any_children_enqueued(const JarVoxelTerrain &terrain) const;
+
+    // Subtrees down to forkDepth levels below this node are built as separate jobs. An incremental build skips the
+    // subtrees it built before that no changed lod region of the terrain reaches. The traversals take the center of
+    // the node, see get_center.
+    void build(JarVoxelTerrain &terrain, const glm::vec3 &center, int forkDepth = 0, bool incremental = false);
+
+    inline float surface_distance(const JarVoxelTerrain &terrain) const;
     inline bool has_surface(const JarVoxelTerrain &terrain, const float value);
-    void queue_update(JarVoxelTerrain &terrain);
-    void modify_sdf_in_bounds(JarVoxelTerrain &terrain, const ModifySettings &settings);
+    // an edit replaces a pending mesh job, its result would miss the edit
+    void queue_update(JarVoxelTerrain &terrain, const glm::vec3 &center, bool invalidatePending = false);
+    void modify_sdf_in_bounds(JarVoxelTerrain &terrain, const glm::vec3 &center, const ModifySettings &settings);
     void update_chunk(JarVoxelTerrain &terrain, ChunkMeshData *chunkMeshData);
 
-    void delete_chunk();
-    void get_voxel_leaves_in_bounds(const JarVoxelTerrain &terrain, const Bounds &Bounds,
-                                    std::vector<VoxelOctreeNode *> &result);
-    void get_voxel_leaves_in_bounds(const JarVoxelTerrain &terrain, const Bounds &Bounds, const int LOD,
-                                    std::vector<VoxelOctreeNode *> &result);
-
-    void get_voxel_leaves_in_bounds_excluding_bounds(const JarVoxelTerrain &terrain, const Bounds &including_bounds,
-                                                     const Bounds &excluding_bounds, const int LOD,
-                                                     std::vector<VoxelOctreeNode *> &result);
-
-    float get_value();
+    void delete_chunk(JarVoxelTerrain &terrain);
+    // the leaves go to result and their centers, which the descent has at hand anyway, to centers
+    void get_voxel_leaves_in_bounds(const JarVoxelTerrain &terrain, const glm::vec3 &center, const Bounds &Bounds,
+                                    std::vector<VoxelOctreeNode *> &result, std::vector<glm::vec3> &centers);
+    void get_voxel_leaves_in_bounds(const JarVoxelTerrain &terrain, const glm::vec3 &center, const Bounds &Bounds,
+                                    const int LOD, std::vector<VoxelOctreeNode *> &result,
+                                    std::vector<glm::vec3> &centers);
+
+    void get_voxel_leaves_in_bounds_excluding_bounds(const JarVoxelTerrain &terrain, const glm::vec3 &center,
+                                                     const Bounds &including_bounds, const Bounds &excluding_bounds,
+                                                     const int LOD, std::vector<VoxelOctreeNode *> &result,
+                                                     std::vector<glm::vec3> &centers);
+
+    // a node whose children changed averages them first
+    float get_value(const JarVoxelTerrain &terrain);
     int get_lod() const;
     glm::vec4 get_color() const;
+    uint8_t get_color_index() const;
 
     // private:
-
-  protected:
-    virtual std::unique_ptr<VoxelOctreeNode> create_child_node(const glm::vec3 &center, int size) override;
 };
 
+// 16 bytes, the key and then one byte for each small member. MSVC does not reuse the tail padding of the base class
+// and ends up at 24.
+static_assert(sizeof(VoxelOctreeNode) <= 24, "VoxelOctreeNode grew, check the member layout");
+
 #endif // VOXEL_OCTREE_NODE_H
@@ -1,6 +1,9 @@
 #include "voxel_terrain.h"
+#include "job_benchmark.h"
+#include "meshing_benchmark.h"
 #include "modify_settings.h"
 #include "plane_sdf.h"
+#include "server_chunk_backend.h"
 #include "sphere_sdf.h"
 
 void JarVoxelTerrain::_bind_methods()
@@ -10,6 +13,10 @@ void JarVoxelTerrain::_bind_methods()
     ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "player_node", PROPERTY_HINT_NODE_TYPE, "Node3D"), "set_player_node",
                  "get_player_node");
 
+    ClassDB::bind_method(D_METHOD("add_observer", "observer"), &JarVoxelTerrain::add_observer);
+    ClassDB::bind_method(D_METHOD("remove_observer", "observer"), &JarVoxelTerrain::remove_observer);
+    ClassDB::bind_method(D_METHOD("get_observers"), &JarVoxelTerrain::get_observers);
+
     ClassDB::bind_method(D_METHOD("get_world_node"), &JarVoxelTerrain::get_world_node);
     ClassDB::bind_method(D_METHOD("set_world_node", "world_node"), &JarVoxelTerrain::set_world_node);
     ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "world_node", PROPERTY_HINT_NODE_TYPE, "JarWorld"), "set_world_node",
@@ -55,6 +62,57 @@ void JarVoxelTerrain::_bind_methods()
     ADD_PROPERTY(PropertyInfo(Variant::INT, "performance_updated_colliders_per_second"),
                  "set_updated_colliders_per_second", "get_updated_colliders_per_second");
 
+    ClassDB::bind_method(D_METHOD("get_brick_mode"), &JarVoxelTerrain::get_brick_mode);
+    ClassDB::bind_method(D_METHOD("set_brick_mode", "value"), &JarVoxelTerrain::set_brick_mode);
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "performance_brick_mode"), "set_brick_mode", "get_brick_mode");
+
+    ClassDB::bind_method(D_METHOD("get_worker_threads"), &JarVoxelTerrain::get_worker_threads);
+    ClassDB::bind_method(D_METHOD("set_worker_threads", "value"), &JarVoxelTerrain::set_worker_threads);
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "performance_worker_threads"), "set_worker_threads",
+                 "get_worker_threads");
+
+    ClassDB::bind_method(D_METHOD("get_build_fork_depth"), &JarVoxelTerrain::get_build_fork_depth);
+    ClassDB::bind_method(D_METHOD("set_build_fork_depth", "value"), &JarVoxelTerrain::set_build_fork_depth);
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "performance_build_fork_depth"), "set_build_fork_depth",
+                 "get_build_fork_depth");
+
+    ClassDB::bind_method(D_METHOD("get_mesh_apply_budget_usec"), &JarVoxelTerrain::get_mesh_apply_budget_usec);
+    ClassDB::bind_method(D_METHOD("set_mesh_apply_budget_usec", "value"),
+                         &JarVoxelTerrain::set_mesh_apply_budget_usec);
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "performance_mesh_apply_budget_usec"), "set_mesh_apply_budget_usec",
+                 "get_mesh_apply_budget_usec");
+
+    ClassDB::bind_method(D_METHOD("get_target_frame_time_usec"), &JarVoxelTerrain::get_target_frame_time_usec);
+    ClassDB::bind_method(D_METHOD("set_target_frame_time_usec", "value"),
+                         &JarVoxelTerrain::set_target_frame_time_usec);
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "performance_target_frame_time_usec"), "set_target_frame_time_usec",
+                 "get_target_frame_time_usec");
+
+    ClassDB::bind_method(D_METHOD("is_collision_only"), &JarVoxelTerrain::is_collision_only);
+    ClassDB::bind_method(D_METHOD("set_collision_only", "value"), &JarVoxelTerrain::set_collision_only);
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "performance_collision_only"), "set_collision_only", "is_collision_only");
+
+    ClassDB::bind_method(D_METHOD("get_collider_lod_threshold"), &JarVoxelTerrain::get_collider_lod_threshold);
+    ClassDB::bind_method(D_METHOD("set_collider_lod_threshold", "value"),
+                         &JarVoxelTerrain::set_collider_lod_threshold);
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "performance_collider_lod_threshold"), "set_collider_lod_threshold",
+                 "get_collider_lod_threshold");
+
+    ClassDB::bind_method(D_METHOD("get_chunk_backend_type"), &JarVoxelTerrain::get_chunk_backend_type);
+    ClassDB::bind_method(D_METHOD("set_chunk_backend_type", "value"), &JarVoxelTerrain::set_chunk_backend_type);
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "performance_chunk_backend", PROPERTY_HINT_ENUM, "Scene,Server"),
+                 "set_chunk_backend_type", "get_chunk_backend_type");
+
+    ClassDB::bind_method(D_METHOD("get_chunk_pool_capacity"), &JarVoxelTerrain::get_chunk_pool_capacity);
+    ClassDB::bind_method(D_METHOD("set_chunk_pool_capacity", "value"), &JarVoxelTerrain::set_chunk_pool_capacity);
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "performance_chunk_pool_capacity"), "set_chunk_pool_capacity",
+                 "get_chunk_pool_capacity");
+
+    ClassDB::bind_method(D_METHOD("is_compress_vertices"), &JarVoxelTerrain::is_compress_vertices);
+    ClassDB::bind_method(D_METHOD("set_compress_vertices", "value"), &JarVoxelTerrain::set_compress_vertices);
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "performance_compress_vertices"), "set_compress_vertices",
+                 "is_compress_vertices");
+
     // -------------------------------------------------- LOD --------------------------------------------------
     ADD_GROUP("Level Of Detail", "lod_");
     ClassDB::bind_method(D_METHOD("get_lod_level_count"), &JarVoxelTerrain::get_lod_level_count);
@@ -77,6 +135,17 @@ void JarVoxelTerrain::_bind_methods()
     ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "lod_automatic_update_distance"), "set_lod_automatic_update_distance",
                  "get_lod_automatic_update_distance");
 
+    ClassDB::bind_method(D_METHOD("get_lod_incremental_update"), &JarVoxelTerrain::get_lod_incremental_update);
+    ClassDB::bind_method(D_METHOD("set_lod_incremental_update", "value"),
+                         &JarVoxelTerrain::set_lod_incremental_update);
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "lod_incremental_update"), "set_lod_incremental_update",
+                 "get_lod_incremental_update");
+
+    ClassDB::bind_method(D_METHOD("get_lod_prediction_time"), &JarVoxelTerrain::get_lod_prediction_time);
+    ClassDB::bind_method(D_METHOD("set_lod_prediction_time", "value"), &JarVoxelTerrain::set_lod_prediction_time);
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "lod_prediction_time"), "set_lod_prediction_time",
+                 "get_lod_prediction_time");
+
     //-------------------------------------------------- POPULATION --------------------------------------------------
     ADD_GROUP("Population", "population_");
     ClassDB::bind_method(D_METHOD("get_terrain_details"), &JarVoxelTerrain::get_terrain_details);
@@ -92,11 +161,21 @@ void JarVoxelTerrain::_bind_methods()
     BIND_ENUM_CONSTANT(SDF::SDF_OPERATION_SMOOTH_UNION);
     BIND_ENUM_CONSTANT(SDF::SDF_OPERATION_SMOOTH_SUBTRACTION);
     BIND_ENUM_CONSTANT(SDF::SDF_OPERATION_SMOOTH_INTERSECTION);
+
+    BIND_ENUM_CONSTANT(CHUNK_BACKEND_SCENE);
+    BIND_ENUM_CONSTANT(CHUNK_BACKEND_SERVER);
     ClassDB::bind_method(D_METHOD("modify", "sdf", "operation", "position", "radius"), &JarVoxelTerrain::modify);
     ClassDB::bind_method(D_METHOD("sphere_edit", "position", "radius", "union"), &JarVoxelTerrain::sphere_edit);
     ClassDB::bind_method(D_METHOD("spawn_debug_spheres_in_bounds", "position", "range"),
                          &JarVoxelTerrain::spawn_debug_spheres_in_bounds);
     ClassDB::bind_method(D_METHOD("force_update_lod"), &JarVoxelTerrain::force_update_lod);
+    ClassDB::bind_method(D_METHOD("get_statistics"), &JarVoxelTerrain::get_statistics);
+    ClassDB::bind_static_method("JarVoxelTerrain",
+                                D_METHOD("benchmark_job_system", "thread_count", "job_count", "work_per_job"),
+                                &JarVoxelTerrain::benchmark_job_system);
+    ClassDB::bind_method(D_METHOD("benchmark_meshing", "iterations", "compare_neighbours"),
+                         &JarVoxelTerrain::benchmark_meshing, DEFVAL(false));
+    ClassDB::bind_method(D_METHOD("is_building"), &JarVoxelTerrain::is_building);
 }
 
 JarVoxelTerrain::JarVoxelTerrain() : _octreeScale(1.0f), _size(14), _playerNode(nullptr)
@@ -125,10 +204,10 @@ void JarVoxelTerrain::sphere_edit(const Vector3 &position, const float radius, b
     sdf->set_radius(radius);
     auto edge = glm::vec3(radius + _octreeScale * 2.0f);
 
-    if (_isBuilding)
+    if (is_building() || !_voxelOctree.is_valid())
         return;
     ModifySettings settings = {sdf, Bounds(pos - edge, pos + edge), pos, operation};
-    _voxelRoot->modify_sdf_in_bounds(*this, settings);
+    apply_modify_settings(settings);
     //_populationRoot->remove_population(settings);
     //_modifySettingsQueue.push({sdf, Bounds(pos - edge, pos + edge), pos, operation});
 }
@@ -140,9 +219,10 @@ void JarVoxelTerrain::enqueue_chunk_collider(VoxelOctreeNode *node)
     _updateChunkCollidersQueue.push(node);
 }
 
-void JarVoxelTerrain::enqueue_chunk_update(VoxelOctreeNode &node)
+void JarVoxelTerrain::enqueue_chunk_update(VoxelOctreeNode &node, const glm::vec3 &center, uint8_t generation,
+                                           bool urgent)
 {
-    _meshComputeScheduler->enqueue(node);
+    _meshComputeScheduler->enqueue(node, center, generation, urgent);
 }
 
 Node3D *JarVoxelTerrain::get_player_node() const
@@ -155,6 +235,44 @@ void JarVoxelTerrain::set_player_node(Node3D *playerNode)
     _playerNode = playerNode;
 }
 
+void JarVoxelTerrain::add_observer(Node3D *observer)
+{
+    if (observer == nullptr)
+        return;
+    const ObjectID id = observer->get_instance_id();
+    if (std::find(_observers.begin(), _observers.end(), id) == _observers.end())
+        _observers.push_back(id);
+}
+
+void JarVoxelTerrain::remove_observer(Node3D *observer)
+{
+    if (observer == nullptr)
+        return;
+    _observers.erase(std::remove(_observers.begin(), _observers.end(), observer->get_instance_id()), _observers.end());
+}
+
+TypedArray<Node3D> JarVoxelTerrain::get_observers() const
+{
+    TypedArray<Node3D> observers;
+    for (const ObjectID &id : _observers)
+        if (Node3D *observer = Object::cast_to<Node3D>(ObjectDB::get_instance(id)))
+            observers.push_back(observer);
+    return observers;
+}
+
+void JarVoxelTerrain::get_observer_positions(std::vector<JarVoxelLoD::Observer> &observers) const
+{
+    const Vector3 origin = get_global_position();
+    for (const ObjectID &id : _observers)
+    {
+        Node3D *observer = Object::cast_to<Node3D>(ObjectDB::get_instance(id));
+        if (observer == nullptr || !observer->is_inside_tree())
+            continue;
+        const Vector3 p = observer->get_global_transform().origin - origin;
+        observers.push_back({static_cast<uint64_t>(id), glm::vec3(p.x, p.y, p.z)});
+    }
+}
+
 JarWorld *JarVoxelTerrain::get_world_node() const
 {
     return _worldNode;
@@ -167,7 +285,149 @@ void JarVoxelTerrain::set_world_node(JarWorld *worldNode)
 
 bool JarVoxelTerrain::is_building() const
 {
-    return _isBuilding;
+    return _buildCounter.load(std::memory_order_acquire) > 0;
+}
+
+JobSystem &JarVoxelTerrain::get_job_system()
+{
+    return *_jobSystem;
+}
+
+ChunkBackend &JarVoxelTerrain::get_chunk_backend()
+{
+    return *_chunkBackend;
+}
+
+const VoxelOctree &JarVoxelTerrain::get_octree() const
+{
+    return _voxelOctree;
+}
+
+VoxelOctree &JarVoxelTerrain::get_octree()
+{
+    return _voxelOctree;
+}
+
+Dictionary JarVoxelTerrain::get_statistics() const
+{
+    Dictionary stats;
+    stats["node_count"] = static_cast<int64_t>(_voxelOctree.get_node_count());
+    stats["node_size_bytes"] = static_cast<int64_t>(sizeof(VoxelOctreeNode));
+    stats["node_memory_bytes"] = static_cast<int64_t>(_voxelOctree.get_node_count() * sizeof(VoxelOctreeNode));
+    stats["node_pool_blocks_in_use"] = static_cast<int64_t>(_voxelOctree.get_allocator().get_blocks_in_use());
+    stats["node_pool_blocks_reserved"] = static_cast<int64_t>(_voxelOctree.get_allocator().get_blocks_reserved());
+    stats["node_pool_bytes_reserved"] = static_cast<int64_t>(_voxelOctree.get_bytes_reserved());
+    stats["node_pool_blocks_retired"] = static_cast<int64_t>(_voxelOctree.get_retired_block_count());
+    stats["node_index_bytes"] = static_cast<int64_t>(_voxelOctree.get_index_memory_usage());
+    stats["brick_count"] = static_cast<int64_t>(_voxelOctree.get_brick_count());
+    stats["brick_memory_bytes"] = static_cast<int64_t>(_voxelOctree.get_brick_memory_usage());
+    stats["build_time_ms"] = _lastBuildTimeUsec.load() / 1000.0;
+    stats["build_count"] = _buildCount;
+    stats["build_incremental"] = _lastBuildIncremental;
+    stats["build_nodes_visited"] = static_cast<int64_t>(_buildNodesVisited.load());
+    stats["lod_changed_regions"] = static_cast<int64_t>(_lodChangedRegions.size());
+    stats["observer_speed"] = glm::length(_voxelLod.get_observer_velocity());
+    stats["observer_count"] = static_cast<int64_t>(_voxelLod.get_observer_count());
+    stats["lod_prediction_distance"] = glm::distance(_voxelLod.get_camera_position(), _voxelLod.get_predicted_position());
+    stats["sdf_evaluations"] = static_cast<int64_t>(_sdfEvaluations.load());
+    stats["sdf_evaluations_saved"] = static_cast<int64_t>(_sdfEvaluationsSaved.load());
+    stats["worker_thread_count"] = _jobSystem ? _jobSystem->get_thread_count() : 0;
+    if (_meshComputeScheduler)
+    {
+        stats["mesh_jobs_completed"] = static_cast<int64_t>(_meshComputeScheduler->get_jobs_completed());
+        stats["mesh_jobs_cancelled"] = static_cast<int64_t>(_meshComputeScheduler->get_jobs_cancelled());
+        stats["mesh_results_discarded"] = static_cast<int64_t>(_meshComputeScheduler->get_results_discarded());
+        stats["mesh_time_ms"] = _meshComputeScheduler->get_mesh_time_ms();
+        stats["mesh_time_saved_ms"] = _meshComputeScheduler->get_mesh_time_saved_ms();
+        stats["mesh_queue_length"] = static_cast<int64_t>(_meshComputeScheduler->get_queue_length());
+        stats["mesh_jobs_in_flight"] = _meshComputeScheduler->get_jobs_in_flight();
+        stats["mesh_task_limit"] = _meshComputeScheduler->get_task_limit();
+        stats["frame_time_ms"] = _meshComputeScheduler->get_frame_time_ms();
+        stats["mesh_apply_backlog"] = static_cast<int64_t>(_meshComputeScheduler->get_apply_backlog());
+        stats["mesh_apply_time_ms"] = _meshComputeScheduler->get_last_apply_time_ms();
+        const uint64_t completed = _meshComputeScheduler->get_jobs_completed();
+        const uint64_t applied = _meshComputeScheduler->get_meshes_applied();
+        stats["mesh_time_per_chunk_ms"] = completed > 0 ? _meshComputeScheduler->get_mesh_time_ms() / completed : 0.0;
+        const uint64_t edgeCompleted = _meshComputeScheduler->get_edge_jobs_completed();
+        const double edgeMeshMs = _meshComputeScheduler->get_edge_mesh_time_ms();
+        stats["edge_mesh_jobs_completed"] = static_cast<int64_t>(edgeCompleted);
+        stats["edge_mesh_time_per_chunk_ms"] = edgeCompleted > 0 ? edgeMeshMs / edgeCompleted : 0.0;
+        stats["interior_mesh_time_per_chunk_ms"] =
+            completed > edgeCompleted
+                ? (_meshComputeScheduler->get_mesh_time_ms() - edgeMeshMs) / (completed - edgeCompleted)
+                : 0.0;
+        stats["mesh_apply_time_per_chunk_ms"] =
+            applied > 0 ? _meshComputeScheduler->get_apply_time_ms() / applied : 0.0;
+    }
+
+    const int64_t chunkCount = _chunkBackend ? _chunkBackend->get_chunk_count() : 0;
+    const int64_t chunkMemory = _chunkBackend ? _chunkBackend->get_memory_usage() : 0;
+    stats["collision_only"] = _collisionOnly;
+    stats["chunk_backend"] = _chunkBackendType;
+    stats["collider_queue_length"] = static_cast<int64_t>(_updateChunkCollidersQueue.size());
+    stats["chunk_count"] = chunkCount;
+    stats["chunk_memory_bytes"] = chunkMemory;
+    stats["chunk_memory_bytes_per_chunk"] = chunkCount > 0 ? chunkMemory / chunkCount : 0;
+    if (_chunkBackend)
+    {
+        stats["chunk_pool_size"] = _chunkBackend->get_pool_size();
+        stats["chunk_pool_high_water"] = _chunkBackend->get_pool_high_water();
+        stats["chunks_created"] = _chunkBackend->get_chunks_created();
+        stats["chunks_reused"] = _chunkBackend->get_chunks_reused();
+        stats["chunks_trimmed"] = _chunkBackend->get_chunks_trimmed();
+    }
+    if (_sdf.is_valid())
+        stats.merge(_sdf->get_statistics());
+    return stats;
+}
+
+Dictionary JarVoxelTerrain::benchmark_job_system(int threadCount, int jobCount, int workPerJob)
+{
+    const JobBenchmarkResult result = run_job_benchmark(threadCount, jobCount, workPerJob);
+    Dictionary stats;
+    stats["thread_pool_ms"] = result.threadPoolMs;
+    stats["job_system_ms"] = result.jobSystemMs;
+    stats["thread_pool_jobs_per_second"] = result.threadPoolMs > 0.0 ? jobCount * 1000.0 / result.threadPoolMs : 0.0;
+    stats["job_system_jobs_per_second"] = result.jobSystemMs > 0.0 ? jobCount * 1000.0 / result.jobSystemMs : 0.0;
+    return stats;
+}
+
+// the chunks currently in the world, meshed again on the main thread
+Dictionary JarVoxelTerrain::benchmark_meshing(int iterations, bool compare_neighbours) const
+{
+    Dictionary stats;
+    if (is_building() || !_voxelOctree.is_valid())
+    {
+        UtilityFunctions::printerr("benchmark_meshing needs a built terrain.");
+        return stats;
+    }
+    iterations = std::max(1, iterations);
+    std::vector<const VoxelOctreeNode *> chunks;
+    _voxelOctree.for_each_node([&chunks](const VoxelOctreeNode &node) {
+        if (node.has_chunk())
+            chunks.push_back(&node);
+    });
+
+    const MeshingBenchmarkResult result = run_meshing_benchmark(*this, chunks, iterations, compare_neighbours);
+    const int meshed = result.chunkCount * iterations;
+    const int edgeMeshed = result.edgeChunkCount * iterations;
+    const int interiorMeshed = meshed - edgeMeshed;
+    stats["chunk_count"] = result.chunkCount;
+    stats["edge_chunk_count"] = result.edgeChunkCount;
+    stats["sample_ms_per_chunk"] = meshed > 0 ? result.sampleMs / meshed : 0.0;
+    stats["surface_ms_per_chunk"] = meshed > 0 ? result.surfaceMs / meshed : 0.0;
+    stats["mesh_ms_per_chunk"] = meshed > 0 ? (result.sampleMs + result.surfaceMs) / meshed : 0.0;
+    stats["edge_mesh_ms_per_chunk"] = edgeMeshed > 0 ? result.edgeMs / edgeMeshed : 0.0;
+    stats["interior_mesh_ms_per_chunk"] =
+        interiorMeshed > 0 ? (result.sampleMs + result.surfaceMs - result.edgeMs) / interiorMeshed : 0.0;
+    stats["triangle_count"] = result.triangleCount;
+    if (compare_neighbours)
+    {
+        stats["neighbour_ms_per_chunk"] = meshed > 0 ? result.neighbourMs / meshed : 0.0;
+        stats["legacy_neighbour_ms_per_chunk"] = meshed > 0 ? result.legacyNeighbourMs / meshed : 0.0;
+        stats["neighbour_mismatches"] = result.neighbourMismatches;
+    }
+    return stats;
 }
 
 Ref<JarSignedDistanceField> JarVoxelTerrain::get_sdf() const
@@ -245,7 +505,9 @@ int JarVoxelTerrain::get_max_concurrent_tasks() const
 }
 void JarVoxelTerrain::set_max_concurrent_tasks(int value)
 {
-    _maxConcurrentTasks = value;
+    _maxConcurrentTasks = std::max(1, value);
+    if (_meshComputeScheduler)
+        _meshComputeScheduler->set_max_concurrent_tasks(_maxConcurrentTasks);
 }
 
 int JarVoxelTerrain::get_updated_colliders_per_second() const
@@ -257,6 +519,114 @@ void JarVoxelTerrain::set_updated_colliders_per_second(int value)
     _updatedCollidersPerSecond = value;
 }
 
+bool JarVoxelTerrain::get_brick_mode() const
+{
+    return _brickMode;
+}
+
+void JarVoxelTerrain::set_brick_mode(bool value)
+{
+    _brickMode = value;
+}
+
+int JarVoxelTerrain::get_worker_threads() const
+{
+    return _workerThreads;
+}
+
+void JarVoxelTerrain::set_worker_threads(int value)
+{
+    _workerThreads = std::max(0, value);
+}
+
+int JarVoxelTerrain::get_build_fork_depth() const
+{
+    return _buildForkDepth;
+}
+
+void JarVoxelTerrain::set_build_fork_depth(int value)
+{
+    _buildForkDepth = std::max(0, value);
+}
+
+int JarVoxelTerrain::get_mesh_apply_budget_usec() const
+{
+    return _meshApplyBudgetUsec;
+}
+
+void JarVoxelTerrain::set_mesh_apply_budget_usec(int value)
+{
+    _meshApplyBudgetUsec = std::max(0, value);
+    if (_meshComputeScheduler)
+        _meshComputeScheduler->set_apply_budget_usec(_meshApplyBudgetUsec);
+}
+
+int JarVoxelTerrain::get_target_frame_time_usec() const
+{
+    return _targetFrameTimeUsec;
+}
+
+void JarVoxelTerrain::set_target_frame_time_usec(int value)
+{
+    _targetFrameTimeUsec = std::max(0, value);
+    if (_meshComputeScheduler)
+        _meshComputeScheduler->set_target_frame_usec(_targetFrameTimeUsec);
+}
+
+bool JarVoxelTerrain::is_collision_only() const
+{
+    return _collisionOnly;
+}
+
+void JarVoxelTerrain::set_collision_only(bool value)
+{
+    _collisionOnly = value;
+}
+
+int JarVoxelTerrain::get_collider_lod_threshold() const
+{
+    return _colliderLodThreshold;
+}
+
+void JarVoxelTerrain::set_collider_lod_threshold(int value)
+{
+    _colliderLodThreshold = std::max(0, value);
+}
+
+JarVoxelTerrain::ChunkBackendType JarVoxelTerrain::get_chunk_backend_type() const
+{
+    return _chunkBackendType;
+}
+
+// takes effect with the next initialize
+void JarVoxelTerrain::set_chunk_backend_type(ChunkBackendType value)
+{
+    _chunkBackendType = value;
+}
+
+int JarVoxelTerrain::get_chunk_pool_capacity() const
+{
+    return _chunkPoolCapacity;
+}
+
+void JarVoxelTerrain::set_chunk_pool_capacity(int value)
+{
+    _chunkPoolCapacity = std::max(0, value);
+    if (_chunkBackend)
+        _chunkBackend->set_pool_capacity(_chunkPoolCapacity);
+}
+
+bool JarVoxelTerrain::is_compress_vertices() const
+{
+    return _compressVertices;
+}
+
+// meshes already built keep their format until they are rebuilt
+void JarVoxelTerrain::set_compress_vertices(bool value)
+{
+    _compressVertices = value;
+}
+
 int JarVoxelTerrain::get_lod_level_count() const
 {
     return lod_level_count;
@@ -297,6 +667,27 @@ void JarVoxelTerrain::set_lod_automatic_update_distance(float value)
     lod_automatic_update_distance = value;
 }
 
+bool JarVoxelTerrain::get_lod_incremental_update() const
+{
+    return lod_incremental_update;
+}
+
+void JarVoxelTerrain::set_lod_incremental_update(bool value)
+{
+    lod_incremental_update = value;
+}
+
+float JarVoxelTerrain::get_lod_prediction_time() const
+{
+    return lod_prediction_time;
+}
+
+void JarVoxelTerrain::set_lod_prediction_time(float value)
+{
+    lod_prediction_time = std::max(0.0f, value);
+    _voxelLod.set_prediction_time(lod_prediction_time);
+}
+
 void JarVoxelTerrain::_notification(int p_what)
 {
     if (godot::Engine::get_singleton()->is_editor_hint())
@@ -307,6 +698,7 @@ void JarVoxelTerrain::_notification(int p_what)
     {
     case NOTIFICATION_ENTER_TREE: {
         initialize();
+        add_performance_monitors();
         set_process_internal(true);
         break;
     }
@@ -314,6 +706,9 @@ void JarVoxelTerrain::_notification(int p_what)
         break;
     }
     case NOTIFICATION_EXIT_TREE: {
+        if (_chunkBackend)
+            _chunkBackend->exit_world();
+        remove_performance_monitors();
         set_process_internal(false);
         break;
     }
@@ -326,7 +721,7 @@ void JarVoxelTerrain::_notification(int p_what)
 
 void JarVoxelTerrain::initialize()
 {
-    if (_chunkScene.is_null())
+    if (_chunkScene.is_null() && !_collisionOnly && _chunkBackendType == CHUNK_BACKEND_SCENE)
     {
         UtilityFunctions::printerr("No ChunkScene properties, please provide it.");
         return;
@@ -337,20 +732,94 @@ void JarVoxelTerrain::initialize()
         return;
     }
     _chunkSize = (1 << _minChunkSize);
+    // a build and mesh jobs from an earlier initialize still work on the old tree and lod, the old scheduler waits
+    // for its jobs when it is destroyed
+    if (_jobSystem)
+        _jobSystem->wait(_buildCounter);
+    _meshComputeScheduler.reset();
     _voxelLod =
         JarVoxelLoD(lod_automatic_update, lod_automatic_update_distance, lod_level_count, lod_shell_size, _octreeScale);
-    _meshComputeScheduler = std::make_unique<MeshComputeScheduler>(_maxConcurrentTasks);
-    _voxelRoot = std::make_unique<VoxelOctreeNode>(_size);
+    _voxelLod.set_prediction_time(lod_prediction_time);
+    _jobSystem = std::make_unique<JobSystem>(_workerThreads);
+    _meshComputeScheduler = std::make_unique<MeshComputeScheduler>(*_jobSystem, _maxConcurrentTasks);
+    _meshComputeScheduler->set_apply_budget_usec(_meshApplyBudgetUsec);
+    _meshComputeScheduler->set_target_frame_usec(_targetFrameTimeUsec);
+    _voxelOctree.reset(_size, _octreeScale);
+    if (_chunkBackendType == CHUNK_BACKEND_SERVER)
+        _chunkBackend = std::make_unique<ServerChunkBackend>(*this);
+    else
+        _chunkBackend = std::make_unique<SceneChunkBackend>(*this);
+    _chunkBackend->set_pool_capacity(_chunkPoolCapacity);
+    _sdfEvaluations = 0;
+    _sdfEvaluationsSaved = 0;
+    _buildCount = 0;
+    _sdf->reset_statistics();
+    {
+        // a cell per chunk at lod 0
+        std::unique_lock<std::shared_mutex> lock(_brickEditsMutex);
+        _brickEdits.reset(_chunkSize * _octreeScale);
+    }
     //_populationRoot = memnew(PopulationOctreeNode(_size));
     build();
 }
 
+// shows up in the debugger monitors, one set of entries per terrain
+void JarVoxelTerrain::add_performance_monitors()
+{
+    add_performance_monitor("mesh apply backlog", callable_mp(this, &JarVoxelTerrain::get_mesh_apply_backlog));
+    add_performance_monitor("mesh jobs in flight", callable_mp(this, &JarVoxelTerrain::get_mesh_jobs_in_flight));
+    add_performance_monitor("mesh queue length", callable_mp(this, &JarVoxelTerrain::get_mesh_queue_length));
+}
+
+void JarVoxelTerrain::add_performance_monitor(const String &name, const Callable &callable)
+{
+    Performance *performance = Performance::get_singleton();
+    const String monitor = "JarVoxelTerrain/" + String(get_name()) + " " + name;
+    if (performance->has_custom_monitor(monitor))
+        return;
+    performance->add_custom_monitor(monitor, callable);
+    _performanceMonitors.push_back(monitor);
+}
+
+void JarVoxelTerrain::remove_performance_monitors()
+{
+    Performance *performance = Performance::get_singleton();
+    for (const String &monitor : _performanceMonitors)
+        if (performance->has_custom_monitor(monitor))
+            performance->remove_custom_monitor(monitor);
+    _performanceMonitors.clear();
+}
+
+int JarVoxelTerrain::get_mesh_apply_backlog() const
+{
+    return _meshComputeScheduler ? static_cast<int>(_meshComputeScheduler->get_apply_backlog()) : 0;
+}
+
+int JarVoxelTerrain::get_mesh_jobs_in_flight() const
+{
+    return _meshComputeScheduler ? _meshComputeScheduler->get_jobs_in_flight() : 0;
+}
+
+int JarVoxelTerrain::get_mesh_queue_length() const
+{
+    return _meshComputeScheduler ? static_cast<int>(_meshComputeScheduler->get_queue_length()) : 0;
+}
+
 void JarVoxelTerrain::process()
 {
     float delta = get_process_delta_time();
-    if (!_isBuilding && !_meshComputeScheduler->is_meshing() && _voxelLod.process(*this, false))
-        build();
-    _meshComputeScheduler->process(*this);
+    _observers.erase(std::remove_if(_observers.begin(), _observers.end(),
+                                    [](const ObjectID &id) { return ObjectDB::get_instance(id) == nullptr; }),
+                     _observers.end());
+    _voxelLod.track_observer(*this, delta);
+    if (!is_building() && !_meshComputeScheduler->is_meshing() && _voxelLod.process(*this, delta))
+        build(lod_incremental_update);
+    _meshComputeScheduler->process(*this, delta);
+    _chunkBackend->process();
+    // pruned by edits, freed once no job or collider can reach them
+    if (_voxelOctree.get_retired_block_count() > 0 && !is_building() && _meshComputeScheduler->is_idle() &&
+        _updateChunkCollidersQueue.empty())
+        _voxelOctree.release_retired_blocks();
 
     if (!_modifySettingsQueue.empty())
     {
@@ -375,19 +844,33 @@ void printUniqueLoDValues(const std::vector<int> &lodValues)
     UtilityFunctions::print(lodString);
 }
 
-void JarVoxelTerrain::build()
+void JarVoxelTerrain::build(bool incremental)
 {
-    if (_isBuilding || _meshComputeScheduler->is_meshing())
+    if (is_building() || _meshComputeScheduler->is_meshing())
         return;
-    std::thread([this]() {
-        // UtilityFunctions::print("start building");
-        _isBuilding = true;
-
-        //_meshComputeScheduler->clear_queue();
-        _voxelRoot->build(*this);
-        _isBuilding = false;
-        // UtilityFunctions::print("Stop Building");
-    }).detach();
+    // an incremental build only walks down to where a lod shell moved since the last one, the first build after
+    // initialize always is a full one
+    _lodChangedRegions.clear();
+    VoxelOctreeNode *root = _voxelOctree.get_root();
+    incremental = incremental && _voxelLod.changed_regions(root->get_bounds(_octreeScale), _lodChangedRegions);
+    _voxelLod.mark_built();
+    _lastBuildIncremental = incremental;
+    _buildNodesVisited = 0;
+    _buildCount++;
+
+    // the root job forks the top levels of the tree, the counter drops to zero once every subtree is done. The build
+    // decides what gets meshed next, so it goes ahead of the mesh jobs.
+    _buildStartTime = std::chrono::steady_clock::now();
+    const int forkDepth = _buildForkDepth;
+    _jobSystem->submit(
+        [this, root, forkDepth, incremental]() {
+            //_meshComputeScheduler->clear_queue();
+            root->build(*this, root->get_center(_octreeScale), forkDepth, incremental);
+            _lastBuildTimeUsec = std::chrono::duration_cast<std::chrono::microseconds>(
+                                     std::chrono::steady_clock::now() - _buildStartTime)
+                                     .count();
+        },
+        _buildCounter, JobSystem::PRIORITY_URGENT);
 
     // std::thread([this]() { _worldBiomes->update_texture(_levelOfDetail->get_camera_position()); }).detach();
     // UtilityFunctions::print("Done Building.");
@@ -413,11 +896,11 @@ void JarVoxelTerrain::process_chunk_queue(float delta)
         _updateChunkCollidersQueue.pop();
         if (node == nullptr)
             continue;
-        JarVoxelChunk *chunk = node->get_chunk();
+        VoxelChunk *chunk = node->get_chunk(*this);
         if (chunk == nullptr)
             continue;
 
-        if (JarVoxelChunk *chunk = node->get_chunk())
+        if (VoxelChunk *chunk = node->get_chunk(*this))
         {
             chunk->update_collision_mesh();
             processed++;
@@ -446,19 +929,100 @@ void JarVoxelTerrain::generate_epsilons()
 
 void JarVoxelTerrain::process_modify_queue()
 {
-    if (_isBuilding)
+    if (is_building())
         return;
-    _isBuilding = true;
-    // std::thread([this]() {
     if (!_modifySettingsQueue.empty())
     {
-        auto &settings = _modifySettingsQueue.front();
+        ModifySettings settings = _modifySettingsQueue.front();
         _modifySettingsQueue.pop();
-        _voxelRoot->modify_sdf_in_bounds(*this, settings);
+        apply_modify_settings(settings);
         //_populationRoot->remove_population(settings);
     }
-    _isBuilding = false;
-    // }).detach();
+}
+
+void JarVoxelTerrain::apply_modify_settings(const ModifySettings &settings)
+{
+    if (_brickMode)
+    {
+        // recorded first, a brick created by this edit already replays it
+        std::unique_lock<std::shared_mutex> lock(_brickEditsMutex);
+        _brickEdits.add(settings);
+    }
+    VoxelOctreeNode *root = _voxelOctree.get_root();
+    root->modify_sdf_in_bounds(*this, root->get_center(_octreeScale), settings);
+}
+
+void JarVoxelTerrain::get_brick_edits_in_bounds(const Bounds &bounds, std::vector<ModifySettings> &edits) const
+{
+    thread_local std::vector<uint32_t> found;
+    found.clear();
+    std::shared_lock<std::shared_mutex> lock(_brickEditsMutex);
+    _brickEdits.find_in_bounds(bounds, found);
+    for (const uint32_t edit : found)
+        edits.push_back(_brickEdits.get(edit));
+}
+
+float JarVoxelTerrain::sample_sdf(const glm::vec3 &position) const
+{
+    _sdfEvaluations.fetch_add(1, std::memory_order_relaxed);
+    if (!_brickMode)
+        return _sdf->distance(position);
+    // shared, the build samples from many threads at once
+    std::shared_lock<std::shared_mutex> lock(_brickEditsMutex);
+    uint8_t colorIndex;
+    return VoxelBrick::sample(*_sdf.ptr(), _brickEdits, position, _octreeScale, colorIndex);
+}
+
+void JarVoxelTerrain::sample_sdf_batch(const glm::vec3 *positions, float *values, size_t count) const
+{
+    _sdfEvaluations.fetch_add(count, std::memory_order_relaxed);
+    _sdf->distance_batch(positions, values, count);
+    if (!_brickMode)
+        return;
+    std::shared_lock<std::shared_mutex> lock(_brickEditsMutex);
+    for (size_t i = 0; i < count; ++i)
+        VoxelBrick::apply_edits(_brickEdits, positions[i], values[i], _octreeScale);
+}
+
+bool JarVoxelTerrain::is_lod_changed(const Bounds &bounds) const
+{
+    for (const Bounds &region : _lodChangedRegions)
+        if (region.intersects(bounds))
+            return true;
+    return false;
+}
+
+void JarVoxelTerrain::count_build_visit()
+{
+    _buildNodesVisited.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool JarVoxelTerrain::cull_sdf(const Bounds &bounds, float margin, float &value) const
+{
+    const glm::vec3 reach(margin);
+    const Bounds region(bounds.min - reach, bounds.max + reach);
+
+    // the center is at least this far inside of the region, which keeps the estimate clear of the margin
+    const glm::vec3 size = bounds.get_size();
+    const float inset = margin + 0.5f * std::min(size.x, std::min(size.y, size.z));
+    JarSignedDistanceField::Range range = _sdf->distance_range(region);
+    if (_brickMode)
+    {
+        thread_local std::vector<uint32_t> found;
+        found.clear();
+        std::shared_lock<std::shared_mutex> lock(_brickEditsMutex);
+        _brickEdits.find_in_bounds(region, found);
+        for (const uint32_t edit : found)
+            range = VoxelBrick::apply_range(_brickEdits.get(edit), region, range, _octreeScale);
+    }
+    if (range.min > 0.0f)
+        value = range.min + inset;
+    else if (range.max < 0.0f)
+        value = range.max - inset;
+    else
+        return false;
+    _sdfEvaluationsSaved.fetch_add(1, std::memory_order_relaxed);
+    return true;
 }
 
 // void JarVoxelTerrain::process_delete_chunk_queue()
@@ -474,29 +1038,32 @@ void JarVoxelTerrain::process_modify_queue()
 //     }
 // }
 
-void JarVoxelTerrain::get_voxel_leaves_in_bounds(const Bounds &bounds, std::vector<VoxelOctreeNode *> &nodes) const
+void JarVoxelTerrain::get_voxel_leaves_in_bounds(const Bounds &bounds, std::vector<VoxelOctreeNode *> &nodes,
+                                                 std::vector<glm::vec3> &centers) const
 {
-    _voxelRoot->get_voxel_leaves_in_bounds(*this, bounds, nodes);
+    _voxelOctree.get_voxel_leaves_in_bounds(*this, bounds, nodes, centers);
 }
 
-void JarVoxelTerrain::get_voxel_leaves_in_bounds(const Bounds &bounds, int lod,
-                                                 std::vector<VoxelOctreeNode *> &nodes) const
+void JarVoxelTerrain::get_voxel_leaves_in_bounds(const Bounds &bounds, int lod, std::vector<VoxelOctreeNode *> &nodes,
+                                                 std::vector<glm::vec3> &centers) const
 {
-    _voxelRoot->get_voxel_leaves_in_bounds(*this, bounds, lod, nodes);
+    _voxelOctree.get_voxel_leaves_in_bounds(*this, bounds, lod, nodes, centers);
 }
 
 void JarVoxelTerrain::get_voxel_leaves_in_bounds_excluding_bounds(const Bounds &bounds, const Bounds &excludeBounds,
-                                                                  int lod, std::vector<VoxelOctreeNode *> &nodes) const
+                                                                  int lod, std::vector<VoxelOctreeNode *> &nodes,
+                                                                  std::vector<glm::vec3> &centers) const
 {
-    _voxelRoot->get_voxel_leaves_in_bounds_excluding_bounds(*this, bounds, excludeBounds, lod, nodes);
+    _voxelOctree.get_voxel_leaves_in_bounds_excluding_bounds(*this, bounds, excludeBounds, lod, nodes, centers);
 }
 
 void JarVoxelTerrain::spawn_debug_spheres_in_bounds(const Vector3 &position, const float range)
 {
     std::vector<VoxelOctreeNode *> nodes;
+    std::vector<glm::vec3> centers;
     auto center = glm::vec3(position.x, position.y, position.z);
     auto bounds = Bounds(center - range, center + range);
-    get_voxel_leaves_in_bounds(bounds, nodes);
+    get_voxel_leaves_in_bounds(bounds, nodes, centers);
 
     Ref<StandardMaterial3D> red_material;
     red_material.instantiate();
@@ -510,16 +1077,17 @@ void JarVoxelTerrain::spawn_debug_spheres_in_bounds(const Vector3 &position, con
     sphere_mesh->set_radius(0.1f);
     sphere_mesh->set_height(0.2f);
 
-    for (auto &&n : nodes)
+    for (size_t i = 0; i < nodes.size(); ++i)
     {
-        Vector3 nodeCenter(n->_center.x, n->_center.y, n->_center.z);
+        VoxelOctreeNode *n = nodes[i];
+        Vector3 nodeCenter(centers[i].x, centers[i].y, centers[i].z);
 
         MeshInstance3D *sphereInstance = memnew(MeshInstance3D);
         add_child(sphereInstance);
 
         sphereInstance->set_mesh(sphere_mesh);
         sphereInstance->set_position(nodeCenter);
-        sphereInstance->set_material_override((n->get_value() > 0) ? green_material : red_material);
+        sphereInstance->set_material_override((n->get_value(*this) > 0) ? green_material : red_material);
     }
 }
 
@@ -534,9 +1102,19 @@ glm::vec3 JarVoxelTerrain::get_camera_position() const
     return _voxelLod.get_camera_position();
 }
 
-int JarVoxelTerrain::desired_lod(const VoxelOctreeNode &node)
+glm::vec3 JarVoxelTerrain::get_camera_forward() const
+{
+    if (_playerNode == nullptr)
+        return glm::vec3(0.0f);
+    const Vector3 forward = -_playerNode->get_global_transform().basis.get_column(2);
+    const glm::vec3 direction(forward.x, forward.y, forward.z);
+    const float length = glm::length(direction);
+    return length > 0.0f ? direction / length : glm::vec3(0.0f);
+}
+
+int JarVoxelTerrain::desired_lod(const VoxelOctreeNode &node, const glm::vec3 &center)
 {
-    return _voxelLod.desired_lod(node);
+    return _voxelLod.desired_lod(node, center);
 }
 
 int JarVoxelTerrain::lod_at(const glm::vec3 &position) const
@@ -544,6 +1122,26 @@ int JarVoxelTerrain::lod_at(const glm::vec3 &position) const
     return _voxelLod.lod_at(position);
 }
 
+int JarVoxelTerrain::lod_at(const LodObserverState &observers, const glm::vec3 &position) const
+{
+    return _voxelLod.lod_at(observers, position);
+}
+
+std::shared_ptr<const LodObserverState> JarVoxelTerrain::get_observer_state() const
+{
+    return _voxelLod.get_observer_state();
+}
+
+bool JarVoxelTerrain::is_lod_prefetch(const glm::vec3 &chunkCenter) const
+{
+    return _voxelLod.is_prefetch(chunkCenter);
+}
+
+float JarVoxelTerrain::get_other_observer_distance(const glm::vec3 &position) const
+{
+    return _voxelLod.distance_to_other_observer(position);
+}
+
 void JarVoxelTerrain::set_terrain_details(const TypedArray<JarTerrainDetail> &details)
 {
     _terrainDetails = details;
@@ -1,12 +1,16 @@
 #ifndef VOXEL_TERRAIN_H
 #define VOXEL_TERRAIN_H
 
+#include "brick_edit_index.h"
+#include "chunk_backend.h"
+#include "job_system.h"
 #include "mesh_compute_scheduler.h"
 #include "modify_settings.h"
 #include "signed_distance_field.h"
 #include "terrain_detail.h"
 #include "voxel_lod.h"
 #include "world.h"
+#include "voxel_octree.h"
 #include "voxel_octree_node.h"
 #include <godot_cpp/classes/engine.hpp>
 #include <godot_cpp/classes/fast_noise_lite.hpp>
@@ -14,12 +18,19 @@
 #include <godot_cpp/classes/mesh_instance3d.hpp>
 #include <godot_cpp/classes/node3d.hpp>
 #include <godot_cpp/classes/packed_scene.hpp>
+#include <godot_cpp/classes/performance.hpp>
 #include <godot_cpp/classes/random_number_generator.hpp>
 #include <godot_cpp/classes/sphere_mesh.hpp>
 #include <godot_cpp/classes/standard_material3d.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
 #include <godot_cpp/variant/typed_array.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include <queue>
+#include <shared_mutex>
 #include <vector>
 
 using namespace godot;
@@ -28,13 +39,20 @@ class JarVoxelTerrain : public Node3D
 {
     GDCLASS(JarVoxelTerrain, Node3D);
 
+  public:
+    enum ChunkBackendType
+    {
+        CHUNK_BACKEND_SCENE,
+        CHUNK_BACKEND_SERVER,
+    };
+
   private:
     std::unique_ptr<MeshComputeScheduler> _meshComputeScheduler;
 
     std::vector<float> _voxelEpsilons;
 
     Ref<JarSignedDistanceField> _sdf;
-    std::unique_ptr<VoxelOctreeNode> _voxelRoot;
+    VoxelOctree _voxelOctree;
 
     struct ChunkComparator
     {
@@ -55,13 +73,28 @@ class JarVoxelTerrain : public Node3D
 
     Ref<PackedScene> _chunkScene;
 
-    bool _isBuilding = false;
     int _chunkSize = 0;
     bool _cubicVoxels = false;
 
     // PERFORMANCE
     int _maxConcurrentTasks = 12;
     int _updatedCollidersPerSecond = 128;
+    bool _brickMode = false;
+    int _workerThreads = 0;
+    int _buildForkDepth = 3;
+    int _meshApplyBudgetUsec = 4000;
+    int _targetFrameTimeUsec = 16667;
+    // headless servers, chunks only get colliders, see JarVoxelChunk::create_collision_only
+    bool _collisionOnly = false;
+    int _colliderLodThreshold = 1;
+    ChunkBackendType _chunkBackendType = CHUNK_BACKEND_SCENE;
+    int _chunkPoolCapacity = 512;
+    bool _compressVertices = false;
+    std::vector<String> _performanceMonitors; // ids of the registered custom monitors
+
+    // every edit since initialize by the cells it touches, replayed when a brick is (re)filled
+    BrickEditIndex _brickEdits;
+    mutable std::shared_mutex _brickEditsMutex;
 
     // LOD
     JarVoxelLoD _voxelLod;
@@ -69,23 +102,51 @@ class JarVoxelTerrain : public Node3D
     int lod_shell_size = 2;
     bool lod_automatic_update = true;
     float lod_automatic_update_distance = 64.0f;
+    bool lod_incremental_update = true;
+    float lod_prediction_time = 0.0f;
 
     // POPULATION
     TypedArray<JarTerrainDetail> _terrainDetails;
 
-    void build();
+    void build(bool incremental = false);
     void _notification(int what);
     void initialize();
     void process();
     void process_chunk_queue(float delta);
     void generate_epsilons();
     void process_modify_queue();
+    void apply_modify_settings(const ModifySettings &settings);
+    void add_performance_monitors();
+    void add_performance_monitor(const String &name, const Callable &callable);
+    void remove_performance_monitors();
+    int get_mesh_apply_backlog() const;
+    int get_mesh_jobs_in_flight() const;
+    int get_mesh_queue_length() const;
 
     // void process_delete_chunk_queue();
 
     Node3D *_playerNode = nullptr;
+    // more nodes the lod follows, e.g. the players of a server. Held by id, freed ones drop out on their own.
+    std::vector<ObjectID> _observers;
     JarWorld *_worldNode = nullptr;
 
+    // BUILD
+    // jobs left of the current build, the terrain is building while it is above zero
+    JobSystem::Counter _buildCounter{0};
+    std::chrono::steady_clock::time_point _buildStartTime;
+    std::atomic<int64_t> _lastBuildTimeUsec{0};
+    // where the lod may have changed since the last build, read by the build jobs of an incremental build
+    std::vector<Bounds> _lodChangedRegions;
+    bool _lastBuildIncremental = false;
+    int64_t _buildCount = 0;
+    std::atomic<uint64_t> _buildNodesVisited{0};
+    mutable std::atomic<uint64_t> _sdfEvaluations{0};
+    mutable std::atomic<uint64_t> _sdfEvaluationsSaved{0};
+    // created by initialize, outlives the jobs that release its chunks
+    std::unique_ptr<ChunkBackend> _chunkBackend;
+    // the last member, so it is torn down first and running jobs never see a destroyed member
+    std::unique_ptr<JobSystem> _jobSystem;
+
   protected:
     static void _bind_methods();
 
@@ -101,17 +162,40 @@ class JarVoxelTerrain : public Node3D
     void force_update_lod();
 
     // chunks
+    ChunkBackend &get_chunk_backend();
     void enqueue_chunk_collider(VoxelOctreeNode *node);
-    void enqueue_chunk_update(VoxelOctreeNode &node);
+    void enqueue_chunk_update(VoxelOctreeNode &node, const glm::vec3 &center, uint8_t generation, bool urgent);
 
     // properties
     bool is_building() const;
     // MeshComputeScheduler *get_mesh_scheduler() const;
+    JobSystem &get_job_system();
+    const VoxelOctree &get_octree() const;
+    VoxelOctree &get_octree();
+    void get_brick_edits_in_bounds(const Bounds &bounds, std::vector<ModifySettings> &edits) const;
+    // the terrain sdf, with the recorded edits applied in brick mode
+    float sample_sdf(const glm::vec3 &position) const;
+    void sample_sdf_batch(const glm::vec3 *positions, float *values, size_t count) const;
+    // true if the sdf range over bounds is at least margin away from zero, value then gets a conservative estimate
+    // with the right sign instead of a sample.
+    bool cull_sdf(const Bounds &bounds, float margin, float &value) const;
+    // true if bounds reaches a region where the lod changed since the last build
+    bool is_lod_changed(const Bounds &bounds) const;
+    void count_build_visit();
+    Dictionary get_statistics() const;
+    static Dictionary benchmark_job_system(int threadCount, int jobCount, int workPerJob);
+    Dictionary benchmark_meshing(int iterations, bool compare_neighbours = false) const;
 
     // properties
     Node3D *get_player_node() const;
     void set_player_node(Node3D *playerNode);
 
+    void add_observer(Node3D *observer);
+    void remove_observer(Node3D *observer);
+    TypedArray<Node3D> get_observers() const;
+    // positions relative to the terrain, the player node not included
+    void get_observer_positions(std::vector<JarVoxelLoD::Observer> &observers) const;
+
     JarWorld *get_world_node() const;
     void set_world_node(JarWorld *worldNode);
 
@@ -142,6 +226,36 @@ class JarVoxelTerrain : public Node3D
     int get_updated_colliders_per_second() const;
     void set_updated_colliders_per_second(int value);
 
+    bool get_brick_mode() const;
+    void set_brick_mode(bool value);
+
+    int get_worker_threads() const;
+    void set_worker_threads(int value);
+
+    int get_build_fork_depth() const;
+    void set_build_fork_depth(int value);
+
+    int get_mesh_apply_budget_usec() const;
+    void set_mesh_apply_budget_usec(int value);
+
+    int get_target_frame_time_usec() const;
+    void set_target_frame_time_usec(int value);
+
+    bool is_collision_only() const;
+    void set_collision_only(bool value);
+
+    int get_collider_lod_threshold() const;
+    void set_collider_lod_threshold(int value);
+
+    ChunkBackendType get_chunk_backend_type() const;
+    void set_chunk_backend_type(ChunkBackendType value);
+
+    int get_chunk_pool_capacity() const;
+    void set_chunk_pool_capacity(int value);
+
+    bool is_compress_vertices() const;
+    void set_compress_vertices(bool value);
+
     // LOD
 
     int get_lod_level_count() const;
@@ -156,15 +270,34 @@ class JarVoxelTerrain : public Node3D
     float get_lod_automatic_update_distance() const;
     void set_lod_automatic_update_distance(float value);
 
-    void get_voxel_leaves_in_bounds(const Bounds &bounds, std::vector<VoxelOctreeNode *> &nodes) const;
-    void get_voxel_leaves_in_bounds(const Bounds &bounds, int lod, std::vector<VoxelOctreeNode *> &nodes) const;
+    bool get_lod_incremental_update() const;
+    void set_lod_incremental_update(bool value);
+
+    float get_lod_prediction_time() const;
+    void set_lod_prediction_time(float value);
+
+    // centers gets the center of every node appended to nodes
+    void get_voxel_leaves_in_bounds(const Bounds &bounds, std::vector<VoxelOctreeNode *> &nodes,
+                                    std::vector<glm::vec3> &centers) const;
+    void get_voxel_leaves_in_bounds(const Bounds &bounds, int lod, std::vector<VoxelOctreeNode *> &nodes,
+                                    std::vector<glm::vec3> &centers) const;
     void get_voxel_leaves_in_bounds_excluding_bounds(const Bounds &bounds, const Bounds &excludeBounds, int lod,
-                                                     std::vector<VoxelOctreeNode *> &nodes) const;
+                                                     std::vector<VoxelOctreeNode *> &nodes,
+                                                     std::vector<glm::vec3> &centers) const;
 
     // LOD
     glm::vec3 get_camera_position() const;
-    int desired_lod(const VoxelOctreeNode &node);
+    // unit view direction of the player node, zero without one
+    glm::vec3 get_camera_forward() const;
+    int desired_lod(const VoxelOctreeNode &node, const glm::vec3 &center);
     int lod_at(const glm::vec3 &position) const;
+    int lod_at(const LodObserverState &observers, const glm::vec3 &position) const;
+    // main thread, mesh jobs take it along when they are submitted
+    std::shared_ptr<const LodObserverState> get_observer_state() const;
+    // only this fine because of where the observer is headed, meshed after everything the camera needs
+    bool is_lod_prefetch(const glm::vec3 &chunkCenter) const;
+    // to the closest observer other than the one at the camera position, infinite without one
+    float get_other_observer_distance(const glm::vec3 &position) const;
 
 
     // POPULATION
@@ -173,5 +306,6 @@ class JarVoxelTerrain : public Node3D
 };
 
 VARIANT_ENUM_CAST(SDF::Operation);
+VARIANT_ENUM_CAST(JarVoxelTerrain::ChunkBackendType);
 
 #endif // VOXEL_TERRAIN_H